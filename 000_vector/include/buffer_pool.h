@@ -0,0 +1,89 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#define CL_TARGET_OPENCL_VERSION 220
+#include <CL/cl.h>
+
+/**
+ * Smallest buffer size of the pool in bytes. Larger buffers are rounded up
+ * to powers of two, so nearby sizes share buffers.
+ */
+#define BUFFER_POOL_MIN_SIZE 4096
+
+/**
+ * Buffer of the pool.
+ *
+ * host: Mapped pointer of a pinned host buffer, NULL for a device buffer
+ * size: Size class of the buffer in bytes
+ */
+typedef struct {
+    cl_mem buffer;
+    void* host;
+    size_t size;
+    int in_use;
+} PoolEntry;
+
+/**
+ * Grow-only pool of device buffers and pinned (CL_MEM_ALLOC_HOST_PTR, mapped)
+ * host buffers that are reused instead of being created and released for
+ * every temporary. A request that no free buffer can hold grows a free
+ * buffer of the same kind instead of adding one, so the pool holds no more
+ * buffers than were in use at the same time. Buffers handed back to the pool
+ * may be acquired again right away when all work is enqueued on one in-order
+ * queue.
+ *
+ * command_queue: Queue mapping the pinned host buffers
+ */
+typedef struct {
+    cl_context context;
+    cl_command_queue command_queue;
+    PoolEntry* entries;
+    int count;
+    int capacity;
+} BufferPool;
+
+/**
+ * Create an empty pool for the context.
+ */
+void buffer_pool_init(BufferPool* pool, cl_context context, cl_command_queue command_queue);
+
+/**
+ * Size class of a request: BUFFER_POOL_MIN_SIZE or the next power of two.
+ */
+size_t buffer_pool_size_class(size_t size);
+
+/**
+ * Get a free device buffer of at least size bytes, growing or creating one if there is none.
+ *
+ * error_code: CL_SUCCESS or the error of clCreateBuffer
+ *
+ * Returns the buffer, NULL on error
+ */
+cl_mem buffer_pool_acquire(BufferPool* pool, size_t size, cl_int* error_code);
+
+/**
+ * Get a free pinned host buffer of at least size bytes, mapped for reading
+ * and writing. Transfers from and to pinned memory avoid a staging copy.
+ *
+ * error_code: CL_SUCCESS or the error of clCreateBuffer or clEnqueueMapBuffer
+ *
+ * Returns the mapped pointer, NULL on error
+ */
+void* buffer_pool_acquire_host(BufferPool* pool, size_t size, cl_int* error_code);
+
+/**
+ * Hand a device buffer back to the pool, NULL is ignored.
+ */
+void buffer_pool_give_back(BufferPool* pool, cl_mem buffer);
+
+/**
+ * Hand a pinned host buffer back to the pool, NULL is ignored.
+ */
+void buffer_pool_give_back_host(BufferPool* pool, void* host);
+
+/**
+ * Unmap and release every buffer of the pool.
+ */
+void buffer_pool_release(BufferPool* pool);
+
+#endif
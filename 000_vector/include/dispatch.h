@@ -0,0 +1,82 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include "buffer_pool.h"
+
+#define CL_TARGET_OPENCL_VERSION 220
+#include <CL/cl.h>
+
+/**
+ * Backend an operation was routed to.
+ */
+typedef enum {
+    BACKEND_CPU,
+    BACKEND_DEVICE
+} Backend;
+
+/**
+ * Routes host vector additions to the SIMD host loop or to the device,
+ * whichever is faster for the length. Offloading pays for the transfers and
+ * the launch, so short vectors stay on the CPU.
+ *
+ * context, command_queue: Device, NULL context to always use the CPU
+ * pool: Device buffers of offloaded operations
+ * crossover: Length from which the device is faster, negative if it never is
+ */
+typedef struct {
+    cl_context context;
+    cl_device_id device_id;
+    cl_command_queue command_queue;
+    BufferPool* pool;
+    cl_program program;
+    cl_kernel kernel;
+    long crossover;
+} VectorDispatch;
+
+/**
+ * Path of the crossover file of a device: dispatch_<device name>.cfg in the
+ * directory given by the VECTOR_CONFIG_DIR environment variable, or in the
+ * working directory.
+ */
+void dispatch_config_path(cl_device_id device_id, char* path, size_t size);
+
+/**
+ * Build the device kernel and load the crossover from the file of the
+ * device, calibrating and saving it if there is none.
+ *
+ * context: NULL for the CPU only
+ * recalibrate: Calibrate even if the file has a crossover
+ *
+ * Returns CL_SUCCESS or an OpenCL error code
+ */
+cl_int vector_dispatch_init(VectorDispatch* dispatch, cl_context context, cl_device_id device_id,
+    cl_command_queue command_queue, BufferPool* pool, int recalibrate);
+
+/**
+ * Time both backends end to end on doubling lengths and set the crossover
+ * to the smallest length from which the device stays faster.
+ *
+ * Returns CL_SUCCESS or an OpenCL error code
+ */
+cl_int vector_dispatch_calibrate(VectorDispatch* dispatch);
+
+/**
+ * c = a + b for n ints on the faster backend.
+ *
+ * backend: Set to the backend used, may be NULL
+ *
+ * Returns CL_SUCCESS or an OpenCL error code of the device backend
+ */
+cl_int vector_dispatch_add(VectorDispatch* dispatch, const int* a, const int* b, int* c, int n, Backend* backend);
+
+/**
+ * c = a + b for n ints on the host, 8 lanes at a time.
+ */
+void vector_add_cpu(const int* a, const int* b, int* c, int n);
+
+/**
+ * Release the kernel of the dispatcher.
+ */
+void vector_dispatch_release(VectorDispatch* dispatch);
+
+#endif
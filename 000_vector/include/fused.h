@@ -0,0 +1,67 @@
+#ifndef FUSED_H
+#define FUSED_H
+
+#include "stream.h"
+
+#define CL_TARGET_OPENCL_VERSION 220
+#include <CL/cl.h>
+
+#define MAX_FUSED_NAMES 16
+#define MAX_FUSED_NAME_LENGTH 32
+
+/**
+ * One element-wise kernel generated from expressions such as
+ * "r = a*x + b*y - z". Statements are separated by ';' and may use the
+ * names assigned before them; the last one assigns the output, the others
+ * private temporaries. Every input vector is read once per element.
+ * Expressions have + - * /, unary minus, parentheses, numbers and calls of
+ * OpenCL built-ins such as sqrt or fmin.
+ *
+ * inputs: Input vectors in the order of their first use
+ * scalars: Scalar arguments in the order they were declared
+ * output: Name of the output vector
+ * source: Generated OpenCL source
+ */
+typedef struct {
+    cl_program program;
+    cl_kernel kernel;
+    StreamType type;
+    int n_inputs;
+    int n_scalars;
+    char inputs[MAX_FUSED_NAMES][MAX_FUSED_NAME_LENGTH];
+    char scalars[MAX_FUSED_NAMES][MAX_FUSED_NAME_LENGTH];
+    char output[MAX_FUSED_NAME_LENGTH];
+    char* source;
+} FusedKernel;
+
+/**
+ * Parse the expression, generate the kernel and build it through the
+ * binary cache of build_program_source.
+ *
+ * type: Element type of every vector and scalar
+ * expression: Statements, for example "t = x * y; r = a * t - z"
+ * scalars: Comma separated names of the scalar arguments, for example "a,b", may be NULL
+ *
+ * Returns CL_SUCCESS, -1 on a syntax error or an unsupported type, or an OpenCL error code
+ */
+cl_int fused_kernel_init(FusedKernel* fused, cl_context context, cl_device_id device_id, StreamType type,
+    const char* expression, const char* scalars);
+
+/**
+ * output = the expression over the first n elements.
+ *
+ * inputs: Buffer of every input, in the order of fused->inputs
+ * scalars: Value of every scalar, in the order of fused->scalars, may be NULL without scalars
+ * event: Event of the kernel, may be NULL
+ *
+ * Returns CL_SUCCESS or an OpenCL error code
+ */
+cl_int fused_kernel_run(FusedKernel* fused, cl_command_queue command_queue, cl_mem output, const cl_mem* inputs,
+    const double* scalars, int n, cl_event* event);
+
+/**
+ * Release the kernel and the source.
+ */
+void fused_kernel_release(FusedKernel* fused);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "buffer_pool.h"
+
+#define CL_TARGET_OPENCL_VERSION 220
+#include <CL/cl.h>
+
+// In-order queues of the pipeline: uploads, kernels and downloads
+#define PIPELINE_QUEUES 3
+
+// Device buffer sets the chunks rotate through
+#define PIPELINE_SLOTS 3
+
+/**
+ * Stages of a serialized vector_add_kernel run: upload of both inputs, kernel
+ * and download of the result, from the profiling events, and the wall time
+ * of the whole run.
+ */
+typedef struct {
+    double upload_s;
+    double kernel_s;
+    double download_s;
+    double wall_s;
+} SerialResult;
+
+/**
+ * c = a + b on one queue: upload everything, run one kernel, read everything back.
+ *
+ * kernel: vector_add_kernel
+ *
+ * Returns CL_SUCCESS or an OpenCL error code
+ */
+cl_int vector_add_serial(cl_command_queue command_queue, BufferPool* pool, cl_kernel kernel,
+    const int* a, const int* b, int* c, int n, SerialResult* result);
+
+/**
+ * c = a + b in chunks. Chunk i + 1 uploads on the first queue while chunk i
+ * runs on the second and chunk i - 1 downloads on the third; the chunks
+ * rotate through PIPELINE_SLOTS sets of device buffers, and events keep a
+ * slot from being overwritten before the chunk that used it is done.
+ * a, b and c should be pinned (pool host buffers) for the copies to run
+ * asynchronously.
+ *
+ * queues: PIPELINE_QUEUES in-order queues of the same device
+ * chunks: Number of chunks
+ * seconds: Set to the wall time
+ *
+ * Returns CL_SUCCESS or an OpenCL error code
+ */
+cl_int vector_add_pipelined(cl_command_queue queues[PIPELINE_QUEUES], BufferPool* pool, cl_kernel kernel,
+    const int* a, const int* b, int* c, int n, int chunks, double* seconds);
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef REDUCE_H
+#define REDUCE_H
+
+#include "buffer_pool.h"
+#include "stream.h"
+
+#define CL_TARGET_OPENCL_VERSION 220
+#include <CL/cl.h>
+
+/**
+ * Reduction operations.
+ */
+typedef enum {
+    REDUCE_SUM,
+    REDUCE_MIN,
+    REDUCE_MAX,
+    REDUCE_ARGMIN
+} ReduceOp;
+
+#define REDUCE_OPS 4
+
+/**
+ * Scalar result of a reduction. Int sums are exact in as_long, every
+ * result is also converted to as_double.
+ *
+ * index: Position of the minimum for argmin, -1 otherwise
+ */
+typedef struct {
+    cl_long as_long;
+    double as_double;
+    int index;
+} ReduceResult;
+
+/**
+ * Two-stage reduction of one operation over one element type.
+ *
+ * groups: Work-groups of the first stage, one partial each
+ * local_size: Work-items per group, a power of two
+ * subgroups: The groups fold sub-groups before the local memory tree
+ * partial_*, result_*: Pool buffers of the partials and of the result
+ */
+typedef struct {
+    cl_program program;
+    cl_kernel reduce_kernel;
+    cl_kernel partials_kernel;
+    BufferPool* pool;
+    StreamType type;
+    ReduceOp op;
+    size_t groups;
+    size_t local_size;
+    int subgroups;
+    cl_mem partial_values;
+    cl_mem partial_indices;
+    cl_mem result_value;
+    cl_mem result_index;
+} Reducer;
+
+/**
+ * Get the name of an operation (sum, min, max, argmin).
+ */
+const char* reduce_op_name(ReduceOp op);
+
+/**
+ * Build the kernels of the operation for the element type.
+ *
+ * Returns CL_SUCCESS, -1 if the device does not support the type or an OpenCL error code
+ */
+cl_int reducer_init(Reducer* reducer, cl_context context, cl_device_id device_id, BufferPool* pool,
+    StreamType type, ReduceOp op);
+
+/**
+ * Reduce the first n elements of a device buffer and read the scalar back.
+ *
+ * seconds: Set to the device time of both stages, may be NULL
+ *
+ * Returns CL_SUCCESS or an OpenCL error code
+ */
+cl_int reducer_run(Reducer* reducer, cl_command_queue command_queue, cl_mem input, int n,
+    ReduceResult* result, double* seconds);
+
+/**
+ * Release the kernels and buffers of the reducer.
+ */
+void reducer_release(Reducer* reducer);
+
+/**
+ * Reference host loop over n elements of the type.
+ */
+void reduce_cpu(StreamType type, ReduceOp op, const void* input, int n, ReduceResult* result);
+
+#endif
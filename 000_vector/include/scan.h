@@ -0,0 +1,93 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include "buffer_pool.h"
+#include "stream.h"
+
+#define CL_TARGET_OPENCL_VERSION 220
+#include <CL/cl.h>
+
+/**
+ * Prefix sums of one element type.
+ *
+ * local_size: Work-items per group, a power of two
+ * tile: Elements scanned per work-group
+ */
+typedef struct {
+    cl_program program;
+    cl_kernel tile_sum_kernel;
+    cl_kernel scan_tile_kernel;
+    BufferPool* pool;
+    StreamType type;
+    size_t local_size;
+    size_t tile;
+} Scanner;
+
+/**
+ * Stream compaction of uint elements, built on an int scan of keep flags.
+ */
+typedef struct {
+    Scanner scanner;
+    cl_kernel flags_kernel;
+    cl_kernel scatter_kernel;
+} Compactor;
+
+/**
+ * Build the scan kernels for the element type.
+ *
+ * Returns CL_SUCCESS, -1 if the device does not support the type or an OpenCL error code
+ */
+cl_int scanner_init(Scanner* scanner, cl_context context, cl_device_id device_id, BufferPool* pool,
+    StreamType type);
+
+/**
+ * Scan the first n elements of input into output, which may be the same buffer.
+ *
+ * inclusive: 1 for output[i] = input[0] + ... + input[i], 0 to stop at input[i - 1]
+ *
+ * Returns CL_SUCCESS or an OpenCL error code
+ */
+cl_int scanner_run(Scanner* scanner, cl_command_queue command_queue, cl_mem input, cl_mem output, int n,
+    int inclusive);
+
+/**
+ * Release the kernels of the scanner.
+ */
+void scanner_release(Scanner* scanner);
+
+/**
+ * Build the compaction kernels.
+ *
+ * Returns CL_SUCCESS or an OpenCL error code
+ */
+cl_int compactor_init(Compactor* compactor, cl_context context, cl_device_id device_id, BufferPool* pool);
+
+/**
+ * Copy the elements x of the first n of input with x & mask != 0 to the front
+ * of output, in order. With mask 0xFFFFFFFF the non-zero elements are kept,
+ * with 0xFF000000 the packed RGBA pixels that are not fully transparent.
+ *
+ * indices: Set to the input index of every kept element, may be NULL
+ * count: Set to the number of kept elements
+ *
+ * Returns CL_SUCCESS or an OpenCL error code
+ */
+cl_int compactor_run(Compactor* compactor, cl_command_queue command_queue, cl_mem input, int n, cl_uint mask,
+    cl_mem output, cl_mem indices, int* count);
+
+/**
+ * Release the kernels of the compactor.
+ */
+void compactor_release(Compactor* compactor);
+
+/**
+ * Reference host scan of n elements of the type.
+ */
+void scan_cpu(StreamType type, const void* input, void* output, int n, int inclusive);
+
+/**
+ * Reference host compaction. Returns the number of kept elements.
+ */
+int compact_cpu(const cl_uint* input, int n, cl_uint mask, cl_uint* output);
+
+#endif
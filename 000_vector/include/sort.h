@@ -0,0 +1,50 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include "buffer_pool.h"
+#include "scan.h"
+
+#define CL_TARGET_OPENCL_VERSION 220
+#include <CL/cl.h>
+
+/**
+ * LSD radix sort of uint keys with int payloads, 4 bits per pass: a digit
+ * histogram per tile, an exclusive scan of the histograms and a stable
+ * scatter.
+ *
+ * local_size: Work-items per group, a power of two
+ * tile: Keys per work-group
+ */
+typedef struct {
+    Scanner scanner;
+    cl_kernel histogram_kernel;
+    cl_kernel scatter_kernel;
+    size_t local_size;
+    size_t tile;
+} RadixSorter;
+
+/**
+ * Build the sort kernels.
+ *
+ * Returns CL_SUCCESS or an OpenCL error code
+ */
+cl_int radix_sorter_init(RadixSorter* sorter, cl_context context, cl_device_id device_id, BufferPool* pool);
+
+/**
+ * Sort the first n keys in place by their low key_bits bits, moving the
+ * values with them. Equal keys keep their order.
+ *
+ * values: Payload, NULL to sort the keys only
+ * key_bits: 32 for whole keys, 24 for packed RGB
+ *
+ * Returns CL_SUCCESS or an OpenCL error code
+ */
+cl_int radix_sort(RadixSorter* sorter, cl_command_queue command_queue, cl_mem keys, cl_mem values, int n,
+    int key_bits);
+
+/**
+ * Release the kernels of the sorter.
+ */
+void radix_sorter_release(RadixSorter* sorter);
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "buffer_pool.h"
+
+#define CL_TARGET_OPENCL_VERSION 220
+#include <CL/cl.h>
+
+/**
+ * Element types of the STREAM kernels.
+ */
+typedef enum {
+    STREAM_INT,
+    STREAM_FLOAT,
+    STREAM_DOUBLE
+} StreamType;
+
+#define STREAM_TYPES 3
+
+/**
+ * The four STREAM kernels, in the order they run.
+ */
+typedef enum {
+    STREAM_COPY,
+    STREAM_SCALE,
+    STREAM_ADD,
+    STREAM_TRIAD
+} StreamKernel;
+
+#define STREAM_KERNELS 4
+
+/**
+ * Result of one STREAM kernel over the repeats.
+ *
+ * best_s, average_s: Kernel time from CL_PROFILING_COMMAND_START to END
+ * gbs: Bandwidth of the best time, counting every array read or written once
+ */
+typedef struct {
+    double best_s;
+    double average_s;
+    double gbs;
+} StreamResult;
+
+/**
+ * Host <-> device transfer bandwidth in GB/s, from pinned (pool) and pageable (malloc) host memory.
+ */
+typedef struct {
+    double h2d_pinned;
+    double d2h_pinned;
+    double h2d_pageable;
+    double d2h_pageable;
+} TransferResult;
+
+/**
+ * Kernel launch overhead in microseconds.
+ *
+ * queued_to_start_us: CL_PROFILING_COMMAND_QUEUED to START of an empty kernel
+ * round_trip_us: Wall time of enqueueing an empty kernel and waiting for it
+ */
+typedef struct {
+    double queued_to_start_us;
+    double round_trip_us;
+} LatencyResult;
+
+/**
+ * Get the name of an element type (int, float, double).
+ */
+const char* stream_type_name(StreamType type);
+
+/**
+ * Size of one element of the type in bytes.
+ */
+size_t stream_type_size(StreamType type);
+
+/**
+ * Get the name of a kernel (copy, scale, add, triad).
+ */
+const char* stream_kernel_name(StreamKernel kernel);
+
+/**
+ * Run copy, scale, add and triad on three arrays of array_bytes bytes each,
+ * repeats times each, and check the final contents of the arrays.
+ *
+ * width: Vector width of the kernels (1, 2, 4, 8 or 16)
+ * results: Result of every kernel
+ * verified: Set to 1 if the arrays hold the expected values
+ *
+ * Returns CL_SUCCESS, -1 if the device does not support the type or an OpenCL error code
+ */
+cl_int stream_run(cl_context context, cl_device_id device_id, cl_command_queue command_queue, BufferPool* pool,
+    StreamType type, int width, size_t array_bytes, int repeats, StreamResult results[STREAM_KERNELS], int* verified);
+
+/**
+ * Measure the best transfer bandwidth of bytes bytes in each direction.
+ *
+ * Returns CL_SUCCESS or an OpenCL error code
+ */
+cl_int transfer_bandwidth(cl_command_queue command_queue, BufferPool* pool, size_t bytes, int repeats,
+    TransferResult* result);
+
+/**
+ * Measure the average launch overhead of an empty kernel over repeats launches.
+ *
+ * Returns CL_SUCCESS or an OpenCL error code
+ */
+cl_int launch_latency(cl_context context, cl_device_id device_id, cl_command_queue command_queue, int repeats,
+    LatencyResult* result);
+
+#endif
@@ -0,0 +1,70 @@
+/**
+ * Philox4x32-10 fill kernel. The element type is chosen at build time:
+ *
+ * ELEM_T: element type of the buffer (int, float, double, half, char)
+ * ELEM_HALF: the buffer is stored as half and written with vstore_half
+ * USE_FP64: enable cl_khr_fp64 for double buffers
+ */
+#ifdef USE_FP64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+#ifndef ELEM_T
+#define ELEM_T int
+#endif
+
+#ifdef ELEM_HALF
+#define STORE_VALUE(v, p, i) vstore_half((float)(v), (i), (p))
+#else
+#define STORE_VALUE(v, p, i) ((p)[i] = (ELEM_T)(v))
+#endif
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+/**
+ * Ten Philox rounds of a counter under the key (k0, k1).
+ */
+uint4 philox4x32(uint4 c, uint k0, uint k1)
+{
+    for (int r = 0; r < 10; ++r) {
+        uint hi0 = mul_hi(PHILOX_M0, c.x);
+        uint lo0 = PHILOX_M0 * c.x;
+        uint hi1 = mul_hi(PHILOX_M1, c.z);
+        uint lo1 = PHILOX_M1 * c.z;
+        c = (uint4)(hi1 ^ c.y ^ k0, lo1, hi0 ^ c.w ^ k1, lo0);
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    return c;
+}
+
+/**
+ * Fill lines x line_length elements with random integers in [min, max].
+ * Work-item b computes Philox block b and writes random numbers 4b .. 4b + 3,
+ * number e being element e % line_length of line e / line_length at
+ * offset + line * ld + position.
+ */
+__kernel void random_fill_kernel(
+    __global ELEM_T* buffer, int offset, int lines, int line_length, int ld,
+    uint seed_lo, uint seed_hi, int min, int max
+) {
+    ulong block = get_global_id(0);
+    ulong count = (ulong)lines * line_length;
+    // Unsigned to avoid overflow, 0 is the full 2^32 range
+    uint range = (uint)max - (uint)min + 1u;
+    uint4 r = philox4x32((uint4)((uint)block, (uint)(block >> 32), 0, 0), seed_lo, seed_hi);
+    uint words[4] = { r.x, r.y, r.z, r.w };
+
+    for (int j = 0; j < 4; ++j) {
+        ulong e = block * 4 + j;
+        if (e < count) {
+            long line = e / line_length;
+            long position = e % line_length;
+            uint value = range != 0 ? words[j] % range : words[j];
+            STORE_VALUE((int)((uint)min + value), buffer, offset + line * ld + position);
+        }
+    }
+}
@@ -0,0 +1,147 @@
+/**
+ * Two-stage reductions. reduce_kernel folds a grid-strided slice of the input
+ * into one partial per work-group, reduce_partials_kernel folds the partials
+ * in a single work-group. Chosen at build time:
+ *
+ * T: input type (int, float, double)
+ * ACC_T: accumulator type (long for int sums, T otherwise)
+ * OP: REDUCE_SUM, REDUCE_MIN, REDUCE_MAX or REDUCE_ARGMIN
+ * IDENTITY: identity element of OP in ACC_T
+ * USE_FP64: enable cl_khr_fp64 for double inputs
+ * USE_SUBGROUPS: fold sum, min and max within sub-groups first (cl_khr_subgroups)
+ *
+ * The local size must be a power of two. argmin returns the smallest index of the minimum.
+ */
+#ifdef USE_FP64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+#ifdef USE_SUBGROUPS
+#pragma OPENCL EXTENSION cl_khr_subgroups : enable
+#endif
+
+#define REDUCE_SUM 0
+#define REDUCE_MIN 1
+#define REDUCE_MAX 2
+#define REDUCE_ARGMIN 3
+
+#ifndef T
+#define T int
+#endif
+#ifndef ACC_T
+#define ACC_T T
+#endif
+#ifndef OP
+#define OP REDUCE_SUM
+#endif
+#ifndef IDENTITY
+#define IDENTITY 0
+#endif
+
+// Index of the identity, larger than every position
+#define NO_INDEX 0x7FFFFFFF
+
+/**
+ * Fold (b, ib) into (*a, *ia).
+ */
+void combine(ACC_T* a, int* ia, ACC_T b, int ib)
+{
+#if OP == REDUCE_SUM
+    *a += b;
+#elif OP == REDUCE_MIN
+    *a = min(*a, b);
+#elif OP == REDUCE_MAX
+    *a = max(*a, b);
+#else
+    if (b < *a || (b == *a && ib < *ia)) {
+        *a = b;
+        *ia = ib;
+    }
+#endif
+}
+
+/**
+ * Fold the values of every work-item of the group into work-item 0.
+ */
+void group_reduce(ACC_T* value, int* index, __local ACC_T* values, __local int* indices)
+{
+    int lid = get_local_id(0);
+
+#if defined(USE_SUBGROUPS) && OP != REDUCE_ARGMIN
+    // One value per sub-group, folded by work-item 0
+#if OP == REDUCE_SUM
+    *value = sub_group_reduce_add(*value);
+#elif OP == REDUCE_MIN
+    *value = sub_group_reduce_min(*value);
+#else
+    *value = sub_group_reduce_max(*value);
+#endif
+    if (get_sub_group_local_id() == 0) {
+        values[get_sub_group_id()] = *value;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    if (lid == 0) {
+        for (uint s = 1; s < get_num_sub_groups(); ++s) {
+            combine(value, index, values[s], NO_INDEX);
+        }
+    }
+#else
+    // Tree in local memory, halving the active work-items each step
+    values[lid] = *value;
+    indices[lid] = *index;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for (int s = get_local_size(0) / 2; s > 0; s >>= 1) {
+        if (lid < s) {
+            ACC_T a = values[lid];
+            int ia = indices[lid];
+            combine(&a, &ia, values[lid + s], indices[lid + s]);
+            values[lid] = a;
+            indices[lid] = ia;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    *value = values[0];
+    *index = indices[0];
+#endif
+}
+
+/**
+ * First stage: partial of work-group g in partial_values[g] and partial_indices[g].
+ */
+__kernel void reduce_kernel(
+    __global const T* input, const int n,
+    __global ACC_T* partial_values, __global int* partial_indices,
+    __local ACC_T* values, __local int* indices
+) {
+    ACC_T value = IDENTITY;
+    int index = NO_INDEX;
+
+    for (int i = get_global_id(0); i < n; i += get_global_size(0)) {
+        combine(&value, &index, (ACC_T)input[i], i);
+    }
+    group_reduce(&value, &index, values, indices);
+    if (get_local_id(0) == 0) {
+        partial_values[get_group_id(0)] = value;
+        partial_indices[get_group_id(0)] = index;
+    }
+}
+
+/**
+ * Second stage, one work-group: fold n partials into result_value[0] and result_index[0].
+ */
+__kernel void reduce_partials_kernel(
+    __global const ACC_T* partial_values, __global const int* partial_indices, const int n,
+    __global ACC_T* result_value, __global int* result_index,
+    __local ACC_T* values, __local int* indices
+) {
+    ACC_T value = IDENTITY;
+    int index = NO_INDEX;
+
+    for (int i = get_local_id(0); i < n; i += get_local_size(0)) {
+        combine(&value, &index, partial_values[i], partial_indices[i]);
+    }
+    group_reduce(&value, &index, values, indices);
+    if (get_local_id(0) == 0) {
+        *result_value = value;
+        *result_index = index;
+    }
+}
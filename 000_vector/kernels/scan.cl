@@ -0,0 +1,271 @@
+/**
+ * Reduce-then-scan prefix sums and stream compaction. A tile of
+ * ITEMS x local size elements is scanned per work-group: tile_sum_kernel
+ * writes the total of every tile, the totals are scanned inclusively (by the
+ * same kernels when there is more than one tile of them), and
+ * scan_tile_kernel scans every tile again from the total of the tiles before
+ * it. The input is read twice and the output written once. Chosen at build time:
+ *
+ * T: element type (int, float, double)
+ * INT_SCAN: T is int, which also builds the radix sort kernels
+ * ITEMS: consecutive elements scanned by each work-item
+ * USE_FP64: enable cl_khr_fp64 for double arrays
+ *
+ * The local size must be a power of two.
+ */
+#ifdef USE_FP64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+#ifndef T
+#define T int
+#endif
+#ifndef ITEMS
+#define ITEMS 8
+#endif
+
+// One padding element every 32 keeps the per-work-item runs off the same banks
+#define PADDED(i) ((i) + ((i) >> 5))
+
+/**
+ * Blelloch exclusive scan of one value per work-item. Returns the exclusive
+ * prefix of the work-item and sets total to the sum of the group.
+ */
+T group_exclusive_scan(__local T* sums, T value, T* total)
+{
+    int lid = get_local_id(0);
+    int size = get_local_size(0);
+    T prefix;
+
+    sums[lid] = value;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Up-sweep: partial sums in place up a balanced tree
+    for (int d = 1; d < size; d <<= 1) {
+        int i = (lid + 1) * 2 * d - 1;
+        if (i < size) {
+            sums[i] += sums[i - d];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    *total = sums[size - 1];
+    barrier(CLK_LOCAL_MEM_FENCE);
+    if (lid == 0) {
+        sums[size - 1] = 0;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Down-sweep: each node passes its prefix left and prefix + left sum right
+    for (int d = size / 2; d >= 1; d >>= 1) {
+        int i = (lid + 1) * 2 * d - 1;
+        if (i < size) {
+            T left = sums[i - d];
+            sums[i - d] = sums[i];
+            sums[i] += left;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    prefix = sums[lid];
+    barrier(CLK_LOCAL_MEM_FENCE);
+    return prefix;
+}
+
+/**
+ * Total of tile g in tile_sums[g].
+ */
+__kernel void tile_sum_kernel(__global const T* input, const int n, __global T* tile_sums, __local T* sums)
+{
+    int size = get_local_size(0);
+    long base = (long)get_group_id(0) * size * ITEMS + get_local_id(0);
+    T value = 0;
+    T total;
+
+    for (int j = 0; j < ITEMS; ++j) {
+        long i = base + j * size;
+        if (i < n) {
+            value += input[i];
+        }
+    }
+    group_exclusive_scan(sums, value, &total);
+    if (get_local_id(0) == 0) {
+        tile_sums[get_group_id(0)] = total;
+    }
+}
+
+/**
+ * Scan tile g of the input into the output, which may be the input.
+ *
+ * offsets: Inclusive scan of the tile totals, tile g starts from offsets[g - 1]
+ * use_offsets: 0 when there is a single tile and no offsets
+ * inclusive: 1 for an inclusive scan, 0 for an exclusive one
+ * tile: PADDED(ITEMS x local size) elements
+ */
+__kernel void scan_tile_kernel(
+    __global const T* input, __global T* output, const int n,
+    __global const T* offsets, const int use_offsets, const int inclusive,
+    __local T* tile, __local T* sums
+) {
+    int lid = get_local_id(0);
+    int size = get_local_size(0);
+    long base = (long)get_group_id(0) * size * ITEMS;
+    T value = 0;
+    T total;
+
+    // Coalesced loads into local memory
+    for (int j = 0; j < ITEMS; ++j) {
+        int t = j * size + lid;
+        tile[PADDED(t)] = base + t < n ? input[base + t] : 0;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Each work-item scans a run of ITEMS consecutive elements
+    for (int j = 0; j < ITEMS; ++j) {
+        value += tile[PADDED(lid * ITEMS + j)];
+    }
+    T prefix = group_exclusive_scan(sums, value, &total);
+    if (use_offsets && get_group_id(0) > 0) {
+        prefix += offsets[get_group_id(0) - 1];
+    }
+    for (int j = 0; j < ITEMS; ++j) {
+        int t = PADDED(lid * ITEMS + j);
+        T element = tile[t];
+        tile[t] = inclusive ? prefix + element : prefix;
+        prefix += element;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int j = 0; j < ITEMS; ++j) {
+        int t = j * size + lid;
+        if (base + t < n) {
+            output[base + t] = tile[PADDED(t)];
+        }
+    }
+}
+
+/**
+ * flags[i] = 1 if input[i] & mask is not zero, else 0.
+ */
+__kernel void compact_flags_kernel(__global const uint* input, const int n, const uint mask, __global int* flags)
+{
+    int i = get_global_id(0);
+    if (i < n) {
+        flags[i] = (input[i] & mask) != 0;
+    }
+}
+
+/**
+ * Write every kept element to its position of the exclusive scan of the
+ * flags, and its index to the same position of indices unless it is NULL.
+ */
+__kernel void compact_scatter_kernel(
+    __global const uint* input, const int n, const uint mask, __global const int* positions,
+    __global uint* output, __global int* indices
+) {
+    int i = get_global_id(0);
+    if (i < n && (input[i] & mask) != 0) {
+        output[positions[i]] = input[i];
+        if (indices != 0) {
+            indices[positions[i]] = i;
+        }
+    }
+}
+
+// The radix sort ranks keys with the int scan, INT_SCAN is set for T = int
+#ifdef INT_SCAN
+
+// LSD radix sort: bits per digit and digit values
+#define RADIX_BITS 4
+#define RADIX (1 << RADIX_BITS)
+
+/**
+ * Digit counts of the keys of tile g, digit-major in counts[digit * groups + g],
+ * so that an exclusive scan of counts gives the first output position of every
+ * digit of every tile. Work-item w of a tile owns its ITEMS consecutive keys.
+ */
+__kernel void radix_histogram_kernel(
+    __global const uint* keys, const int n, const int shift, __global int* counts, const int groups,
+    __local int* histogram
+) {
+    int lid = get_local_id(0);
+    long base = ((long)get_group_id(0) * get_local_size(0) + lid) * ITEMS;
+
+    if (lid < RADIX) {
+        histogram[lid] = 0;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for (int j = 0; j < ITEMS; ++j) {
+        if (base + j < n) {
+            atomic_inc(&histogram[(keys[base + j] >> shift) & (RADIX - 1)]);
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    if (lid < RADIX) {
+        counts[lid * groups + get_group_id(0)] = histogram[lid];
+    }
+}
+
+/**
+ * Stable scatter of tile g by one digit. The keys of the tile are ranked
+ * through an exclusive scan of the per work-item digit counts in local
+ * memory, digit-major, then written from the scanned global counts.
+ *
+ * offsets: Exclusive scan of the counts of radix_histogram_kernel
+ * values_in, values_out: Payload moved with the keys, NULL to sort keys only
+ * counts: RADIX x local size ints
+ * sums: local size ints
+ */
+__kernel void radix_scatter_kernel(
+    __global const uint* keys_in, __global const int* values_in, const int n, const int shift,
+    __global const int* offsets, const int groups, __global uint* keys_out, __global int* values_out,
+    __local int* counts, __local int* sums
+) {
+    int lid = get_local_id(0);
+    int size = get_local_size(0);
+    long base = ((long)get_group_id(0) * size + lid) * ITEMS;
+    __local int starts[RADIX];
+    uint keys[ITEMS];
+    int total;
+
+    for (int d = 0; d < RADIX; ++d) {
+        counts[d * size + lid] = 0;
+    }
+    for (int j = 0; j < ITEMS; ++j) {
+        if (base + j < n) {
+            keys[j] = keys_in[base + j];
+            counts[((keys[j] >> shift) & (RADIX - 1)) * size + lid] += 1;
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Exclusive scan of the RADIX x size counts, RADIX consecutive ones per work-item
+    int run = 0;
+    for (int d = 0; d < RADIX; ++d) {
+        run += counts[lid * RADIX + d];
+    }
+    int prefix = group_exclusive_scan(sums, run, &total);
+    for (int d = 0; d < RADIX; ++d) {
+        int count = counts[lid * RADIX + d];
+        counts[lid * RADIX + d] = prefix;
+        prefix += count;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    if (lid < RADIX) {
+        starts[lid] = counts[lid * size];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Tile position of each key, moved to its digit's place in the output
+    for (int j = 0; j < ITEMS; ++j) {
+        if (base + j < n) {
+            int digit = (keys[j] >> shift) & (RADIX - 1);
+            int rank = counts[digit * size + lid]++ - starts[digit];
+            int position = offsets[digit * groups + get_group_id(0)] + rank;
+            keys_out[position] = keys[j];
+            if (values_in != 0) {
+                values_out[position] = values_in[base + j];
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,72 @@
+/**
+ * STREAM kernels. The element type and vector width are chosen at build time:
+ *
+ * T: scalar type (int, float, double)
+ * W: vector width (1, 2, 4, 8, 16)
+ * USE_FP64: enable cl_khr_fp64 for double arrays
+ *
+ * n is the number of W-wide elements of each array.
+ */
+#ifdef USE_FP64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+#ifndef T
+#define T int
+#endif
+#ifndef W
+#define W 1
+#endif
+
+#define CAT_(a, b) a##b
+#define CAT(a, b) CAT_(a, b)
+#if W == 1
+#define VT T
+#else
+#define VT CAT(T, W)
+#endif
+
+/**
+ * c = a
+ */
+__kernel void stream_copy_kernel(__global const VT* a, __global VT* c, const int n)
+{
+    int i = get_global_id(0);
+    if (i < n) {
+        c[i] = a[i];
+    }
+}
+
+/**
+ * b = scalar * c
+ */
+__kernel void stream_scale_kernel(__global VT* b, __global const VT* c, const T scalar, const int n)
+{
+    int i = get_global_id(0);
+    if (i < n) {
+        b[i] = scalar * c[i];
+    }
+}
+
+/**
+ * c = a + b
+ */
+__kernel void stream_add_kernel(__global const VT* a, __global const VT* b, __global VT* c, const int n)
+{
+    int i = get_global_id(0);
+    if (i < n) {
+        c[i] = a[i] + b[i];
+    }
+}
+
+/**
+ * a = b + scalar * c
+ */
+__kernel void stream_triad_kernel(__global VT* a, __global const VT* b, __global const VT* c,
+    const T scalar, const int n)
+{
+    int i = get_global_id(0);
+    if (i < n) {
+        a[i] = b[i] + scalar * c[i];
+    }
+}
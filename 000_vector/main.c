@@ -1,161 +1,111 @@
+#include "buffer_pool.h"
+#include "dispatch.h"
+#include "fused.h"
 #include "kernel_loader.h"
+#include "philox.h"
+#include "pipeline.h"
+#include "reduce.h"
+#include "scan.h"
+#include "sort.h"
+#include "stream.h"
 
 #define CL_TARGET_OPENCL_VERSION 220
 #include <CL/cl.h>
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #define MIN 1
 #define MAX 100
 
-int main(void)
-{
-//Initialize
-    int i;
-    cl_int err;
-    int error_code;
-    int VECTOR_SIZE = 1;
+// Largest vector length of the size-doubling loop
+#define MAX_VECTOR_SIZE (1 << 28)
 
-    // Get platform
-    cl_uint n_platforms;
-	cl_platform_id platform_id;
-    err = clGetPlatformIDs(1, &platform_id, &n_platforms);
-	if (err != CL_SUCCESS) {
-		printf("[ERROR] Error calling clGetPlatformIDs. Error code: %d\n", err);
-		return 0;
-	}
+// Philox seeds of the input vectors
+#define SEED_A 1
+#define SEED_B 2
 
-    // Get device
-	cl_device_id device_id;
-	cl_uint n_devices;
-	err = clGetDeviceIDs(
-		platform_id,
-		CL_DEVICE_TYPE_GPU,
-		1,
-		&device_id,
-		&n_devices
-	);
-	if (err != CL_SUCCESS) {
-		printf("[ERROR] Error calling clGetDeviceIDs. Error code: %d\n", err);
-		return 0;
-	}
+// Elements of the result checked against the host at each length
+#define VERIFIED_ELEMENTS 65536
 
-    // Create OpenCL context
-    cl_context context = clCreateContext(NULL, n_devices, &device_id, NULL, NULL, NULL);
+// Default size of each STREAM array in MiB, large enough to defeat the caches
+#define STREAM_ARRAY_MIB 128
 
-    // Build the program
-    const char* kernel_code = load_kernel_source("kernels/vector_add.cl", &error_code);
-    if (error_code != 0) {
-        printf("Source code loading error!\n");
-        return 0;
-    }
-    cl_program program = clCreateProgramWithSource(context, 1, &kernel_code, NULL, NULL);
-    const char options[] = "";
-    err = clBuildProgram(
-        program,
-        1,
-        &device_id,
-        options,
-        NULL,
-        NULL
-    );
-    if (err != CL_SUCCESS) {
-        printf("Build error! Code: %d\n", err);
-        size_t real_size;
-        err = clGetProgramBuildInfo(
-            program,
-            device_id,
-            CL_PROGRAM_BUILD_LOG,
-            0,
-            NULL,
-            &real_size
-        );
-        char* build_log = (char*)malloc(sizeof(char) * (real_size + 1));
-        err = clGetProgramBuildInfo(
-            program,
-            device_id,
-            CL_PROGRAM_BUILD_LOG,
-            real_size + 1,
-            build_log,
-            &real_size
-        );
-        printf("Build log: %s\n", build_log);
-        free(build_log);
-        return 0;
-    }
-//Initialize
+// Timed launches per STREAM kernel, transfer and latency measurement
+#define STREAM_REPEATS 10
+#define LATENCY_REPEATS 100
 
-    cl_kernel kernel = clCreateKernel(program, "vector_add_kernel", NULL);
+// Lengths of the dispatch sweep
+#define MIN_DISPATCH_LENGTH (1 << 8)
+#define MAX_DISPATCH_LENGTH (1 << 26)
 
+// Default length of the reduction benchmark
+#define REDUCE_LENGTH (1 << 24)
 
+// Relative error allowed for floating-point sums, which depend on the order
+#define REDUCE_TOLERANCE 1e-4
 
-    // File for data
-    FILE *file = fopen("output.txt", "w");
-    if (file == NULL) {
-        // Error handling if the file couldn't be opened
-        printf("Error opening file!\n");
-        return 1;
-    }
+// Default length of the scan and compaction benchmark
+#define SCAN_LENGTH (1 << 24)
 
-for (int j = 0; j<5000; ++j){
-    VECTOR_SIZE *= 2;
-    srand(time(NULL));
+// Values of the compaction input, zeros are dropped
+#define COMPACT_MIN 0
+#define COMPACT_MAX 3
 
-    // Create the host buffers and initialize them
-    int* host_buffer_a = (int*)malloc(VECTOR_SIZE * sizeof(int));
-    int* host_buffer_b = (int*)malloc(VECTOR_SIZE * sizeof(int));
-    int* host_buffer_result = (int*)malloc(VECTOR_SIZE * sizeof(int));
+// Default length of the sort benchmark and timed device sorts per key range
+#define SORT_LENGTH 50000000
+#define SORT_REPEATS 3
 
-    for (i = 0; i < VECTOR_SIZE; ++i) {
-        // Random number between MIN and MAX
-        host_buffer_a[i] = MIN + rand() % (MAX - MIN + 1); 
-        host_buffer_b[i] = MIN + rand() % (MAX - MIN + 1); 
-    }
+// Default size of each vector of the pipeline benchmark in MiB
+#define PIPELINE_MIB 128
 
-    // Create the device buffers
-    cl_mem device_buffer_a = clCreateBuffer(context, CL_MEM_READ_ONLY, VECTOR_SIZE * sizeof(int), NULL, NULL);
-    cl_mem device_buffer_b = clCreateBuffer(context, CL_MEM_READ_ONLY, VECTOR_SIZE * sizeof(int), NULL, NULL);
-    cl_mem device_buffer_result = clCreateBuffer(context, CL_MEM_WRITE_ONLY, VECTOR_SIZE * sizeof(int), NULL, NULL);
+static const int pipeline_chunks[] = { 2, 4, 8, 16, 32, 64 };
+#define N_PIPELINE_CHUNKS ((int)(sizeof(pipeline_chunks) / sizeof(pipeline_chunks[0])))
+
+// Default length of the fused expression benchmark
+#define FUSED_LENGTH (1 << 24)
+
+// Fused expression, its scalars, and the same computation one operation per kernel
+#define FUSED_EXPRESSION "r = a*x + b*y - z"
+#define FUSED_SCALARS "a,b"
+#define FUSED_A 2.0
+#define FUSED_B 3.0
+static const char* unfused_expressions[] = { "t = a*x", "u = b*y", "v = t + u", "r = v - z" };
+#define N_UNFUSED ((int)(sizeof(unfused_expressions) / sizeof(unfused_expressions[0])))
+
+static const int stream_widths[] = { 1, 2, 4, 8, 16 };
+#define N_STREAM_WIDTHS ((int)(sizeof(stream_widths) / sizeof(stream_widths[0])))
+
+/**
+ * Fill a and b on the device, time vector_add_kernel over length elements
+ * and check the result against the host sequences. The kernel time is
+ * printed and appended to file.
+ *
+ * Returns CL_SUCCESS or the error of the profiling query
+ */
+static cl_int time_vector_add(cl_command_queue command_queue, cl_kernel kernel, RandomFill* random,
+    cl_mem device_buffer_a, cl_mem device_buffer_b, cl_mem device_buffer_result,
+    int* host_buffer_result, int length, FILE* file)
+{
+    int i;
+    cl_int err;
 
     // Set kernel arguments
     clSetKernelArg(kernel, 0, sizeof(cl_mem), (void*)&device_buffer_a);
     clSetKernelArg(kernel, 1, sizeof(cl_mem), (void*)&device_buffer_b);
     clSetKernelArg(kernel, 2, sizeof(cl_mem), (void*)&device_buffer_result);
-    clSetKernelArg(kernel, 3, sizeof(int), (void*)&VECTOR_SIZE);
+    clSetKernelArg(kernel, 3, sizeof(int), (void*)&length);
 
-    // Create the command queue
-    cl_command_queue command_queue = clCreateCommandQueue(
-        context, device_id, CL_QUEUE_PROFILING_ENABLE, NULL);
-
-    // Host buffer -> Device buffer
-    clEnqueueWriteBuffer(
-        command_queue,
-        device_buffer_a,
-        CL_FALSE,
-        0,
-        VECTOR_SIZE * sizeof(int),
-        host_buffer_a,
-        0,
-        NULL,
-        NULL
-    );
-    clEnqueueWriteBuffer(
-        command_queue,
-        device_buffer_b,
-        CL_FALSE,
-        0,
-        VECTOR_SIZE * sizeof(int),
-        host_buffer_b,
-        0,
-        NULL,
-        NULL
-    );
+    // Random numbers between MIN and MAX, generated in place
+    random_fill(random, command_queue, device_buffer_a, 0, 1, length, length, SEED_A, MIN, MAX, NULL);
+    random_fill(random, command_queue, device_buffer_b, 0, 1, length, length, SEED_B, MIN, MAX, NULL);
 
     // Size specification
     size_t local_work_size = 256;
-    size_t n_work_groups = (VECTOR_SIZE + local_work_size - 1) / local_work_size;
+    size_t n_work_groups = (length + local_work_size - 1) / local_work_size;
     size_t global_work_size = n_work_groups * local_work_size;
 
     // Apply the kernel on the range
@@ -173,22 +123,24 @@ for (int j = 0; j<5000; ++j){
     );
     clFinish(command_queue);
 
-    // Show profiling information
+    // Show profiling information, from the start of the kernel so queueing is not counted
     cl_ulong start_ns;
     cl_ulong end_ns;
     err = clGetEventProfilingInfo(
         event,
-        CL_PROFILING_COMMAND_QUEUED,
+        CL_PROFILING_COMMAND_START,
         sizeof(start_ns),
         &start_ns,
         NULL
     );
     if (err == CL_PROFILING_INFO_NOT_AVAILABLE) {
         printf("Profiling info not available!\n");
-        return 0;
+        clReleaseEvent(event);
+        return err;
     } else if (err != CL_SUCCESS) {
         printf("Error code: %d\n", err);
-        return 0;
+        clReleaseEvent(event);
+        return err;
     }
     clGetEventProfilingInfo(
         event,
@@ -197,9 +149,10 @@ for (int j = 0; j<5000; ++j){
         &end_ns,
         NULL
     );
+    clReleaseEvent(event);
     double total_time = (double)(end_ns-start_ns) / 1000000000.0;
-    printf("%d - Total length in secs: %.6f\n", VECTOR_SIZE, total_time);
-    fprintf(file, "%d %.6f\n", VECTOR_SIZE, total_time);
+    printf("%d - Total length in secs: %.6f\n", length, total_time);
+    fprintf(file, "%d %.6f\n", length, total_time);
     fflush(file);
 
     // Host buffer <- Device buffer
@@ -208,38 +161,1106 @@ for (int j = 0; j<5000; ++j){
         device_buffer_result,
         CL_TRUE,
         0,
-        VECTOR_SIZE * sizeof(int),
+        length * sizeof(int),
         host_buffer_result,
         0,
         NULL,
         NULL
     );
 
-    free(host_buffer_a);
-    free(host_buffer_b);
-    free(host_buffer_result);
+    // Check evenly spaced elements against the host sequences
+    int step = length > VERIFIED_ELEMENTS ? length / VERIFIED_ELEMENTS : 1;
+    int mismatches = 0;
+    for (i = 0; i < length; i += step) {
+        if (host_buffer_result[i] != philox_int(SEED_A, i, MIN, MAX) + philox_int(SEED_B, i, MIN, MAX)) {
+            ++mismatches;
+        }
+    }
+    if (mismatches > 0) {
+        printf("[ERROR] %d checked elements differ from the host result\n", mismatches);
+    }
+    return CL_SUCCESS;
 }
 
-//Print Values
-    for (i = 0; i < VECTOR_SIZE; ++i) {
-        //printf("Vector A: \t%d\t\n", host_buffer_a[i]);
+/**
+ * Time vector_add_kernel on int vectors of doubling length and write the
+ * kernel time of each length to output.txt. The inputs are generated on the
+ * device and the result is checked against the same sequences on the host.
+ */
+static int run_vector_add(cl_context context, cl_device_id device_id, cl_command_queue command_queue,
+    BufferPool* pool)
+{
+    cl_int err;
+    int VECTOR_SIZE;
+
+    // Build the program
+    cl_program program = build_program(context, device_id, "kernels/vector_add.cl", "", &err);
+    if (program == NULL) {
+        return 0;
+    }
+    cl_kernel kernel = clCreateKernel(program, "vector_add_kernel", NULL);
+    RandomFill random;
+    err = random_fill_init(&random, context, device_id, "");
+    if (err != CL_SUCCESS) {
+        printf("Random fill build error! Code: %d\n", err);
+        random_fill_release(&random);
+        clReleaseKernel(kernel);
+        clReleaseProgram(program);
+        return 0;
+    }
+
+    // File for data
+    FILE *file = fopen("output.txt", "w");
+    if (file == NULL) {
+        // Error handling if the file couldn't be opened
+        printf("Error opening file!\n");
+        random_fill_release(&random);
+        clReleaseKernel(kernel);
+        clReleaseProgram(program);
+        return 1;
     }
 
-    for (i = 0; i < VECTOR_SIZE; ++i) {
-        //printf("Vector B: \t%d\t\n", host_buffer_b[i]);
+    cl_ulong max_alloc_size;
+    clGetDeviceInfo(device_id, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(max_alloc_size), &max_alloc_size, NULL);
+
+for (VECTOR_SIZE = 2; VECTOR_SIZE <= MAX_VECTOR_SIZE && VECTOR_SIZE * sizeof(int) <= max_alloc_size; VECTOR_SIZE *= 2){
+    // Get the pinned host buffer of the result and the device buffers
+    cl_mem device_buffer_a = NULL, device_buffer_b = NULL, device_buffer_result = NULL;
+    int* host_buffer_result = (int*)buffer_pool_acquire_host(pool, VECTOR_SIZE * sizeof(int), &err);
+    if (host_buffer_result == NULL) {
+        printf("Host buffer allocation error! Code: %d\n", err);
+    } else {
+        device_buffer_a = buffer_pool_acquire(pool, VECTOR_SIZE * sizeof(int), &err);
+        device_buffer_b = buffer_pool_acquire(pool, VECTOR_SIZE * sizeof(int), &err);
+        device_buffer_result = buffer_pool_acquire(pool, VECTOR_SIZE * sizeof(int), &err);
+        if (device_buffer_a == NULL || device_buffer_b == NULL || device_buffer_result == NULL) {
+            printf("Device buffer allocation error! Code: %d\n", err);
+        } else {
+            err = time_vector_add(command_queue, kernel, &random, device_buffer_a, device_buffer_b,
+                device_buffer_result, host_buffer_result, VECTOR_SIZE, file);
+        }
     }
+    int done = device_buffer_result == NULL || device_buffer_a == NULL || device_buffer_b == NULL
+        || err != CL_SUCCESS;
 
-    for (i = 0; i < VECTOR_SIZE; ++i) {
-        //printf("Result: \t%d\t\n", host_buffer_result[i]);
+    // Every exit of an iteration hands its buffers back
+    buffer_pool_give_back(pool, device_buffer_a);
+    buffer_pool_give_back(pool, device_buffer_b);
+    buffer_pool_give_back(pool, device_buffer_result);
+    buffer_pool_give_back_host(pool, host_buffer_result);
+    if (done) {
+        break;
     }
-//Print Values
+}
 
-//Release Resources
+    random_fill_release(&random);
     clReleaseKernel(kernel);
     clReleaseProgram(program);
-    clReleaseContext(context);
-    clReleaseDevice(device_id);
+    fclose(file);
+    return 0;
+}
+
+/**
+ * Route vector additions of doubling length through the calibrated
+ * dispatcher and print the backend and wall time of each length.
+ */
+static int run_dispatch(cl_context context, cl_device_id device_id, cl_command_queue command_queue,
+    BufferPool* pool, int recalibrate)
+{
+    VectorDispatch dispatch;
+    struct timespec start, end;
+    char path[512];
+    cl_int err;
+    int n, i;
+
+    err = vector_dispatch_init(&dispatch, context, device_id, command_queue, pool, recalibrate);
+    if (err != CL_SUCCESS) {
+        printf("Dispatch error! Code: %d\n", err);
+        vector_dispatch_release(&dispatch);
+        return 0;
+    }
+    dispatch_config_path(device_id, path, sizeof(path));
+    if (dispatch.crossover >= 0) {
+        printf("Crossover: %ld elements (%s)\n", dispatch.crossover, path);
+    } else {
+        printf("Crossover: none, the CPU is always faster (%s)\n", path);
+    }
+
+    int* a = (int*)malloc(MAX_DISPATCH_LENGTH * sizeof(int));
+    int* b = (int*)malloc(MAX_DISPATCH_LENGTH * sizeof(int));
+    int* c = (int*)malloc(MAX_DISPATCH_LENGTH * sizeof(int));
+    philox_fill_int(a, MAX_DISPATCH_LENGTH, SEED_A, MIN, MAX);
+    philox_fill_int(b, MAX_DISPATCH_LENGTH, SEED_B, MIN, MAX);
+
+    for (n = MIN_DISPATCH_LENGTH; n <= MAX_DISPATCH_LENGTH; n *= 2) {
+        Backend backend;
+        timespec_get(&start, TIME_UTC);
+        err = vector_dispatch_add(&dispatch, a, b, c, n, &backend);
+        timespec_get(&end, TIME_UTC);
+        if (err != CL_SUCCESS) {
+            printf("%d - Error code: %d\n", n, err);
+            break;
+        }
+        for (i = 0; i < n && c[i] == a[i] + b[i]; ++i);
+        printf("%d - %-6s %.6f s%s\n", n, backend == BACKEND_DEVICE ? "device" : "cpu",
+            (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1000000000.0,
+            i < n ? "  MISMATCH" : "");
+    }
+
+    free(a);
+    free(b);
+    free(c);
+    vector_dispatch_release(&dispatch);
+    return 0;
+}
+
+static double wall_seconds(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+/**
+ * Reduce n random elements of every type with every operation on the device
+ * and with the host loop, and write the best times to a CSV file:
+ *
+ * device_s: Both kernel stages, from the profiling events
+ * host_s: Host loop over the same elements
+ * matches: The results agree (floating-point sums within REDUCE_TOLERANCE of the exact sum)
+ */
+static int run_reduce(cl_context context, cl_device_id device_id, cl_command_queue command_queue,
+    BufferPool* pool, int n, const char* csv_path)
+{
+    cl_int err;
+    int t, o, r;
+
+    FILE* file = fopen(csv_path, "w");
+    if (file == NULL) {
+        printf("Error opening file!\n");
+        return 1;
+    }
+    fprintf(file, "type,op,n,device_s,host_s,result,index,matches\n");
+    printf("%d elements (best of %d runs)\n", n, STREAM_REPEATS);
+    printf("%-7s %-7s %12s %12s %8s %s\n", "type", "op", "device s", "host s", "speedup", "result");
+
+    for (t = 0; t < STREAM_TYPES; ++t) {
+        StreamType type = (StreamType)t;
+        size_t size = (size_t)n * stream_type_size(type);
+        char options[64];
+        RandomFill random;
+
+        snprintf(options, sizeof(options), "-D ELEM_T=%s%s", stream_type_name(type),
+            type == STREAM_DOUBLE ? " -D USE_FP64" : "");
+        err = random_fill_init(&random, context, device_id, options);
+        if (err != CL_SUCCESS) {
+            printf("%-7s not supported by the device\n", stream_type_name(type));
+            random_fill_release(&random);
+            continue;
+        }
 
+        // Integer values of every type, so that the exact sum is known
+        cl_mem input = buffer_pool_acquire(pool, size, &err);
+        void* host_input = malloc(size);
+        double exact_sum = 0.0;
+        random_fill(&random, command_queue, input, 0, 1, n, n, SEED_A, MIN, MAX, NULL);
+        clEnqueueReadBuffer(command_queue, input, CL_TRUE, 0, size, host_input, 0, NULL, NULL);
+        for (r = 0; r < n; ++r) {
+            exact_sum += philox_int(SEED_A, r, MIN, MAX);
+        }
+
+        for (o = 0; o < REDUCE_OPS; ++o) {
+            ReduceOp op = (ReduceOp)o;
+            ReduceResult device_result, host_result;
+            double device_s = -1.0, host_s = -1.0, seconds;
+            Reducer reducer;
+
+            err = reducer_init(&reducer, context, device_id, pool, type, op);
+            // The first run is a warm-up
+            for (r = 0; r <= STREAM_REPEATS && err == CL_SUCCESS; ++r) {
+                err = reducer_run(&reducer, command_queue, input, n, &device_result, &seconds);
+                if (r > 0 && (device_s < 0.0 || seconds < device_s)) {
+                    device_s = seconds;
+                }
+            }
+            reducer_release(&reducer);
+            if (err != CL_SUCCESS) {
+                printf("%-7s %-7s error %d\n", stream_type_name(type), reduce_op_name(op), err);
+                continue;
+            }
+            for (r = 0; r <= STREAM_REPEATS; ++r) {
+                double start = wall_seconds();
+                reduce_cpu(type, op, host_input, n, &host_result);
+                seconds = wall_seconds() - start;
+                if (r > 0 && (host_s < 0.0 || seconds < host_s)) {
+                    host_s = seconds;
+                }
+            }
+
+            int matches = device_result.index == host_result.index;
+            if (op != REDUCE_SUM) {
+                matches = matches && device_result.as_double == host_result.as_double;
+            } else if (type == STREAM_INT) {
+                matches = matches && device_result.as_long == (cl_long)exact_sum;
+            } else {
+                matches = matches && fabs(device_result.as_double - exact_sum) <= REDUCE_TOLERANCE * exact_sum;
+            }
+            printf("%-7s %-7s %12.6f %12.6f %8.2f %.0f", stream_type_name(type), reduce_op_name(op),
+                device_s, host_s, host_s / device_s, device_result.as_double);
+            if (op == REDUCE_ARGMIN) {
+                printf(" at %d", device_result.index);
+            }
+            printf("%s\n", matches ? "" : "  MISMATCH");
+            fprintf(file, "%s,%s,%d,%.9f,%.9f,%.17g,%d,%s\n", stream_type_name(type), reduce_op_name(op), n,
+                device_s, host_s, device_result.as_double, device_result.index, matches ? "yes" : "no");
+            fflush(file);
+        }
+
+        free(host_input);
+        buffer_pool_give_back(pool, input);
+        random_fill_release(&random);
+    }
+
+    printf("Results written to %s\n", csv_path);
     fclose(file);
+    return 0;
+}
+
+/**
+ * Check a device scan against the exact scan of the integer input, within
+ * REDUCE_TOLERANCE for floating-point types.
+ */
+static int check_scan(StreamType type, const void* output, const double* exact, int n)
+{
+    int i;
+
+    for (i = 0; i < n; ++i) {
+        double element = type == STREAM_INT ? ((const cl_int*)output)[i]
+            : type == STREAM_FLOAT ? ((const cl_float*)output)[i] : ((const cl_double*)output)[i];
+        if (fabs(element - exact[i]) > (type == STREAM_INT ? 0.0 : REDUCE_TOLERANCE * exact[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Scan n random elements of every type exclusively and inclusively, then
+ * compact n random uints, on the device and with the host loop. The best
+ * times are written to a CSV file:
+ *
+ * device_s: Wall time of the kernels, the results stay on the device
+ * host_s: Host loop over the same elements
+ * gbs: Device bandwidth counting one read of the input and one write of the output
+ * verified: The device result matches the host one
+ */
+static int run_scan(cl_context context, cl_device_id device_id, cl_command_queue command_queue,
+    BufferPool* pool, int n, const char* csv_path)
+{
+    cl_ulong max_alloc_size;
+    cl_int err;
+    int t, inclusive, r, i;
+
+    FILE* file = fopen(csv_path, "w");
+    if (file == NULL) {
+        printf("Error opening file!\n");
+        return 1;
+    }
+    fprintf(file, "test,type,n,device_s,host_s,gbs,verified\n");
+
+    // Every array must fit in one allocation
+    clGetDeviceInfo(device_id, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(max_alloc_size), &max_alloc_size, NULL);
+    while ((cl_ulong)n * sizeof(cl_double) > max_alloc_size) {
+        n /= 2;
+    }
+    printf("%d elements (best of %d runs)\n", n, STREAM_REPEATS);
+    printf("%-10s %-7s %12s %12s %8s\n", "test", "type", "device s", "host s", "GB/s");
+
+    double* exact = (double*)malloc((size_t)n * sizeof(double));
+    for (t = 0; t < STREAM_TYPES; ++t) {
+        StreamType type = (StreamType)t;
+        size_t size = (size_t)n * stream_type_size(type);
+        char options[64];
+        RandomFill random;
+        Scanner scanner;
+        cl_mem input = NULL, output = NULL;
+        void* host_input = NULL;
+        void* host_output = NULL;
+
+        memset(&random, 0, sizeof(random));
+        snprintf(options, sizeof(options), "-D ELEM_T=%s%s", stream_type_name(type),
+            type == STREAM_DOUBLE ? " -D USE_FP64" : "");
+        err = scanner_init(&scanner, context, device_id, pool, type);
+        if (err == CL_SUCCESS) {
+            err = random_fill_init(&random, context, device_id, options);
+        }
+        if (err != CL_SUCCESS) {
+            printf("%-10s %-7s not supported by the device\n", "scan", stream_type_name(type));
+        } else {
+            input = buffer_pool_acquire(pool, size, &err);
+            if (err == CL_SUCCESS) {
+                output = buffer_pool_acquire(pool, size, &err);
+            }
+            if (err != CL_SUCCESS) {
+                printf("%-10s %-7s error %d\n", "scan", stream_type_name(type), err);
+            }
+        }
+        if (err == CL_SUCCESS) {
+            host_input = malloc(size);
+            host_output = malloc(size);
+            random_fill(&random, command_queue, input, 0, 1, n, n, SEED_A, MIN, MAX, NULL);
+            clEnqueueReadBuffer(command_queue, input, CL_TRUE, 0, size, host_input, 0, NULL, NULL);
+        }
+
+        for (inclusive = 0; inclusive <= 1 && err == CL_SUCCESS; ++inclusive) {
+            const char* test = inclusive ? "inclusive" : "exclusive";
+            double device_s = -1.0, host_s = -1.0, seconds;
+            double sum = 0.0;
+
+            // The first run is a warm-up
+            for (r = 0; r <= STREAM_REPEATS && err == CL_SUCCESS; ++r) {
+                double start = wall_seconds();
+                err = scanner_run(&scanner, command_queue, input, output, n, inclusive);
+                clFinish(command_queue);
+                seconds = wall_seconds() - start;
+                if (r > 0 && (device_s < 0.0 || seconds < device_s)) {
+                    device_s = seconds;
+                }
+            }
+            if (err != CL_SUCCESS) {
+                printf("%-10s %-7s error %d\n", test, stream_type_name(type), err);
+                break;
+            }
+            for (r = 0; r <= STREAM_REPEATS; ++r) {
+                double start = wall_seconds();
+                scan_cpu(type, host_input, host_output, n, inclusive);
+                seconds = wall_seconds() - start;
+                if (r > 0 && (host_s < 0.0 || seconds < host_s)) {
+                    host_s = seconds;
+                }
+            }
+
+            for (i = 0; i < n; ++i) {
+                int element = philox_int(SEED_A, i, MIN, MAX);
+                exact[i] = inclusive ? sum + element : sum;
+                sum += element;
+            }
+            clEnqueueReadBuffer(command_queue, output, CL_TRUE, 0, size, host_output, 0, NULL, NULL);
+            int verified = check_scan(type, host_output, exact, n);
+            double gbs = 2.0 * size / device_s / 1e9;
+            printf("%-10s %-7s %12.6f %12.6f %8.2f%s\n", test, stream_type_name(type), device_s, host_s, gbs,
+                verified ? "" : "  MISMATCH");
+            fprintf(file, "%s,%s,%d,%.9f,%.9f,%.3f,%s\n", test, stream_type_name(type), n, device_s, host_s, gbs,
+                verified ? "yes" : "no");
+            fflush(file);
+        }
+
+        // Every path of the type ends here
+        free(host_input);
+        free(host_output);
+        if (input != NULL) {
+            buffer_pool_give_back(pool, input);
+        }
+        if (output != NULL) {
+            buffer_pool_give_back(pool, output);
+        }
+        random_fill_release(&random);
+        scanner_release(&scanner);
+    }
+    free(exact);
+
+    // Compaction of uints in [COMPACT_MIN, COMPACT_MAX], dropping the zeros
+    Compactor compactor;
+    RandomFill random;
+    size_t size = (size_t)n * sizeof(cl_uint);
+    cl_mem input = NULL, output = NULL;
+    cl_uint* host_input = NULL;
+    cl_uint* host_output = NULL;
+    cl_uint* device_output = NULL;
+
+    memset(&random, 0, sizeof(random));
+    err = compactor_init(&compactor, context, device_id, pool);
+    if (err == CL_SUCCESS) {
+        err = random_fill_init(&random, context, device_id, "-D ELEM_T=uint");
+    }
+    if (err != CL_SUCCESS) {
+        printf("Compaction build error! Code: %d\n", err);
+    } else {
+        input = buffer_pool_acquire(pool, size, &err);
+        if (err == CL_SUCCESS) {
+            output = buffer_pool_acquire(pool, size, &err);
+        }
+        if (err != CL_SUCCESS) {
+            printf("Compaction error! Code: %d\n", err);
+        }
+    }
+    if (err == CL_SUCCESS) {
+        double device_s = -1.0, host_s = -1.0, seconds;
+        int count = 0, host_count = 0;
+
+        host_input = (cl_uint*)malloc(size);
+        host_output = (cl_uint*)malloc(size);
+        device_output = (cl_uint*)malloc(size);
+        random_fill(&random, command_queue, input, 0, 1, n, n, SEED_B, COMPACT_MIN, COMPACT_MAX, NULL);
+        clEnqueueReadBuffer(command_queue, input, CL_TRUE, 0, size, host_input, 0, NULL, NULL);
+        for (r = 0; r <= STREAM_REPEATS && err == CL_SUCCESS; ++r) {
+            double start = wall_seconds();
+            err = compactor_run(&compactor, command_queue, input, n, 0xFFFFFFFFu, output, NULL, &count);
+            seconds = wall_seconds() - start;
+            if (r > 0 && (device_s < 0.0 || seconds < device_s)) {
+                device_s = seconds;
+            }
+        }
+        for (r = 0; r <= STREAM_REPEATS; ++r) {
+            double start = wall_seconds();
+            host_count = compact_cpu(host_input, n, 0xFFFFFFFFu, host_output);
+            seconds = wall_seconds() - start;
+            if (r > 0 && (host_s < 0.0 || seconds < host_s)) {
+                host_s = seconds;
+            }
+        }
+        if (err == CL_SUCCESS) {
+            if (count > 0) {
+                clEnqueueReadBuffer(command_queue, output, CL_TRUE, 0, (size_t)count * sizeof(cl_uint),
+                    device_output, 0, NULL, NULL);
+            }
+            int verified = count == host_count
+                && memcmp(device_output, host_output, (size_t)count * sizeof(cl_uint)) == 0;
+            double gbs = (double)(size + (size_t)count * sizeof(cl_uint)) / device_s / 1e9;
+            printf("%-10s %-7s %12.6f %12.6f %8.2f  %d kept%s\n", "compact", "uint", device_s, host_s, gbs, count,
+                verified ? "" : "  MISMATCH");
+            fprintf(file, "compact,uint,%d,%.9f,%.9f,%.3f,%s\n", n, device_s, host_s, gbs, verified ? "yes" : "no");
+        } else {
+            printf("Compaction error! Code: %d\n", err);
+        }
+    }
+
+    // Every path of the compaction ends here
+    free(host_input);
+    free(host_output);
+    free(device_output);
+    if (input != NULL) {
+        buffer_pool_give_back(pool, input);
+    }
+    if (output != NULL) {
+        buffer_pool_give_back(pool, output);
+    }
+    random_fill_release(&random);
+    compactor_release(&compactor);
+
+    printf("Results written to %s\n", csv_path);
+    fclose(file);
+    return 0;
+}
+
+/**
+ * Key and payload of the host reference sort.
+ */
+typedef struct {
+    cl_uint key;
+    cl_int value;
+} KeyValue;
+
+/**
+ * Order by key, then by payload, which gives the order of a stable sort
+ * when the payloads are the input indices.
+ */
+static int compare_key_values(const void* a, const void* b)
+{
+    const KeyValue* x = (const KeyValue*)a;
+    const KeyValue* y = (const KeyValue*)b;
+
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    return (x->value > y->value) - (x->value < y->value);
+}
+
+/**
+ * Radix sort n random keys with their indices as payload, once over random uint
+ * keys (32 key bits) and once over packed RGB keys (24 key bits), and compare
+ * with qsort. The results are written to a CSV file:
+ *
+ * device_s: Best wall time of the sort over SORT_REPEATS runs, keys on the device
+ * host_s: qsort of the key and payload pairs
+ * mkeys_s: Device throughput in millions of keys per second
+ * verified: Keys and payloads match the stable host order
+ */
+static int run_sort(cl_context context, cl_device_id device_id, cl_command_queue command_queue,
+    BufferPool* pool, int n, const char* csv_path)
+{
+    static const char* tests[] = { "uint", "rgb" };
+    static const int key_bits[] = { 32, 24 };
+    static const cl_uint max_keys[] = { 0xFFFFFFFFu, 0xFFFFFFu };
+    cl_ulong max_alloc_size;
+    RadixSorter sorter;
+    RandomFill random;
+    cl_int err;
+    int t, r, i;
+
+    FILE* file = fopen(csv_path, "w");
+    if (file == NULL) {
+        printf("Error opening file!\n");
+        return 1;
+    }
+    fprintf(file, "test,key_bits,n,device_s,host_s,mkeys_s,verified\n");
+
+    clGetDeviceInfo(device_id, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(max_alloc_size), &max_alloc_size, NULL);
+    while ((cl_ulong)n * sizeof(cl_uint) > max_alloc_size) {
+        n /= 2;
+    }
+    size_t size = (size_t)n * sizeof(cl_uint);
+    cl_mem original_keys = NULL, original_values = NULL, keys = NULL, values = NULL;
+    KeyValue* pairs = NULL;
+    cl_uint* host_keys = NULL;
+    cl_int* host_values = NULL;
+
+    memset(&random, 0, sizeof(random));
+    err = radix_sorter_init(&sorter, context, device_id, pool);
+    if (err == CL_SUCCESS) {
+        err = random_fill_init(&random, context, device_id, "-D ELEM_T=uint");
+    }
+    if (err != CL_SUCCESS) {
+        printf("Sort build error! Code: %d\n", err);
+    } else {
+        original_keys = buffer_pool_acquire(pool, size, &err);
+        if (err == CL_SUCCESS) {
+            original_values = buffer_pool_acquire(pool, size, &err);
+        }
+        if (err == CL_SUCCESS) {
+            keys = buffer_pool_acquire(pool, size, &err);
+        }
+        if (err == CL_SUCCESS) {
+            values = buffer_pool_acquire(pool, size, &err);
+        }
+        if (err != CL_SUCCESS) {
+            printf("Sort error! Code: %d\n", err);
+        }
+    }
+    if (err == CL_SUCCESS) {
+        printf("%d keys (best of %d device runs)\n", n, SORT_REPEATS);
+        printf("%-5s %4s %12s %12s %10s\n", "test", "bits", "device s", "qsort s", "Mkeys/s");
+        pairs = (KeyValue*)malloc((size_t)n * sizeof(KeyValue));
+        host_keys = (cl_uint*)malloc(size);
+        host_values = (cl_int*)malloc(size);
+
+        // The payload is the input index
+        for (i = 0; i < n; ++i) {
+            host_values[i] = i;
+        }
+        clEnqueueWriteBuffer(command_queue, original_values, CL_TRUE, 0, size, host_values, 0, NULL, NULL);
+    }
+
+    for (t = 0; t < 2 && err == CL_SUCCESS; ++t) {
+        double device_s = -1.0, host_s, seconds;
+
+        // [0, (int)0xFFFFFFFF] wraps to the full 32-bit range, so the top key bit is set too
+        random_fill(&random, command_queue, original_keys, 0, 1, n, n, SEED_A, 0, (int)max_keys[t], NULL);
+        clEnqueueReadBuffer(command_queue, original_keys, CL_TRUE, 0, size, host_keys, 0, NULL, NULL);
+
+        // The first run is a warm-up, each run sorts a fresh copy
+        for (r = 0; r <= SORT_REPEATS && err == CL_SUCCESS; ++r) {
+            clEnqueueCopyBuffer(command_queue, original_keys, keys, 0, 0, size, 0, NULL, NULL);
+            clEnqueueCopyBuffer(command_queue, original_values, values, 0, 0, size, 0, NULL, NULL);
+            clFinish(command_queue);
+            double start = wall_seconds();
+            err = radix_sort(&sorter, command_queue, keys, values, n, key_bits[t]);
+            clFinish(command_queue);
+            seconds = wall_seconds() - start;
+            if (r > 0 && (device_s < 0.0 || seconds < device_s)) {
+                device_s = seconds;
+            }
+        }
+        if (err != CL_SUCCESS) {
+            printf("%-5s error %d\n", tests[t], err);
+            break;
+        }
+
+        for (i = 0; i < n; ++i) {
+            pairs[i].key = host_keys[i];
+            pairs[i].value = i;
+        }
+        double start = wall_seconds();
+        qsort(pairs, (size_t)n, sizeof(KeyValue), compare_key_values);
+        host_s = wall_seconds() - start;
+
+        clEnqueueReadBuffer(command_queue, keys, CL_FALSE, 0, size, host_keys, 0, NULL, NULL);
+        clEnqueueReadBuffer(command_queue, values, CL_TRUE, 0, size, host_values, 0, NULL, NULL);
+        int verified = 1;
+        for (i = 0; i < n && verified; ++i) {
+            verified = host_keys[i] == pairs[i].key && host_values[i] == pairs[i].value;
+        }
+        printf("%-5s %4d %12.6f %12.6f %10.1f%s\n", tests[t], key_bits[t], device_s, host_s, n / device_s / 1e6,
+            verified ? "" : "  MISMATCH");
+        fprintf(file, "%s,%d,%d,%.9f,%.9f,%.3f,%s\n", tests[t], key_bits[t], n, device_s, host_s,
+            n / device_s / 1e6, verified ? "yes" : "no");
+        fflush(file);
+    }
+
+    // Every path ends here
+    free(pairs);
+    free(host_keys);
+    free(host_values);
+    if (original_keys != NULL) {
+        buffer_pool_give_back(pool, original_keys);
+    }
+    if (original_values != NULL) {
+        buffer_pool_give_back(pool, original_values);
+    }
+    if (keys != NULL) {
+        buffer_pool_give_back(pool, keys);
+    }
+    if (values != NULL) {
+        buffer_pool_give_back(pool, values);
+    }
+    random_fill_release(&random);
+    radix_sorter_release(&sorter);
+    printf("Results written to %s\n", csv_path);
+    fclose(file);
+    return 0;
+}
+
+/**
+ * Check c = a + b on the host.
+ */
+static int check_add(const int* a, const int* b, const int* c, int n)
+{
+    int i;
+
+    for (i = 0; i < n; ++i) {
+        if (c[i] != a[i] + b[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * vector_add_kernel on pinned host vectors, serialized on one queue and then
+ * pipelined in chunks over three queues. The best wall times are written to
+ * a CSV file, with the transfer and kernel times of the serialized run: a
+ * pipelined run approaches max(upload + download, kernel) when the copy
+ * engines and the kernel overlap, or max(upload, download, kernel) when the
+ * device also copies both ways at once.
+ */
+static int run_pipeline(cl_context context, cl_device_id device_id, cl_command_queue command_queue,
+    BufferPool* pool, size_t vector_bytes, const char* csv_path)
+{
+    cl_command_queue queues[PIPELINE_QUEUES];
+    cl_ulong max_alloc_size;
+    SerialResult serial, best_serial;
+    cl_int err = CL_SUCCESS;
+    int q, k, r;
+
+    FILE* file = fopen(csv_path, "w");
+    if (file == NULL) {
+        printf("Error opening file!\n");
+        return 1;
+    }
+    fprintf(file, "mode,chunks,bytes,wall_s,gbs,upload_s,kernel_s,download_s,verified\n");
+
+    clGetDeviceInfo(device_id, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(max_alloc_size), &max_alloc_size, NULL);
+    while (vector_bytes > max_alloc_size) {
+        vector_bytes /= 2;
+    }
+    int n = (int)(vector_bytes / sizeof(int));
+    cl_program program = build_program(context, device_id, "kernels/vector_add.cl", "", &err);
+    if (program == NULL) {
+        fclose(file);
+        return 0;
+    }
+    cl_kernel kernel = clCreateKernel(program, "vector_add_kernel", NULL);
+    // The main queue uploads, two more run the kernels and the downloads
+    queues[0] = command_queue;
+    for (q = 1; q < PIPELINE_QUEUES; ++q) {
+        queues[q] = clCreateCommandQueue(context, device_id, CL_QUEUE_PROFILING_ENABLE, NULL);
+    }
+
+    int* a = (int*)buffer_pool_acquire_host(pool, vector_bytes, &err);
+    int* b = (int*)buffer_pool_acquire_host(pool, vector_bytes, &err);
+    int* c = (int*)buffer_pool_acquire_host(pool, vector_bytes, &err);
+    philox_fill_int(a, n, SEED_A, MIN, MAX);
+    philox_fill_int(b, n, SEED_B, MIN, MAX);
+
+    // Bytes moved: two vectors up and one down
+    double bytes = 3.0 * vector_bytes;
+    printf("%zu MiB per vector (best of %d runs)\n", vector_bytes >> 20, STREAM_REPEATS);
+
+    // The first run is a warm-up
+    best_serial.wall_s = -1.0;
+    for (r = 0; r <= STREAM_REPEATS && err == CL_SUCCESS; ++r) {
+        err = vector_add_serial(queues[0], pool, kernel, a, b, c, n, &serial);
+        if (r > 0 && (best_serial.wall_s < 0.0 || serial.wall_s < best_serial.wall_s)) {
+            best_serial = serial;
+        }
+    }
+    if (err != CL_SUCCESS) {
+        printf("Serial error! Code: %d\n", err);
+    } else {
+        int verified = check_add(a, b, c, n);
+        printf("serial      %.6f s %8.2f GB/s (upload %.6f s, kernel %.6f s, download %.6f s)%s\n",
+            best_serial.wall_s, bytes / best_serial.wall_s / 1e9, best_serial.upload_s, best_serial.kernel_s,
+            best_serial.download_s, verified ? "" : "  MISMATCH");
+        printf("bound       %.6f s overlapping copies and kernel, %.6f s with both copy directions too\n",
+            fmax(best_serial.upload_s + best_serial.download_s, best_serial.kernel_s),
+            fmax(fmax(best_serial.upload_s, best_serial.download_s), best_serial.kernel_s));
+        fprintf(file, "serial,1,%zu,%.9f,%.3f,%.9f,%.9f,%.9f,%s\n", vector_bytes, best_serial.wall_s,
+            bytes / best_serial.wall_s / 1e9, best_serial.upload_s, best_serial.kernel_s, best_serial.download_s,
+            verified ? "yes" : "no");
+    }
+
+    for (k = 0; k < N_PIPELINE_CHUNKS && err == CL_SUCCESS; ++k) {
+        double best = -1.0, seconds;
+        memset(c, 0, vector_bytes);
+        for (r = 0; r <= STREAM_REPEATS && err == CL_SUCCESS; ++r) {
+            err = vector_add_pipelined(queues, pool, kernel, a, b, c, n, pipeline_chunks[k], &seconds);
+            if (r > 0 && (best < 0.0 || seconds < best)) {
+                best = seconds;
+            }
+        }
+        if (err != CL_SUCCESS) {
+            printf("Pipeline error! Code: %d\n", err);
+            break;
+        }
+        int verified = check_add(a, b, c, n);
+        printf("%3d chunks  %.6f s %8.2f GB/s%s\n", pipeline_chunks[k], best, bytes / best / 1e9,
+            verified ? "" : "  MISMATCH");
+        fprintf(file, "pipelined,%d,%zu,%.9f,%.3f,-,-,-,%s\n", pipeline_chunks[k], vector_bytes, best,
+            bytes / best / 1e9, verified ? "yes" : "no");
+        fflush(file);
+    }
+
+    buffer_pool_give_back_host(pool, a);
+    buffer_pool_give_back_host(pool, b);
+    buffer_pool_give_back_host(pool, c);
+    for (q = 1; q < PIPELINE_QUEUES; ++q) {
+        clReleaseCommandQueue(queues[q]);
+    }
+    clReleaseKernel(kernel);
+    clReleaseProgram(program);
+    printf("Results written to %s\n", csv_path);
+    fclose(file);
+    return 0;
+}
+
+static double profiled_seconds(cl_event first, cl_event last)
+{
+    cl_ulong start_ns, end_ns;
+
+    clGetEventProfilingInfo(first, CL_PROFILING_COMMAND_START, sizeof(start_ns), &start_ns, NULL);
+    clGetEventProfilingInfo(last, CL_PROFILING_COMMAND_END, sizeof(end_ns), &end_ns, NULL);
+    return (double)(end_ns - start_ns) / 1000000000.0;
+}
+
+/**
+ * FUSED_EXPRESSION on float vectors as one generated kernel and as one
+ * generated kernel per operation, whose intermediate results go through
+ * global memory. The fused build is timed twice, the second one coming from
+ * the binary cache. The best kernel times are written to a CSV file.
+ */
+static int run_fused(cl_context context, cl_device_id device_id, cl_command_queue command_queue,
+    BufferPool* pool, int n, const char* csv_path)
+{
+    static const double scalars[] = { FUSED_A, FUSED_B };
+    FusedKernel fused, unfused[N_UNFUSED];
+    RandomFill random;
+    cl_mem vectors[7];
+    double build_s[2];
+    cl_int err = CL_SUCCESS;
+    int i, k, r;
+
+    FILE* file = fopen(csv_path, "w");
+    if (file == NULL) {
+        printf("Error opening file!\n");
+        return 1;
+    }
+    fprintf(file, "kernels,n,device_s,gbs,verified\n");
+
+    // Build, then build again from the cache
+    for (i = 0; i < 2 && err == CL_SUCCESS; ++i) {
+        double start = wall_seconds();
+        if (i > 0) {
+            fused_kernel_release(&fused);
+        }
+        err = fused_kernel_init(&fused, context, device_id, STREAM_FLOAT, FUSED_EXPRESSION, FUSED_SCALARS);
+        build_s[i] = wall_seconds() - start;
+    }
+    for (k = 0; k < N_UNFUSED && err == CL_SUCCESS; ++k) {
+        err = fused_kernel_init(&unfused[k], context, device_id, STREAM_FLOAT, unfused_expressions[k],
+            FUSED_SCALARS);
+    }
+    if (err == CL_SUCCESS) {
+        err = random_fill_init(&random, context, device_id, "-D ELEM_T=float");
+    }
+    if (err != CL_SUCCESS) {
+        printf("Fused build error! Code: %d\n", err);
+        fclose(file);
+        return 0;
+    }
+    printf("%s\n%s", FUSED_EXPRESSION, fused.source);
+    printf("Build %.3f s, from the binary cache %.3f s\n", build_s[0], build_s[1]);
+
+    // x, y, z, r and the intermediates t, u, v
+    size_t size = (size_t)n * sizeof(cl_float);
+    for (i = 0; i < 7; ++i) {
+        vectors[i] = buffer_pool_acquire(pool, size, &err);
+    }
+    for (i = 0; i < 3; ++i) {
+        random_fill(&random, command_queue, vectors[i], 0, 1, n, n, SEED_A + i, MIN, MAX, NULL);
+    }
+    cl_float* host_inputs = (cl_float*)malloc(3 * size);
+    cl_float* host_result = (cl_float*)malloc(size);
+    for (i = 0; i < 3; ++i) {
+        clEnqueueReadBuffer(command_queue, vectors[i], CL_TRUE, 0, size, host_inputs + (size_t)i * n, 0, NULL, NULL);
+    }
+
+    printf("%-8s %12s %8s\n", "kernels", "device s", "GB/s");
+    for (k = 0; k < 2 && err == CL_SUCCESS; ++k) {
+        double best = -1.0, seconds;
+        int kernels = k == 0 ? 1 : N_UNFUSED;
+        // Vectors read and written: 3 + 1 fused, 2 + 2 + 3 + 3 unfused
+        double bytes = (k == 0 ? 4.0 : 10.0) * size;
+
+        // The first run is a warm-up
+        for (r = 0; r <= STREAM_REPEATS && err == CL_SUCCESS; ++r) {
+            cl_event events[N_UNFUSED];
+            if (k == 0) {
+                cl_mem inputs[3] = { vectors[0], vectors[1], vectors[2] };
+                err = fused_kernel_run(&fused, command_queue, vectors[3], inputs, scalars, n, &events[0]);
+            } else {
+                cl_mem t_inputs[1] = { vectors[0] }, u_inputs[1] = { vectors[1] };
+                cl_mem v_inputs[2] = { vectors[4], vectors[5] }, r_inputs[2] = { vectors[6], vectors[2] };
+                fused_kernel_run(&unfused[0], command_queue, vectors[4], t_inputs, scalars, n, &events[0]);
+                fused_kernel_run(&unfused[1], command_queue, vectors[5], u_inputs, scalars, n, &events[1]);
+                fused_kernel_run(&unfused[2], command_queue, vectors[6], v_inputs, scalars, n, &events[2]);
+                err = fused_kernel_run(&unfused[3], command_queue, vectors[3], r_inputs, scalars, n, &events[3]);
+            }
+            clFinish(command_queue);
+            if (err == CL_SUCCESS) {
+                seconds = profiled_seconds(events[0], events[kernels - 1]);
+                if (r > 0 && (best < 0.0 || seconds < best)) {
+                    best = seconds;
+                }
+            }
+            for (i = 0; i < kernels; ++i) {
+                clReleaseEvent(events[i]);
+            }
+        }
+        if (err != CL_SUCCESS) {
+            printf("Fused run error! Code: %d\n", err);
+            break;
+        }
+
+        // Integer inputs and scalars make the result exact
+        clEnqueueReadBuffer(command_queue, vectors[3], CL_TRUE, 0, size, host_result, 0, NULL, NULL);
+        int verified = 1;
+        for (i = 0; i < n && verified; ++i) {
+            verified = host_result[i] == (cl_float)(FUSED_A * host_inputs[i] + FUSED_B * host_inputs[n + i]
+                - host_inputs[2 * (size_t)n + i]);
+        }
+        printf("%-8d %12.6f %8.2f%s\n", kernels, best, bytes / best / 1e9, verified ? "" : "  MISMATCH");
+        fprintf(file, "%d,%d,%.9f,%.3f,%s\n", kernels, n, best, bytes / best / 1e9, verified ? "yes" : "no");
+        fflush(file);
+    }
+
+    free(host_inputs);
+    free(host_result);
+    for (i = 0; i < 7; ++i) {
+        buffer_pool_give_back(pool, vectors[i]);
+    }
+    random_fill_release(&random);
+    fused_kernel_release(&fused);
+    for (k = 0; k < N_UNFUSED; ++k) {
+        fused_kernel_release(&unfused[k]);
+    }
+    printf("Results written to %s\n", csv_path);
+    fclose(file);
+    return 0;
+}
+
+/**
+ * STREAM suite: copy, scale, add and triad bandwidth for every type and
+ * vector width, host <-> device transfer bandwidth and launch latency.
+ * The results are printed and written to a CSV file:
+ *
+ * test: STREAM kernel, transfer direction and host memory, or latency measurement
+ * best_s, average_s: Kernel or transfer time (launch latency for the latency lines)
+ * gbs: Bandwidth of the best time
+ * verified: The arrays hold the expected values after the STREAM kernels
+ */
+static int run_stream(cl_context context, cl_device_id device_id, cl_command_queue command_queue,
+    BufferPool* pool, size_t array_bytes, const char* csv_path)
+{
+    StreamResult results[STREAM_KERNELS];
+    TransferResult transfer;
+    LatencyResult latency;
+    char device_name[256];
+    cl_ulong max_alloc_size;
+    cl_int err;
+    int t, w, k;
+
+    FILE* file = fopen(csv_path, "w");
+    if (file == NULL) {
+        printf("Error opening file!\n");
+        return 1;
+    }
+    fprintf(file, "test,type,width,bytes,best_s,average_s,gbs,verified\n");
+
+    // Arrays are powers of two below the largest allocation
+    clGetDeviceInfo(device_id, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(max_alloc_size), &max_alloc_size, NULL);
+    while (array_bytes > max_alloc_size) {
+        array_bytes /= 2;
+    }
+    clGetDeviceInfo(device_id, CL_DEVICE_NAME, sizeof(device_name), device_name, NULL);
+    printf("%s, %zu MiB per array (GB/s of the best of %d runs)\n", device_name, array_bytes >> 20, STREAM_REPEATS);
+    printf("%-7s %5s %10s %10s %10s %10s\n", "type", "width", "copy", "scale", "add", "triad");
+
+    for (t = 0; t < STREAM_TYPES; ++t) {
+        for (w = 0; w < N_STREAM_WIDTHS; ++w) {
+            int verified;
+            err = stream_run(context, device_id, command_queue, pool, (StreamType)t, stream_widths[w],
+                array_bytes, STREAM_REPEATS, results, &verified);
+            if (err == -1) {
+                printf("%-7s not supported by the device\n", stream_type_name((StreamType)t));
+                break;
+            } else if (err != CL_SUCCESS) {
+                printf("%-7s %5d error %d\n", stream_type_name((StreamType)t), stream_widths[w], err);
+                continue;
+            }
+            printf("%-7s %5d", stream_type_name((StreamType)t), stream_widths[w]);
+            for (k = 0; k < STREAM_KERNELS; ++k) {
+                printf(" %10.2f", results[k].gbs);
+                fprintf(file, "%s,%s,%d,%zu,%.9f,%.9f,%.3f,%s\n", stream_kernel_name((StreamKernel)k),
+                    stream_type_name((StreamType)t), stream_widths[w], array_bytes,
+                    results[k].best_s, results[k].average_s, results[k].gbs, verified ? "yes" : "no");
+            }
+            printf("%s\n", verified ? "" : "  MISMATCH");
+            fflush(file);
+        }
+    }
+
+    err = transfer_bandwidth(command_queue, pool, array_bytes, STREAM_REPEATS, &transfer);
+    if (err == CL_SUCCESS) {
+        printf("Host -> device: %.2f GB/s pinned, %.2f GB/s pageable\n", transfer.h2d_pinned, transfer.h2d_pageable);
+        printf("Device -> host: %.2f GB/s pinned, %.2f GB/s pageable\n", transfer.d2h_pinned, transfer.d2h_pageable);
+        fprintf(file, "h2d_pinned,-,-,%zu,%.9f,-,%.3f,-\n", array_bytes, array_bytes / transfer.h2d_pinned / 1e9, transfer.h2d_pinned);
+        fprintf(file, "d2h_pinned,-,-,%zu,%.9f,-,%.3f,-\n", array_bytes, array_bytes / transfer.d2h_pinned / 1e9, transfer.d2h_pinned);
+        fprintf(file, "h2d_pageable,-,-,%zu,%.9f,-,%.3f,-\n", array_bytes, array_bytes / transfer.h2d_pageable / 1e9, transfer.h2d_pageable);
+        fprintf(file, "d2h_pageable,-,-,%zu,%.9f,-,%.3f,-\n", array_bytes, array_bytes / transfer.d2h_pageable / 1e9, transfer.d2h_pageable);
+    } else {
+        printf("Transfer error! Code: %d\n", err);
+    }
+
+    err = launch_latency(context, device_id, command_queue, LATENCY_REPEATS, &latency);
+    if (err == CL_SUCCESS) {
+        printf("Launch latency: %.1f us queued to start, %.1f us round trip\n",
+            latency.queued_to_start_us, latency.round_trip_us);
+        fprintf(file, "launch_queued_to_start,-,-,0,-,%.9f,-,-\n", latency.queued_to_start_us / 1e6);
+        fprintf(file, "launch_round_trip,-,-,0,-,%.9f,-,-\n", latency.round_trip_us / 1e6);
+    } else {
+        printf("Launch error! Code: %d\n", err);
+    }
+
+    printf("Results written to %s\n", csv_path);
+    fclose(file);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+//Initialize
+    cl_int err;
+    int result;
+
+    // Mode selection: stream runs the bandwidth suite, add the vector_add length sweep
+    const char* mode = argc > 1 ? argv[1] : "stream";
+    size_t array_mib = STREAM_ARRAY_MIB;
+    if (strcmp(mode, "stream") == 0) {
+        if (argc > 2 && atol(argv[2]) > 0) {
+            array_mib = (size_t)atol(argv[2]);
+        }
+    } else if (strcmp(mode, "add") != 0 && strcmp(mode, "dispatch") != 0 && strcmp(mode, "reduce") != 0
+        && strcmp(mode, "scan") != 0 && strcmp(mode, "sort") != 0
+        && strcmp(mode, "pipeline") != 0 && strcmp(mode, "fused") != 0) {
+        printf("Usage: %s stream [MiB per array] [output.csv]\n", argv[0]);
+        printf("       %s add\n", argv[0]);
+        printf("       %s dispatch [recalibrate]\n", argv[0]);
+        printf("       %s reduce [length] [output.csv]\n", argv[0]);
+        printf("       %s scan [length] [output.csv]\n", argv[0]);
+        printf("       %s sort [length] [output.csv]\n", argv[0]);
+        printf("       %s pipeline [MiB per vector] [output.csv]\n", argv[0]);
+        printf("       %s fused [length] [output.csv]\n", argv[0]);
+        return 0;
+    }
+
+    // Get platform
+    cl_uint n_platforms;
+	cl_platform_id platform_id;
+    err = clGetPlatformIDs(1, &platform_id, &n_platforms);
+	if (err != CL_SUCCESS) {
+		printf("[ERROR] Error calling clGetPlatformIDs. Error code: %d\n", err);
+		return 0;
+	}
+
+    // Get device
+	cl_device_id device_id;
+	cl_uint n_devices;
+	err = clGetDeviceIDs(
+		platform_id,
+		CL_DEVICE_TYPE_GPU,
+		1,
+		&device_id,
+		&n_devices
+	);
+	if (err != CL_SUCCESS) {
+		printf("[ERROR] Error calling clGetDeviceIDs. Error code: %d\n", err);
+		return 0;
+	}
+
+    // Create OpenCL context
+    cl_context context = clCreateContext(NULL, n_devices, &device_id, NULL, NULL, NULL);
+
+    // Create the command queue, it serves the whole run
+    cl_command_queue command_queue = clCreateCommandQueue(
+        context, device_id, CL_QUEUE_PROFILING_ENABLE, NULL);
+
+    // Buffers are reused from one size to the next instead of being created for each
+    BufferPool pool;
+    buffer_pool_init(&pool, context, command_queue);
+//Initialize
+
+    if (strcmp(mode, "add") == 0) {
+        result = run_vector_add(context, device_id, command_queue, &pool);
+    } else if (strcmp(mode, "reduce") == 0) {
+        result = run_reduce(context, device_id, command_queue, &pool,
+            argc > 2 && atoi(argv[2]) > 0 ? atoi(argv[2]) : REDUCE_LENGTH, argc > 3 ? argv[3] : "reduce.csv");
+    } else if (strcmp(mode, "scan") == 0) {
+        result = run_scan(context, device_id, command_queue, &pool,
+            argc > 2 && atoi(argv[2]) > 0 ? atoi(argv[2]) : SCAN_LENGTH, argc > 3 ? argv[3] : "scan.csv");
+    } else if (strcmp(mode, "sort") == 0) {
+        result = run_sort(context, device_id, command_queue, &pool,
+            argc > 2 && atoi(argv[2]) > 0 ? atoi(argv[2]) : SORT_LENGTH, argc > 3 ? argv[3] : "sort.csv");
+    } else if (strcmp(mode, "pipeline") == 0) {
+        result = run_pipeline(context, device_id, command_queue, &pool,
+            (size_t)(argc > 2 && atol(argv[2]) > 0 ? atol(argv[2]) : PIPELINE_MIB) << 20,
+            argc > 3 ? argv[3] : "pipeline.csv");
+    } else if (strcmp(mode, "fused") == 0) {
+        result = run_fused(context, device_id, command_queue, &pool,
+            argc > 2 && atoi(argv[2]) > 0 ? atoi(argv[2]) : FUSED_LENGTH, argc > 3 ? argv[3] : "fused.csv");
+    } else if (strcmp(mode, "dispatch") == 0) {
+        result = run_dispatch(context, device_id, command_queue, &pool,
+            argc > 2 && strcmp(argv[2], "recalibrate") == 0);
+    } else {
+        result = run_stream(context, device_id, command_queue, &pool, array_mib << 20,
+            argc > 3 ? argv[3] : "stream.csv");
+    }
+
+//Release Resources
+    buffer_pool_release(&pool);
+    clReleaseCommandQueue(command_queue);
+    clReleaseContext(context);
+    clReleaseDevice(device_id);
 //Release Resources
+    return result;
 }
@@ -0,0 +1,255 @@
+#include "dispatch.h"
+#include "kernel_loader.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Lengths timed by the calibration
+#define MIN_CALIBRATION_LENGTH (1 << 10)
+#define MAX_CALIBRATION_LENGTH (1 << 24)
+
+#define REPEATS 3
+
+// 8 ints, one AVX2 register
+typedef int int8_vector __attribute__((vector_size(32)));
+
+static double wall_time(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+void dispatch_config_path(cl_device_id device_id, char* path, size_t size)
+{
+    char name[256] = "";
+    const char* dir = getenv("VECTOR_CONFIG_DIR");
+    int i;
+
+    clGetDeviceInfo(device_id, CL_DEVICE_NAME, sizeof(name) - 1, name, NULL);
+    for (i = 0; name[i] != 0; ++i) {
+        if (!isalnum((unsigned char)name[i])) {
+            name[i] = '_';
+        }
+    }
+    snprintf(path, size, "%s/dispatch_%s.cfg", dir != NULL ? dir : ".", name);
+}
+
+void vector_add_cpu(const int* a, const int* b, int* c, int n)
+{
+    int i = 0;
+
+    // Unaligned loads and stores through memcpy, which compile to single vector moves
+    for (; i + 8 <= n; i += 8) {
+        int8_vector x, y;
+        memcpy(&x, a + i, sizeof(x));
+        memcpy(&y, b + i, sizeof(y));
+        x += y;
+        memcpy(c + i, &x, sizeof(x));
+    }
+    for (; i < n; ++i) {
+        c[i] = a[i] + b[i];
+    }
+}
+
+/**
+ * Upload a and b, add them on the device and read c back.
+ */
+static cl_int add_device(VectorDispatch* dispatch, const int* a, const int* b, int* c, int n)
+{
+    size_t size = (size_t)n * sizeof(int);
+    size_t global_work_size = (size_t)n;
+    cl_mem buffer_a, buffer_b = NULL, buffer_c = NULL;
+    cl_int err;
+
+    buffer_a = buffer_pool_acquire(dispatch->pool, size, &err);
+    if (err == CL_SUCCESS) {
+        buffer_b = buffer_pool_acquire(dispatch->pool, size, &err);
+    }
+    if (err == CL_SUCCESS) {
+        buffer_c = buffer_pool_acquire(dispatch->pool, size, &err);
+    }
+    if (err == CL_SUCCESS) {
+        clEnqueueWriteBuffer(dispatch->command_queue, buffer_a, CL_FALSE, 0, size, a, 0, NULL, NULL);
+        clEnqueueWriteBuffer(dispatch->command_queue, buffer_b, CL_FALSE, 0, size, b, 0, NULL, NULL);
+        clSetKernelArg(dispatch->kernel, 0, sizeof(cl_mem), &buffer_a);
+        clSetKernelArg(dispatch->kernel, 1, sizeof(cl_mem), &buffer_b);
+        clSetKernelArg(dispatch->kernel, 2, sizeof(cl_mem), &buffer_c);
+        clSetKernelArg(dispatch->kernel, 3, sizeof(int), &n);
+        err = clEnqueueNDRangeKernel(dispatch->command_queue, dispatch->kernel, 1, NULL,
+            &global_work_size, NULL, 0, NULL, NULL);
+    }
+    if (err == CL_SUCCESS) {
+        err = clEnqueueReadBuffer(dispatch->command_queue, buffer_c, CL_TRUE, 0, size, c, 0, NULL, NULL);
+    }
+    if (buffer_a != NULL) {
+        buffer_pool_give_back(dispatch->pool, buffer_a);
+    }
+    if (buffer_b != NULL) {
+        buffer_pool_give_back(dispatch->pool, buffer_b);
+    }
+    if (buffer_c != NULL) {
+        buffer_pool_give_back(dispatch->pool, buffer_c);
+    }
+    return err;
+}
+
+/**
+ * Load the crossover from the file of the device.
+ *
+ * Returns 0 on success, -1 if there is none
+ */
+static int load_crossover(cl_device_id device_id, long* crossover)
+{
+    char path[512];
+    char line[256];
+    char tag[32], operation[32];
+    long value;
+    FILE* file;
+    int result = -1;
+
+    dispatch_config_path(device_id, path, sizeof(path));
+    file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "%31s %31s %ld", tag, operation, &value) != 3) continue;
+        if (strcmp(tag, "crossover") == 0 && strcmp(operation, "vector_add") == 0) {
+            *crossover = value;
+            result = 0;
+        }
+    }
+    fclose(file);
+    return result;
+}
+
+static int save_crossover(cl_device_id device_id, long crossover)
+{
+    char path[512];
+    FILE* file;
+
+    dispatch_config_path(device_id, path, sizeof(path));
+    file = fopen(path, "w");
+    if (file == NULL) {
+        return -1;
+    }
+    fprintf(file, "# crossover operation length\n");
+    fprintf(file, "crossover vector_add %ld\n", crossover);
+    fclose(file);
+    return 0;
+}
+
+cl_int vector_dispatch_init(VectorDispatch* dispatch, cl_context context, cl_device_id device_id,
+    cl_command_queue command_queue, BufferPool* pool, int recalibrate)
+{
+    cl_int err;
+
+    memset(dispatch, 0, sizeof(*dispatch));
+    dispatch->crossover = -1;
+    if (context == NULL) {
+        return CL_SUCCESS;
+    }
+    dispatch->context = context;
+    dispatch->device_id = device_id;
+    dispatch->command_queue = command_queue;
+    dispatch->pool = pool;
+    dispatch->program = build_program(context, device_id, "kernels/vector_add.cl", "", &err);
+    if (dispatch->program == NULL) {
+        return err;
+    }
+    dispatch->kernel = clCreateKernel(dispatch->program, "vector_add_kernel", &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    if (!recalibrate && load_crossover(device_id, &dispatch->crossover) == 0) {
+        return CL_SUCCESS;
+    }
+    err = vector_dispatch_calibrate(dispatch);
+    if (err == CL_SUCCESS) {
+        save_crossover(device_id, dispatch->crossover);
+    }
+    return err;
+}
+
+cl_int vector_dispatch_calibrate(VectorDispatch* dispatch)
+{
+    int* a = (int*)malloc(MAX_CALIBRATION_LENGTH * sizeof(int));
+    int* b = (int*)malloc(MAX_CALIBRATION_LENGTH * sizeof(int));
+    int* c = (int*)malloc(MAX_CALIBRATION_LENGTH * sizeof(int));
+    cl_int err = CL_SUCCESS;
+    int n, r, i;
+
+    for (i = 0; i < MAX_CALIBRATION_LENGTH; ++i) {
+        a[i] = i;
+        b[i] = 2 * i;
+    }
+
+    // The smallest length of the run of lengths the device wins up to the longest one
+    dispatch->crossover = -1;
+    for (n = MIN_CALIBRATION_LENGTH; n <= MAX_CALIBRATION_LENGTH && err == CL_SUCCESS; n *= 2) {
+        double cpu_s = -1.0, device_s = -1.0;
+
+        // The first runs are warm-ups
+        for (r = 0; r <= REPEATS && err == CL_SUCCESS; ++r) {
+            double start = wall_time();
+            vector_add_cpu(a, b, c, n);
+            double seconds = wall_time() - start;
+            if (r > 0 && (cpu_s < 0.0 || seconds < cpu_s)) {
+                cpu_s = seconds;
+            }
+            start = wall_time();
+            err = add_device(dispatch, a, b, c, n);
+            seconds = wall_time() - start;
+            if (r > 0 && (device_s < 0.0 || seconds < device_s)) {
+                device_s = seconds;
+            }
+        }
+        if (err != CL_SUCCESS) {
+            break;
+        }
+        printf("Calibration %9d: CPU %.6f s, device %.6f s\n", n, cpu_s, device_s);
+        if (device_s < cpu_s) {
+            if (dispatch->crossover < 0) {
+                dispatch->crossover = n;
+            }
+        } else {
+            dispatch->crossover = -1;
+        }
+    }
+
+    free(a);
+    free(b);
+    free(c);
+    return err;
+}
+
+cl_int vector_dispatch_add(VectorDispatch* dispatch, const int* a, const int* b, int* c, int n, Backend* backend)
+{
+    Backend selected = dispatch->context != NULL && dispatch->crossover >= 0 && n >= dispatch->crossover
+        ? BACKEND_DEVICE : BACKEND_CPU;
+
+    if (backend != NULL) {
+        *backend = selected;
+    }
+    if (selected == BACKEND_DEVICE) {
+        return add_device(dispatch, a, b, c, n);
+    }
+    vector_add_cpu(a, b, c, n);
+    return CL_SUCCESS;
+}
+
+void vector_dispatch_release(VectorDispatch* dispatch)
+{
+    if (dispatch->kernel != NULL) {
+        clReleaseKernel(dispatch->kernel);
+    }
+    if (dispatch->program != NULL) {
+        clReleaseProgram(dispatch->program);
+    }
+    memset(dispatch, 0, sizeof(*dispatch));
+}
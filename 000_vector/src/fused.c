@@ -0,0 +1,413 @@
+#include "fused.h"
+#include "kernel_loader.h"
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Generated body and whole source sizes
+#define MAX_BODY_LENGTH 8192
+#define MAX_SOURCE_LENGTH 16384
+
+/**
+ * Recursive descent parser, writing the OpenCL expression as it reads.
+ * Inputs become v_<name>, scalars s_<name> and assigned names t_<name>.
+ */
+typedef struct {
+    const char* p;
+    FusedKernel* fused;
+    char* body;
+    size_t length;
+    char temporaries[MAX_FUSED_NAMES][MAX_FUSED_NAME_LENGTH];
+    int n_temporaries;
+    int error;
+} Parser;
+
+static void parse_expression(Parser* parser);
+
+/**
+ * Append formatted text to the body.
+ */
+static void emit(Parser* parser, const char* format, ...)
+{
+    va_list args;
+    int written;
+
+    va_start(args, format);
+    written = vsnprintf(parser->body + parser->length, MAX_BODY_LENGTH - parser->length, format, args);
+    va_end(args);
+    if (written < 0 || parser->length + written >= MAX_BODY_LENGTH) {
+        parser->error = 1;
+        return;
+    }
+    parser->length += written;
+}
+
+static void skip_spaces(Parser* parser)
+{
+    while (isspace((unsigned char)*parser->p)) {
+        ++parser->p;
+    }
+}
+
+/**
+ * Report a syntax error at the current position.
+ */
+static void syntax_error(Parser* parser, const char* message)
+{
+    if (!parser->error) {
+        printf("Expression error: %s at \"%s\"\n", message, parser->p);
+    }
+    parser->error = 1;
+}
+
+/**
+ * Read a name into name. Returns 0 if there is none.
+ */
+static int read_name(Parser* parser, char name[MAX_FUSED_NAME_LENGTH])
+{
+    int length = 0;
+
+    skip_spaces(parser);
+    if (!isalpha((unsigned char)*parser->p) && *parser->p != '_') {
+        return 0;
+    }
+    while (isalnum((unsigned char)*parser->p) || *parser->p == '_') {
+        if (length == MAX_FUSED_NAME_LENGTH - 1) {
+            syntax_error(parser, "name too long");
+            return 0;
+        }
+        name[length++] = *parser->p++;
+    }
+    name[length] = 0;
+    return 1;
+}
+
+/**
+ * Find a name in a list. Returns its index, -1 if absent.
+ */
+static int find_name(char names[][MAX_FUSED_NAME_LENGTH], int count, const char* name)
+{
+    int i;
+
+    for (i = 0; i < count; ++i) {
+        if (strcmp(names[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Emit a variable: a temporary, a scalar or an input, added at its first use.
+ */
+static void emit_variable(Parser* parser, const char* name)
+{
+    FusedKernel* fused = parser->fused;
+
+    if (find_name(parser->temporaries, parser->n_temporaries, name) >= 0) {
+        emit(parser, "t_%s", name);
+    } else if (find_name(fused->scalars, fused->n_scalars, name) >= 0) {
+        emit(parser, "s_%s", name);
+    } else {
+        if (find_name(fused->inputs, fused->n_inputs, name) < 0) {
+            if (fused->n_inputs == MAX_FUSED_NAMES) {
+                syntax_error(parser, "too many inputs");
+                return;
+            }
+            strcpy(fused->inputs[fused->n_inputs++], name);
+        }
+        emit(parser, "v_%s", name);
+    }
+}
+
+/**
+ * primary: number | name | name(expression, ...) | (expression)
+ */
+static void parse_primary(Parser* parser)
+{
+    char name[MAX_FUSED_NAME_LENGTH];
+
+    skip_spaces(parser);
+    if (isdigit((unsigned char)*parser->p) || *parser->p == '.') {
+        char* end;
+        const char* start = parser->p;
+        strtod(start, &end);
+        parser->p = end;
+        emit(parser, "((%s)%.*s)", stream_type_name(parser->fused->type), (int)(end - start), start);
+    } else if (read_name(parser, name)) {
+        skip_spaces(parser);
+        if (*parser->p != '(') {
+            emit_variable(parser, name);
+            return;
+        }
+        // Built-in call, the arguments are expressions
+        ++parser->p;
+        emit(parser, "%s(", name);
+        for (;;) {
+            parse_expression(parser);
+            skip_spaces(parser);
+            if (*parser->p != ',' || parser->error) {
+                break;
+            }
+            ++parser->p;
+            emit(parser, ", ");
+        }
+        if (*parser->p != ')') {
+            syntax_error(parser, "expected )");
+            return;
+        }
+        ++parser->p;
+        emit(parser, ")");
+    } else if (*parser->p == '(') {
+        ++parser->p;
+        emit(parser, "(");
+        parse_expression(parser);
+        skip_spaces(parser);
+        if (*parser->p != ')') {
+            syntax_error(parser, "expected )");
+            return;
+        }
+        ++parser->p;
+        emit(parser, ")");
+    } else {
+        syntax_error(parser, "expected a number, a name or (");
+    }
+}
+
+/**
+ * unary: -unary | primary
+ */
+static void parse_unary(Parser* parser)
+{
+    skip_spaces(parser);
+    if (*parser->p == '-') {
+        ++parser->p;
+        // Parenthesized so that nested negations never form the -- operator
+        emit(parser, "-(");
+        parse_unary(parser);
+        emit(parser, ")");
+    } else {
+        parse_primary(parser);
+    }
+}
+
+/**
+ * term: unary (* or / unary)*
+ */
+static void parse_term(Parser* parser)
+{
+    parse_unary(parser);
+    for (skip_spaces(parser); !parser->error && (*parser->p == '*' || *parser->p == '/'); skip_spaces(parser)) {
+        emit(parser, " %c ", *parser->p++);
+        parse_unary(parser);
+    }
+}
+
+/**
+ * expression: term (+ or - term)*
+ */
+static void parse_expression(Parser* parser)
+{
+    parse_term(parser);
+    for (skip_spaces(parser); !parser->error && (*parser->p == '+' || *parser->p == '-'); skip_spaces(parser)) {
+        emit(parser, " %c ", *parser->p++);
+        parse_term(parser);
+    }
+}
+
+/**
+ * statements: name = expression (; name = expression)*
+ */
+static void parse_statements(Parser* parser)
+{
+    const char* type = stream_type_name(parser->fused->type);
+    char target[MAX_FUSED_NAME_LENGTH];
+
+    for (;;) {
+        skip_spaces(parser);
+        if (*parser->p == 0) {
+            break;
+        }
+        if (!read_name(parser, target)) {
+            syntax_error(parser, "expected the name of the result");
+            return;
+        }
+        skip_spaces(parser);
+        if (*parser->p != '=') {
+            syntax_error(parser, "expected =");
+            return;
+        }
+        ++parser->p;
+
+        // The target is declared after its expression, which may still read an input of the same name
+        int declared = find_name(parser->temporaries, parser->n_temporaries, target) >= 0;
+        if (declared) {
+            emit(parser, "        t_%s = ", target);
+        } else if (parser->n_temporaries < MAX_FUSED_NAMES) {
+            emit(parser, "        %s t_%s = ", type, target);
+        } else {
+            syntax_error(parser, "too many results");
+            return;
+        }
+        parse_expression(parser);
+        if (parser->error) {
+            return;
+        }
+        emit(parser, ";\n");
+        if (!declared) {
+            strcpy(parser->temporaries[parser->n_temporaries++], target);
+        }
+        strcpy(parser->fused->output, target);
+
+        skip_spaces(parser);
+        if (*parser->p == ';') {
+            ++parser->p;
+        } else if (*parser->p != 0) {
+            syntax_error(parser, "expected ;");
+            return;
+        }
+    }
+    if (parser->fused->output[0] == 0) {
+        syntax_error(parser, "no statement");
+    }
+}
+
+/**
+ * Read the comma separated scalar names.
+ */
+static void parse_scalars(Parser* parser, const char* scalars)
+{
+    char name[MAX_FUSED_NAME_LENGTH];
+
+    parser->p = scalars;
+    while (!parser->error && read_name(parser, name)) {
+        if (parser->fused->n_scalars == MAX_FUSED_NAMES) {
+            syntax_error(parser, "too many scalars");
+            return;
+        }
+        strcpy(parser->fused->scalars[parser->fused->n_scalars++], name);
+        skip_spaces(parser);
+        if (*parser->p == ',') {
+            ++parser->p;
+        }
+    }
+    skip_spaces(parser);
+    if (*parser->p != 0) {
+        syntax_error(parser, "expected a scalar name");
+    }
+}
+
+/**
+ * Append formatted text to the source.
+ */
+static void append(char* source, size_t* length, const char* format, ...)
+{
+    va_list args;
+    int written;
+
+    va_start(args, format);
+    written = vsnprintf(source + *length, MAX_SOURCE_LENGTH - *length, format, args);
+    va_end(args);
+    if (written > 0) {
+        *length += written;
+        if (*length >= MAX_SOURCE_LENGTH) {
+            *length = MAX_SOURCE_LENGTH - 1;
+        }
+    }
+}
+
+cl_int fused_kernel_init(FusedKernel* fused, cl_context context, cl_device_id device_id, StreamType type,
+    const char* expression, const char* scalars)
+{
+    const char* type_name = stream_type_name(type);
+    Parser parser;
+    size_t length = 0;
+    cl_int err;
+    int i;
+
+    memset(fused, 0, sizeof(*fused));
+    memset(&parser, 0, sizeof(parser));
+    fused->type = type;
+    parser.fused = fused;
+    parser.body = (char*)malloc(MAX_BODY_LENGTH);
+    parser.body[0] = 0;
+    if (scalars != NULL) {
+        parse_scalars(&parser, scalars);
+    }
+    if (!parser.error) {
+        parser.p = expression;
+        parse_statements(&parser);
+    }
+    if (parser.error) {
+        free(parser.body);
+        return -1;
+    }
+
+    // Signature, one load per input, the statements and the store
+    fused->source = (char*)malloc(MAX_SOURCE_LENGTH);
+    if (type == STREAM_DOUBLE) {
+        append(fused->source, &length, "#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n\n");
+    }
+    append(fused->source, &length, "__kernel void fused_kernel(__global %s* out", type_name);
+    for (i = 0; i < fused->n_inputs; ++i) {
+        append(fused->source, &length, ", __global const %s* in_%s", type_name, fused->inputs[i]);
+    }
+    for (i = 0; i < fused->n_scalars; ++i) {
+        append(fused->source, &length, ", const %s s_%s", type_name, fused->scalars[i]);
+    }
+    append(fused->source, &length, ", const int n)\n{\n    int i = get_global_id(0);\n    if (i < n) {\n");
+    for (i = 0; i < fused->n_inputs; ++i) {
+        append(fused->source, &length, "        const %s v_%s = in_%s[i];\n", type_name, fused->inputs[i],
+            fused->inputs[i]);
+    }
+    append(fused->source, &length, "%s        out[i] = t_%s;\n    }\n}\n", parser.body, fused->output);
+    free(parser.body);
+
+    fused->program = build_program_source(context, device_id, fused->source, "", &err);
+    if (fused->program == NULL) {
+        return err;
+    }
+    fused->kernel = clCreateKernel(fused->program, "fused_kernel", &err);
+    return err;
+}
+
+cl_int fused_kernel_run(FusedKernel* fused, cl_command_queue command_queue, cl_mem output, const cl_mem* inputs,
+    const double* scalars, int n, cl_event* event)
+{
+    size_t global_work_size = (size_t)n;
+    cl_uint arg = 0;
+    int i;
+
+    clSetKernelArg(fused->kernel, arg++, sizeof(cl_mem), &output);
+    for (i = 0; i < fused->n_inputs; ++i) {
+        clSetKernelArg(fused->kernel, arg++, sizeof(cl_mem), &inputs[i]);
+    }
+    for (i = 0; i < fused->n_scalars; ++i) {
+        cl_int int_value = (cl_int)scalars[i];
+        cl_float float_value = (cl_float)scalars[i];
+        if (fused->type == STREAM_INT) {
+            clSetKernelArg(fused->kernel, arg++, sizeof(int_value), &int_value);
+        } else if (fused->type == STREAM_FLOAT) {
+            clSetKernelArg(fused->kernel, arg++, sizeof(float_value), &float_value);
+        } else {
+            clSetKernelArg(fused->kernel, arg++, sizeof(cl_double), &scalars[i]);
+        }
+    }
+    clSetKernelArg(fused->kernel, arg, sizeof(int), &n);
+    return clEnqueueNDRangeKernel(command_queue, fused->kernel, 1, NULL, &global_work_size, NULL, 0, NULL, event);
+}
+
+void fused_kernel_release(FusedKernel* fused)
+{
+    if (fused->kernel != NULL) {
+        clReleaseKernel(fused->kernel);
+    }
+    if (fused->program != NULL) {
+        clReleaseProgram(fused->program);
+    }
+    free(fused->source);
+    memset(fused, 0, sizeof(*fused));
+}
@@ -3,13 +3,32 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-char* load_kernel_source(const char* const path, int* error_code)
+char* load_kernel_source(const char* path, int* error_code)
 {
+    const char* dir = getenv("KERNEL_SOURCE_DIR");
+    char full_path[512];
     FILE* source_file;
     char* source_code;
     int file_size;
+    int i;
 
+    if (dir == NULL) {
+        for (i = 0; embedded_kernels[i].path != NULL; ++i) {
+            if (strcmp(embedded_kernels[i].path, path) == 0) {
+                source_code = (char*)malloc(strlen(embedded_kernels[i].source) + 1);
+                strcpy(source_code, embedded_kernels[i].source);
+                *error_code = 0;
+                return source_code;
+            }
+        }
+    }
+
+    if (dir != NULL && path[0] != '/') {
+        snprintf(full_path, sizeof(full_path), "%s/%s", dir, path);
+        path = full_path;
+    }
     source_file = fopen(path, "rb");
     if (source_file == NULL) {
         *error_code = -1;
@@ -22,7 +41,165 @@ char* load_kernel_source(const char* const path, int* error_code)
     source_code = (char*)malloc(file_size + 1);
     fread(source_code, sizeof(char), file_size, source_file);
     source_code[file_size] = 0;
+    fclose(source_file);
 
     *error_code = 0;
     return source_code;
 }
+
+/**
+ * FNV-1a hash of a string, continuing from hash.
+ */
+static unsigned long long hash_string(unsigned long long hash, const char* string)
+{
+    for (; *string != 0; ++string) {
+        hash ^= (unsigned char)*string;
+        hash *= 1099511628211ULL;
+    }
+    // Separator, so that "ab" + "c" and "a" + "bc" differ
+    hash ^= 0xFF;
+    return hash * 1099511628211ULL;
+}
+
+/**
+ * Path of the cached binary of a program.
+ */
+static void binary_cache_path(cl_device_id device_id, const char* source, const char* options,
+    char* path, size_t size)
+{
+    char device_name[256] = "";
+    char driver_version[256] = "";
+    const char* dir = getenv("KERNEL_CACHE_DIR");
+    unsigned long long hash = 14695981039346656037ULL;
+
+    clGetDeviceInfo(device_id, CL_DEVICE_NAME, sizeof(device_name) - 1, device_name, NULL);
+    clGetDeviceInfo(device_id, CL_DRIVER_VERSION, sizeof(driver_version) - 1, driver_version, NULL);
+    hash = hash_string(hash, device_name);
+    hash = hash_string(hash, driver_version);
+    hash = hash_string(hash, options != NULL ? options : "");
+    hash = hash_string(hash, source);
+    snprintf(path, size, "%s/kernel_%016llx.bin", dir != NULL ? dir : ".", hash);
+}
+
+/**
+ * Create and build a program from a cached binary.
+ *
+ * Returns the program, NULL if there is no usable binary
+ */
+static cl_program load_binary(cl_context context, cl_device_id device_id, const char* path, const char* options)
+{
+    FILE* file = fopen(path, "rb");
+    unsigned char* binary;
+    size_t size;
+    cl_program program;
+    cl_int status, err;
+
+    if (file == NULL) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    size = (size_t)ftell(file);
+    rewind(file);
+    binary = (unsigned char*)malloc(size);
+    if (fread(binary, 1, size, file) != size) {
+        size = 0;
+    }
+    fclose(file);
+    if (size == 0) {
+        free(binary);
+        return NULL;
+    }
+
+    program = clCreateProgramWithBinary(context, 1, &device_id, &size, (const unsigned char**)&binary,
+        &status, &err);
+    free(binary);
+    if (err != CL_SUCCESS || status != CL_SUCCESS) {
+        if (program != NULL) {
+            clReleaseProgram(program);
+        }
+        return NULL;
+    }
+    if (clBuildProgram(program, 1, &device_id, options, NULL, NULL) != CL_SUCCESS) {
+        clReleaseProgram(program);
+        return NULL;
+    }
+    return program;
+}
+
+/**
+ * Write the binary of a built program, a failure only costs the next build.
+ */
+static void save_binary(cl_program program, const char* path)
+{
+    size_t size = 0;
+    unsigned char* binary;
+    FILE* file;
+
+    clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size), &size, NULL);
+    if (size == 0) {
+        return;
+    }
+    binary = (unsigned char*)malloc(size);
+    clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(binary), &binary, NULL);
+    file = fopen(path, "wb");
+    if (file != NULL) {
+        fwrite(binary, 1, size, file);
+        fclose(file);
+    }
+    free(binary);
+}
+
+cl_program build_program_source(cl_context context, cl_device_id device_id, const char* source,
+    const char* options, cl_int* error_code)
+{
+    char path[512];
+    cl_int err;
+    cl_program program;
+
+    binary_cache_path(device_id, source, options, path, sizeof(path));
+    program = load_binary(context, device_id, path, options);
+    if (program != NULL) {
+        *error_code = CL_SUCCESS;
+        return program;
+    }
+
+    program = clCreateProgramWithSource(context, 1, &source, NULL, &err);
+    if (err != CL_SUCCESS) {
+        *error_code = err;
+        return NULL;
+    }
+    err = clBuildProgram(program, 1, &device_id, options, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Build error! Code: %d\n", err);
+        size_t real_size;
+        clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, 0, NULL, &real_size);
+        char* build_log = (char*)malloc(sizeof(char) * (real_size + 1));
+        clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, real_size + 1, build_log, &real_size);
+        build_log[real_size] = 0;
+        printf("Build log: %s\n", build_log);
+        free(build_log);
+        clReleaseProgram(program);
+        *error_code = err;
+        return NULL;
+    }
+    save_binary(program, path);
+    *error_code = CL_SUCCESS;
+    return program;
+}
+
+cl_program build_program(cl_context context, cl_device_id device_id, const char* path,
+    const char* options, cl_int* error_code)
+{
+    int load_error;
+    cl_program program;
+
+    char* kernel_code = load_kernel_source(path, &load_error);
+    if (load_error != 0) {
+        printf("Source code loading error: %s\n", path);
+        *error_code = -1;
+        return NULL;
+    }
+    program = build_program_source(context, device_id, kernel_code, options, error_code);
+    free(kernel_code);
+    return program;
+}
@@ -0,0 +1,123 @@
+#include "philox.h"
+#include "kernel_loader.h"
+
+#include <string.h>
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+void philox4x32(const cl_uint counter[4], const cl_uint key[2], cl_uint result[4])
+{
+    cl_uint c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    cl_uint k0 = key[0], k1 = key[1];
+    int r;
+
+    for (r = 0; r < PHILOX_ROUNDS; ++r) {
+        cl_ulong p0 = (cl_ulong)PHILOX_M0 * c0;
+        cl_ulong p1 = (cl_ulong)PHILOX_M1 * c2;
+
+        c0 = (cl_uint)(p1 >> 32) ^ c1 ^ k0;
+        c1 = (cl_uint)p1;
+        c2 = (cl_uint)(p0 >> 32) ^ c3 ^ k1;
+        c3 = (cl_uint)p0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    result[0] = c0;
+    result[1] = c1;
+    result[2] = c2;
+    result[3] = c3;
+}
+
+cl_uint philox_uint(cl_ulong seed, cl_ulong index)
+{
+    // Block index / 4 holds words index .. index + 3
+    cl_uint counter[4] = { (cl_uint)(index / 4), (cl_uint)(index / 4 >> 32), 0, 0 };
+    cl_uint key[2] = { (cl_uint)seed, (cl_uint)(seed >> 32) };
+    cl_uint result[4];
+
+    philox4x32(counter, key, result);
+    return result[index % 4];
+}
+
+/**
+ * Map a random word into [min, max] in unsigned arithmetic, a range of 0 being all 2^32 values.
+ */
+static int philox_range(cl_uint word, int min, cl_uint range)
+{
+    return (int)((cl_uint)min + (range != 0 ? word % range : word));
+}
+
+int philox_int(cl_ulong seed, cl_ulong index, int min, int max)
+{
+    return philox_range(philox_uint(seed, index), min, (cl_uint)max - (cl_uint)min + 1u);
+}
+
+void philox_fill_int(int* buffer, size_t n, cl_ulong seed, int min, int max)
+{
+    cl_uint key[2] = { (cl_uint)seed, (cl_uint)(seed >> 32) };
+    cl_uint range = (cl_uint)max - (cl_uint)min + 1u;
+    size_t i, j;
+
+    for (i = 0; i < n; i += 4) {
+        cl_uint counter[4] = { (cl_uint)(i / 4), (cl_uint)((cl_ulong)(i / 4) >> 32), 0, 0 };
+        cl_uint result[4];
+
+        philox4x32(counter, key, result);
+        for (j = 0; j < 4 && i + j < n; ++j) {
+            buffer[i + j] = philox_range(result[j], min, range);
+        }
+    }
+}
+
+cl_int random_fill_init(RandomFill* random, cl_context context, cl_device_id device_id, const char* options)
+{
+    cl_int err;
+
+    memset(random, 0, sizeof(*random));
+    random->program = build_program(context, device_id, "kernels/random.cl", options, &err);
+    if (random->program == NULL) {
+        return err;
+    }
+    random->kernel = clCreateKernel(random->program, "random_fill_kernel", &err);
+    return err;
+}
+
+void random_fill_release(RandomFill* random)
+{
+    if (random->kernel != NULL) {
+        clReleaseKernel(random->kernel);
+    }
+    if (random->program != NULL) {
+        clReleaseProgram(random->program);
+    }
+    memset(random, 0, sizeof(*random));
+}
+
+cl_int random_fill(RandomFill* random, cl_command_queue command_queue, cl_mem buffer, int offset,
+    int lines, int line_length, int ld, cl_ulong seed, int min, int max, cl_event* event)
+{
+    cl_ulong count = (cl_ulong)lines * line_length;
+    cl_uint key[2] = { (cl_uint)seed, (cl_uint)(seed >> 32) };
+    size_t global_work_size = (size_t)((count + 3) / 4);
+    cl_uint arg = 0;
+
+    // Each work-item writes the 4 words of one Philox block
+    clSetKernelArg(random->kernel, arg++, sizeof(cl_mem), &buffer);
+    clSetKernelArg(random->kernel, arg++, sizeof(int), &offset);
+    clSetKernelArg(random->kernel, arg++, sizeof(int), &lines);
+    clSetKernelArg(random->kernel, arg++, sizeof(int), &line_length);
+    clSetKernelArg(random->kernel, arg++, sizeof(int), &ld);
+    clSetKernelArg(random->kernel, arg++, sizeof(cl_uint), &key[0]);
+    clSetKernelArg(random->kernel, arg++, sizeof(cl_uint), &key[1]);
+    clSetKernelArg(random->kernel, arg++, sizeof(int), &min);
+    clSetKernelArg(random->kernel, arg++, sizeof(int), &max);
+    if (global_work_size == 0) {
+        return CL_SUCCESS;
+    }
+    return clEnqueueNDRangeKernel(command_queue, random->kernel, 1, NULL, &global_work_size, NULL,
+        0, NULL, event);
+}
@@ -0,0 +1,183 @@
+#include "pipeline.h"
+
+#include <string.h>
+#include <time.h>
+
+static double event_time(cl_event event, cl_profiling_info info)
+{
+    cl_ulong ns;
+
+    clGetEventProfilingInfo(event, info, sizeof(ns), &ns, NULL);
+    return (double)ns / 1000000000.0;
+}
+
+static double wall_time(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+/**
+ * Set the arguments of vector_add_kernel and enqueue it over n elements.
+ */
+static cl_int enqueue_add(cl_command_queue command_queue, cl_kernel kernel, cl_mem a, cl_mem b, cl_mem c, int n,
+    cl_uint n_wait, const cl_event* wait_list, cl_event* event)
+{
+    size_t global_work_size = (size_t)n;
+
+    clSetKernelArg(kernel, 0, sizeof(cl_mem), &a);
+    clSetKernelArg(kernel, 1, sizeof(cl_mem), &b);
+    clSetKernelArg(kernel, 2, sizeof(cl_mem), &c);
+    clSetKernelArg(kernel, 3, sizeof(int), &n);
+    return clEnqueueNDRangeKernel(command_queue, kernel, 1, NULL, &global_work_size, NULL, n_wait, wait_list, event);
+}
+
+cl_int vector_add_serial(cl_command_queue command_queue, BufferPool* pool, cl_kernel kernel,
+    const int* a, const int* b, int* c, int n, SerialResult* result)
+{
+    size_t size = (size_t)n * sizeof(int);
+    cl_event events[4] = { NULL, NULL, NULL, NULL };
+    cl_mem buffers[3] = { NULL, NULL, NULL };
+    cl_int err = CL_SUCCESS;
+    int i;
+
+    for (i = 0; i < 3 && err == CL_SUCCESS; ++i) {
+        buffers[i] = buffer_pool_acquire(pool, size, &err);
+    }
+    if (err == CL_SUCCESS) {
+        double start = wall_time();
+        clEnqueueWriteBuffer(command_queue, buffers[0], CL_FALSE, 0, size, a, 0, NULL, &events[0]);
+        clEnqueueWriteBuffer(command_queue, buffers[1], CL_FALSE, 0, size, b, 0, NULL, &events[1]);
+        err = enqueue_add(command_queue, kernel, buffers[0], buffers[1], buffers[2], n, 0, NULL, &events[2]);
+        if (err == CL_SUCCESS) {
+            err = clEnqueueReadBuffer(command_queue, buffers[2], CL_TRUE, 0, size, c, 0, NULL, &events[3]);
+        }
+        result->wall_s = wall_time() - start;
+    }
+    if (err == CL_SUCCESS) {
+        result->upload_s = event_time(events[1], CL_PROFILING_COMMAND_END)
+            - event_time(events[0], CL_PROFILING_COMMAND_START);
+        result->kernel_s = event_time(events[2], CL_PROFILING_COMMAND_END)
+            - event_time(events[2], CL_PROFILING_COMMAND_START);
+        result->download_s = event_time(events[3], CL_PROFILING_COMMAND_END)
+            - event_time(events[3], CL_PROFILING_COMMAND_START);
+    }
+    for (i = 0; i < 4; ++i) {
+        if (events[i] != NULL) {
+            clReleaseEvent(events[i]);
+        }
+    }
+    for (i = 0; i < 3; ++i) {
+        if (buffers[i] != NULL) {
+            buffer_pool_give_back(pool, buffers[i]);
+        }
+    }
+    return err;
+}
+
+cl_int vector_add_pipelined(cl_command_queue queues[PIPELINE_QUEUES], BufferPool* pool, cl_kernel kernel,
+    const int* a, const int* b, int* c, int n, int chunks, double* seconds)
+{
+    int chunk = (n + chunks - 1) / chunks;
+    size_t chunk_size = (size_t)chunk * sizeof(int);
+    cl_mem slot_a[PIPELINE_SLOTS], slot_b[PIPELINE_SLOTS], slot_c[PIPELINE_SLOTS];
+    cl_event uploaded[PIPELINE_SLOTS], computed[PIPELINE_SLOTS], downloaded[PIPELINE_SLOTS];
+    cl_int err = CL_SUCCESS;
+    double start;
+    int i, s, q;
+
+    memset(slot_a, 0, sizeof(slot_a));
+    memset(slot_b, 0, sizeof(slot_b));
+    memset(slot_c, 0, sizeof(slot_c));
+    memset(uploaded, 0, sizeof(uploaded));
+    memset(computed, 0, sizeof(computed));
+    memset(downloaded, 0, sizeof(downloaded));
+    for (s = 0; s < PIPELINE_SLOTS && err == CL_SUCCESS; ++s) {
+        slot_a[s] = buffer_pool_acquire(pool, chunk_size, &err);
+        if (err == CL_SUCCESS) {
+            slot_b[s] = buffer_pool_acquire(pool, chunk_size, &err);
+        }
+        if (err == CL_SUCCESS) {
+            slot_c[s] = buffer_pool_acquire(pool, chunk_size, &err);
+        }
+    }
+
+    start = wall_time();
+    for (i = 0; i < chunks && err == CL_SUCCESS; ++i) {
+        int offset = i * chunk;
+        int count = n - offset < chunk ? n - offset : chunk;
+        size_t size = (size_t)count * sizeof(int);
+        cl_event wait_list[2];
+        cl_uint n_wait = 0;
+        cl_event event;
+
+        if (count <= 0) {
+            break;
+        }
+        s = i % PIPELINE_SLOTS;
+
+        // Upload once the kernel of the last chunk in this slot has read its inputs
+        if (computed[s] != NULL) {
+            wait_list[n_wait++] = computed[s];
+        }
+        clEnqueueWriteBuffer(queues[0], slot_a[s], CL_FALSE, 0, size, a + offset, n_wait, wait_list, NULL);
+        err = clEnqueueWriteBuffer(queues[0], slot_b[s], CL_FALSE, 0, size, b + offset, 0, NULL, &event);
+        if (err != CL_SUCCESS) {
+            break;
+        }
+        if (uploaded[s] != NULL) {
+            clReleaseEvent(uploaded[s]);
+        }
+        uploaded[s] = event;
+
+        // Compute once uploaded and once the last result of this slot has been read back
+        n_wait = 0;
+        wait_list[n_wait++] = uploaded[s];
+        if (downloaded[s] != NULL) {
+            wait_list[n_wait++] = downloaded[s];
+        }
+        err = enqueue_add(queues[1], kernel, slot_a[s], slot_b[s], slot_c[s], count, n_wait, wait_list, &event);
+        if (err != CL_SUCCESS) {
+            break;
+        }
+        if (computed[s] != NULL) {
+            clReleaseEvent(computed[s]);
+        }
+        computed[s] = event;
+
+        err = clEnqueueReadBuffer(queues[2], slot_c[s], CL_FALSE, 0, size, c + offset, 1, &computed[s], &event);
+        if (err != CL_SUCCESS) {
+            break;
+        }
+        if (downloaded[s] != NULL) {
+            clReleaseEvent(downloaded[s]);
+        }
+        downloaded[s] = event;
+
+        // Start the transfers now rather than when the queue fills
+        for (q = 0; q < PIPELINE_QUEUES; ++q) {
+            clFlush(queues[q]);
+        }
+    }
+    for (q = 0; q < PIPELINE_QUEUES; ++q) {
+        clFinish(queues[q]);
+    }
+    *seconds = wall_time() - start;
+
+    for (s = 0; s < PIPELINE_SLOTS; ++s) {
+        cl_event* events[3] = { &uploaded[s], &computed[s], &downloaded[s] };
+        cl_mem buffers[3] = { slot_a[s], slot_b[s], slot_c[s] };
+        int j;
+        for (j = 0; j < 3; ++j) {
+            if (*events[j] != NULL) {
+                clReleaseEvent(*events[j]);
+            }
+            if (buffers[j] != NULL) {
+                buffer_pool_give_back(pool, buffers[j]);
+            }
+        }
+    }
+    return err;
+}
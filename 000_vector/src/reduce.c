@@ -0,0 +1,261 @@
+#include "reduce.h"
+#include "kernel_loader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// First-stage work-groups per compute unit, enough to hide the memory latency
+#define GROUPS_PER_UNIT 8
+
+#define MAX_LOCAL_SIZE 256
+
+const char* reduce_op_name(ReduceOp op)
+{
+    static const char* names[REDUCE_OPS] = { "sum", "min", "max", "argmin" };
+
+    return names[op];
+}
+
+/**
+ * Check whether the device supports an extension.
+ */
+static int device_has_extension(cl_device_id device_id, const char* extension)
+{
+    size_t size;
+    char* extensions;
+    int found;
+
+    clGetDeviceInfo(device_id, CL_DEVICE_EXTENSIONS, 0, NULL, &size);
+    extensions = (char*)malloc(size + 1);
+    clGetDeviceInfo(device_id, CL_DEVICE_EXTENSIONS, size, extensions, NULL);
+    extensions[size] = 0;
+    found = strstr(extensions, extension) != NULL;
+    free(extensions);
+    return found;
+}
+
+/**
+ * Size of the accumulator: int sums accumulate in long.
+ */
+static size_t accumulator_size(StreamType type, ReduceOp op)
+{
+    return type == STREAM_INT && op == REDUCE_SUM ? sizeof(cl_long) : stream_type_size(type);
+}
+
+/**
+ * Build options of the kernels for the type and operation.
+ */
+static void build_options(StreamType type, ReduceOp op, int subgroups, char* options, size_t size)
+{
+    static const char* max_values[] = { "INT_MAX", "FLT_MAX", "DBL_MAX" };
+    static const char* accumulators[] = { "int", "float", "double" };
+    const char* identity = "0";
+
+    if (op == REDUCE_MIN || op == REDUCE_ARGMIN) {
+        identity = max_values[type];
+    } else if (op == REDUCE_MAX) {
+        identity = type == STREAM_INT ? "INT_MIN" : type == STREAM_FLOAT ? "(-FLT_MAX)" : "(-DBL_MAX)";
+    }
+    snprintf(options, size, "-D T=%s -D ACC_T=%s -D OP=%d -D IDENTITY=%s%s%s",
+        stream_type_name(type),
+        type == STREAM_INT && op == REDUCE_SUM ? "long" : accumulators[type],
+        (int)op, identity,
+        type == STREAM_DOUBLE ? " -D USE_FP64" : "",
+        subgroups ? " -D USE_SUBGROUPS" : "");
+}
+
+cl_int reducer_init(Reducer* reducer, cl_context context, cl_device_id device_id, BufferPool* pool,
+    StreamType type, ReduceOp op)
+{
+    char options[256];
+    cl_uint compute_units;
+    size_t max_work_group_size, partials_work_group_size;
+    size_t acc_size = accumulator_size(type, op);
+    cl_int err;
+
+    memset(reducer, 0, sizeof(*reducer));
+    reducer->pool = pool;
+    reducer->type = type;
+    reducer->op = op;
+    if (type == STREAM_DOUBLE && !device_has_extension(device_id, "cl_khr_fp64")) {
+        return -1;
+    }
+
+    // Sub-groups do not carry the index of argmin
+    reducer->subgroups = op != REDUCE_ARGMIN && device_has_extension(device_id, "cl_khr_subgroups");
+    build_options(type, op, reducer->subgroups, options, sizeof(options));
+    reducer->program = build_program(context, device_id, "kernels/reduce.cl", options, &err);
+    if (reducer->program == NULL) {
+        return err;
+    }
+    reducer->reduce_kernel = clCreateKernel(reducer->program, "reduce_kernel", &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    reducer->partials_kernel = clCreateKernel(reducer->program, "reduce_partials_kernel", &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    // Largest power of two both kernels can launch with, the partials kernel uses the same local size
+    clGetKernelWorkGroupInfo(reducer->reduce_kernel, device_id, CL_KERNEL_WORK_GROUP_SIZE,
+        sizeof(max_work_group_size), &max_work_group_size, NULL);
+    clGetKernelWorkGroupInfo(reducer->partials_kernel, device_id, CL_KERNEL_WORK_GROUP_SIZE,
+        sizeof(partials_work_group_size), &partials_work_group_size, NULL);
+    if (partials_work_group_size < max_work_group_size) {
+        max_work_group_size = partials_work_group_size;
+    }
+    reducer->local_size = 1;
+    while (reducer->local_size * 2 <= max_work_group_size && reducer->local_size * 2 <= MAX_LOCAL_SIZE) {
+        reducer->local_size *= 2;
+    }
+    clGetDeviceInfo(device_id, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(compute_units), &compute_units, NULL);
+    reducer->groups = (size_t)compute_units * GROUPS_PER_UNIT;
+
+    reducer->partial_values = buffer_pool_acquire(pool, reducer->groups * acc_size, &err);
+    if (err == CL_SUCCESS) {
+        reducer->partial_indices = buffer_pool_acquire(pool, reducer->groups * sizeof(cl_int), &err);
+    }
+    if (err == CL_SUCCESS) {
+        reducer->result_value = buffer_pool_acquire(pool, acc_size, &err);
+    }
+    if (err == CL_SUCCESS) {
+        reducer->result_index = buffer_pool_acquire(pool, sizeof(cl_int), &err);
+    }
+    return err;
+}
+
+cl_int reducer_run(Reducer* reducer, cl_command_queue command_queue, cl_mem input, int n,
+    ReduceResult* result, double* seconds)
+{
+    size_t acc_size = accumulator_size(reducer->type, reducer->op);
+    size_t local_size = reducer->local_size;
+    size_t global_size = reducer->groups * local_size;
+    int groups = (int)reducer->groups;
+    cl_event events[2];
+    cl_ulong start_ns, end_ns;
+    unsigned char value[sizeof(cl_double)];
+    cl_int index;
+    cl_int err;
+
+    // Fewer groups for short inputs, each work-item still gets an element
+    while (groups > 1 && global_size / 2 >= (size_t)n) {
+        groups /= 2;
+        global_size /= 2;
+    }
+
+    clSetKernelArg(reducer->reduce_kernel, 0, sizeof(cl_mem), &input);
+    clSetKernelArg(reducer->reduce_kernel, 1, sizeof(int), &n);
+    clSetKernelArg(reducer->reduce_kernel, 2, sizeof(cl_mem), &reducer->partial_values);
+    clSetKernelArg(reducer->reduce_kernel, 3, sizeof(cl_mem), &reducer->partial_indices);
+    clSetKernelArg(reducer->reduce_kernel, 4, local_size * acc_size, NULL);
+    clSetKernelArg(reducer->reduce_kernel, 5, local_size * sizeof(cl_int), NULL);
+    err = clEnqueueNDRangeKernel(command_queue, reducer->reduce_kernel, 1, NULL, &global_size, &local_size,
+        0, NULL, &events[0]);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    clSetKernelArg(reducer->partials_kernel, 0, sizeof(cl_mem), &reducer->partial_values);
+    clSetKernelArg(reducer->partials_kernel, 1, sizeof(cl_mem), &reducer->partial_indices);
+    clSetKernelArg(reducer->partials_kernel, 2, sizeof(int), &groups);
+    clSetKernelArg(reducer->partials_kernel, 3, sizeof(cl_mem), &reducer->result_value);
+    clSetKernelArg(reducer->partials_kernel, 4, sizeof(cl_mem), &reducer->result_index);
+    clSetKernelArg(reducer->partials_kernel, 5, local_size * acc_size, NULL);
+    clSetKernelArg(reducer->partials_kernel, 6, local_size * sizeof(cl_int), NULL);
+    err = clEnqueueNDRangeKernel(command_queue, reducer->partials_kernel, 1, NULL, &local_size, &local_size,
+        0, NULL, &events[1]);
+    if (err != CL_SUCCESS) {
+        clReleaseEvent(events[0]);
+        return err;
+    }
+
+    clEnqueueReadBuffer(command_queue, reducer->result_value, CL_FALSE, 0, acc_size, value, 0, NULL, NULL);
+    err = clEnqueueReadBuffer(command_queue, reducer->result_index, CL_TRUE, 0, sizeof(index), &index,
+        0, NULL, NULL);
+    if (err == CL_SUCCESS && seconds != NULL) {
+        clGetEventProfilingInfo(events[0], CL_PROFILING_COMMAND_START, sizeof(start_ns), &start_ns, NULL);
+        clGetEventProfilingInfo(events[1], CL_PROFILING_COMMAND_END, sizeof(end_ns), &end_ns, NULL);
+        *seconds = (double)(end_ns - start_ns) / 1000000000.0;
+    }
+    clReleaseEvent(events[0]);
+    clReleaseEvent(events[1]);
+
+    if (reducer->type == STREAM_INT) {
+        cl_int int_value;
+        if (reducer->op == REDUCE_SUM) {
+            memcpy(&result->as_long, value, sizeof(cl_long));
+        } else {
+            memcpy(&int_value, value, sizeof(int_value));
+            result->as_long = int_value;
+        }
+        result->as_double = (double)result->as_long;
+    } else if (reducer->type == STREAM_FLOAT) {
+        cl_float float_value;
+        memcpy(&float_value, value, sizeof(float_value));
+        result->as_double = float_value;
+        result->as_long = (cl_long)float_value;
+    } else {
+        memcpy(&result->as_double, value, sizeof(cl_double));
+        result->as_long = (cl_long)result->as_double;
+    }
+    result->index = reducer->op == REDUCE_ARGMIN ? index : -1;
+    return err;
+}
+
+void reducer_release(Reducer* reducer)
+{
+    cl_mem* buffers[] = {
+        &reducer->partial_values, &reducer->partial_indices, &reducer->result_value, &reducer->result_index
+    };
+    int i;
+
+    for (i = 0; i < 4; ++i) {
+        if (*buffers[i] != NULL) {
+            buffer_pool_give_back(reducer->pool, *buffers[i]);
+        }
+    }
+    if (reducer->reduce_kernel != NULL) {
+        clReleaseKernel(reducer->reduce_kernel);
+    }
+    if (reducer->partials_kernel != NULL) {
+        clReleaseKernel(reducer->partials_kernel);
+    }
+    if (reducer->program != NULL) {
+        clReleaseProgram(reducer->program);
+    }
+    memset(reducer, 0, sizeof(*reducer));
+}
+
+/**
+ * Host loop of one element type.
+ */
+#define REDUCE_CPU(ELEM, ACC)                                                   \
+    {                                                                           \
+        const ELEM* x = (const ELEM*)input;                                     \
+        ACC acc = n > 0 ? x[0] : 0;                                             \
+        int i, index = 0;                                                       \
+        for (i = 1; i < n; ++i) {                                               \
+            if (op == REDUCE_SUM) {                                             \
+                acc += x[i];                                                    \
+            } else if (op == REDUCE_MAX ? x[i] > acc : x[i] < acc) {            \
+                acc = x[i];                                                     \
+                index = i;                                                      \
+            }                                                                   \
+        }                                                                       \
+        result->as_long = (cl_long)acc;                                         \
+        result->as_double = (double)acc;                                        \
+        result->index = op == REDUCE_ARGMIN ? index : -1;                       \
+    }
+
+void reduce_cpu(StreamType type, ReduceOp op, const void* input, int n, ReduceResult* result)
+{
+    if (type == STREAM_INT) {
+        REDUCE_CPU(cl_int, cl_long)
+    } else if (type == STREAM_FLOAT) {
+        REDUCE_CPU(cl_float, cl_float)
+    } else {
+        REDUCE_CPU(cl_double, cl_double)
+    }
+}
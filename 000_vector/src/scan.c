@@ -0,0 +1,262 @@
+#include "scan.h"
+#include "kernel_loader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Consecutive elements scanned by each work-item
+#define ITEMS 8
+
+#define MAX_LOCAL_SIZE 256
+
+/**
+ * Check whether the device supports an extension.
+ */
+static int device_has_extension(cl_device_id device_id, const char* extension)
+{
+    size_t size;
+    char* extensions;
+    int found;
+
+    clGetDeviceInfo(device_id, CL_DEVICE_EXTENSIONS, 0, NULL, &size);
+    extensions = (char*)malloc(size + 1);
+    clGetDeviceInfo(device_id, CL_DEVICE_EXTENSIONS, size, extensions, NULL);
+    extensions[size] = 0;
+    found = strstr(extensions, extension) != NULL;
+    free(extensions);
+    return found;
+}
+
+cl_int scanner_init(Scanner* scanner, cl_context context, cl_device_id device_id, BufferPool* pool,
+    StreamType type)
+{
+    char options[128];
+    size_t max_work_group_size;
+    cl_int err;
+
+    memset(scanner, 0, sizeof(*scanner));
+    scanner->pool = pool;
+    scanner->type = type;
+    if (type == STREAM_DOUBLE && !device_has_extension(device_id, "cl_khr_fp64")) {
+        return -1;
+    }
+    snprintf(options, sizeof(options), "-D T=%s -D ITEMS=%d%s", stream_type_name(type), ITEMS,
+        type == STREAM_DOUBLE ? " -D USE_FP64" : type == STREAM_INT ? " -D INT_SCAN" : "");
+    scanner->program = build_program(context, device_id, "kernels/scan.cl", options, &err);
+    if (scanner->program == NULL) {
+        return err;
+    }
+    scanner->tile_sum_kernel = clCreateKernel(scanner->program, "tile_sum_kernel", &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    scanner->scan_tile_kernel = clCreateKernel(scanner->program, "scan_tile_kernel", &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    // Largest power of two both kernels can launch with
+    clGetKernelWorkGroupInfo(scanner->scan_tile_kernel, device_id, CL_KERNEL_WORK_GROUP_SIZE,
+        sizeof(max_work_group_size), &max_work_group_size, NULL);
+    scanner->local_size = 1;
+    while (scanner->local_size * 2 <= max_work_group_size && scanner->local_size * 2 <= MAX_LOCAL_SIZE) {
+        scanner->local_size *= 2;
+    }
+    scanner->tile = scanner->local_size * ITEMS;
+    return CL_SUCCESS;
+}
+
+/**
+ * Scan tile by tile, scanning the tile totals recursively when there is
+ * more than one tile.
+ */
+static cl_int scan_level(Scanner* scanner, cl_command_queue command_queue, cl_mem input, cl_mem output, int n,
+    int inclusive)
+{
+    size_t element_size = stream_type_size(scanner->type);
+    size_t local_size = scanner->local_size;
+    size_t padded_tile = scanner->tile + scanner->tile / 32;
+    int tiles = (int)((n + scanner->tile - 1) / scanner->tile);
+    size_t global_size = (size_t)tiles * local_size;
+    int use_offsets = tiles > 1;
+    cl_mem tile_sums = NULL;
+    cl_int err = CL_SUCCESS;
+
+    if (use_offsets) {
+        tile_sums = buffer_pool_acquire(scanner->pool, (size_t)tiles * element_size, &err);
+        if (err != CL_SUCCESS) {
+            return err;
+        }
+        clSetKernelArg(scanner->tile_sum_kernel, 0, sizeof(cl_mem), &input);
+        clSetKernelArg(scanner->tile_sum_kernel, 1, sizeof(int), &n);
+        clSetKernelArg(scanner->tile_sum_kernel, 2, sizeof(cl_mem), &tile_sums);
+        clSetKernelArg(scanner->tile_sum_kernel, 3, local_size * element_size, NULL);
+        err = clEnqueueNDRangeKernel(command_queue, scanner->tile_sum_kernel, 1, NULL, &global_size, &local_size,
+            0, NULL, NULL);
+        if (err == CL_SUCCESS) {
+            err = scan_level(scanner, command_queue, tile_sums, tile_sums, tiles, 1);
+        }
+    }
+
+    if (err == CL_SUCCESS) {
+        clSetKernelArg(scanner->scan_tile_kernel, 0, sizeof(cl_mem), &input);
+        clSetKernelArg(scanner->scan_tile_kernel, 1, sizeof(cl_mem), &output);
+        clSetKernelArg(scanner->scan_tile_kernel, 2, sizeof(int), &n);
+        clSetKernelArg(scanner->scan_tile_kernel, 3, sizeof(cl_mem), use_offsets ? &tile_sums : &input);
+        clSetKernelArg(scanner->scan_tile_kernel, 4, sizeof(int), &use_offsets);
+        clSetKernelArg(scanner->scan_tile_kernel, 5, sizeof(int), &inclusive);
+        clSetKernelArg(scanner->scan_tile_kernel, 6, padded_tile * element_size, NULL);
+        clSetKernelArg(scanner->scan_tile_kernel, 7, local_size * element_size, NULL);
+        err = clEnqueueNDRangeKernel(command_queue, scanner->scan_tile_kernel, 1, NULL, &global_size, &local_size,
+            0, NULL, NULL);
+    }
+    if (tile_sums != NULL) {
+        buffer_pool_give_back(scanner->pool, tile_sums);
+    }
+    return err;
+}
+
+cl_int scanner_run(Scanner* scanner, cl_command_queue command_queue, cl_mem input, cl_mem output, int n,
+    int inclusive)
+{
+    if (n <= 0) {
+        return CL_SUCCESS;
+    }
+    return scan_level(scanner, command_queue, input, output, n, inclusive);
+}
+
+void scanner_release(Scanner* scanner)
+{
+    if (scanner->tile_sum_kernel != NULL) {
+        clReleaseKernel(scanner->tile_sum_kernel);
+    }
+    if (scanner->scan_tile_kernel != NULL) {
+        clReleaseKernel(scanner->scan_tile_kernel);
+    }
+    if (scanner->program != NULL) {
+        clReleaseProgram(scanner->program);
+    }
+    memset(scanner, 0, sizeof(*scanner));
+}
+
+cl_int compactor_init(Compactor* compactor, cl_context context, cl_device_id device_id, BufferPool* pool)
+{
+    cl_int err;
+
+    memset(compactor, 0, sizeof(*compactor));
+    err = scanner_init(&compactor->scanner, context, device_id, pool, STREAM_INT);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    compactor->flags_kernel = clCreateKernel(compactor->scanner.program, "compact_flags_kernel", &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    compactor->scatter_kernel = clCreateKernel(compactor->scanner.program, "compact_scatter_kernel", &err);
+    return err;
+}
+
+cl_int compactor_run(Compactor* compactor, cl_command_queue command_queue, cl_mem input, int n, cl_uint mask,
+    cl_mem output, cl_mem indices, int* count)
+{
+    size_t global_size = (size_t)n;
+    cl_int last_position;
+    cl_uint last_element;
+    cl_mem positions;
+    cl_int err;
+
+    *count = 0;
+    if (n <= 0) {
+        return CL_SUCCESS;
+    }
+    positions = buffer_pool_acquire(compactor->scanner.pool, (size_t)n * sizeof(cl_int), &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    // Flags, scanned in place into the output positions
+    clSetKernelArg(compactor->flags_kernel, 0, sizeof(cl_mem), &input);
+    clSetKernelArg(compactor->flags_kernel, 1, sizeof(int), &n);
+    clSetKernelArg(compactor->flags_kernel, 2, sizeof(cl_uint), &mask);
+    clSetKernelArg(compactor->flags_kernel, 3, sizeof(cl_mem), &positions);
+    err = clEnqueueNDRangeKernel(command_queue, compactor->flags_kernel, 1, NULL, &global_size, NULL,
+        0, NULL, NULL);
+    if (err == CL_SUCCESS) {
+        err = scanner_run(&compactor->scanner, command_queue, positions, positions, n, 0);
+    }
+    if (err == CL_SUCCESS) {
+        clSetKernelArg(compactor->scatter_kernel, 0, sizeof(cl_mem), &input);
+        clSetKernelArg(compactor->scatter_kernel, 1, sizeof(int), &n);
+        clSetKernelArg(compactor->scatter_kernel, 2, sizeof(cl_uint), &mask);
+        clSetKernelArg(compactor->scatter_kernel, 3, sizeof(cl_mem), &positions);
+        clSetKernelArg(compactor->scatter_kernel, 4, sizeof(cl_mem), &output);
+        clSetKernelArg(compactor->scatter_kernel, 5, sizeof(cl_mem), &indices);
+        err = clEnqueueNDRangeKernel(command_queue, compactor->scatter_kernel, 1, NULL, &global_size, NULL,
+            0, NULL, NULL);
+    }
+
+    // The count is the exclusive position of the last element plus its flag
+    if (err == CL_SUCCESS) {
+        clEnqueueReadBuffer(command_queue, positions, CL_FALSE, (size_t)(n - 1) * sizeof(cl_int), sizeof(cl_int),
+            &last_position, 0, NULL, NULL);
+        err = clEnqueueReadBuffer(command_queue, input, CL_TRUE, (size_t)(n - 1) * sizeof(cl_uint), sizeof(cl_uint),
+            &last_element, 0, NULL, NULL);
+    }
+    if (err == CL_SUCCESS) {
+        *count = last_position + ((last_element & mask) != 0);
+    }
+    buffer_pool_give_back(compactor->scanner.pool, positions);
+    return err;
+}
+
+void compactor_release(Compactor* compactor)
+{
+    if (compactor->flags_kernel != NULL) {
+        clReleaseKernel(compactor->flags_kernel);
+    }
+    if (compactor->scatter_kernel != NULL) {
+        clReleaseKernel(compactor->scatter_kernel);
+    }
+    scanner_release(&compactor->scanner);
+    memset(compactor, 0, sizeof(*compactor));
+}
+
+/**
+ * Host scan of one element type.
+ */
+#define SCAN_CPU(ELEM)                                                          \
+    {                                                                           \
+        const ELEM* x = (const ELEM*)input;                                     \
+        ELEM* y = (ELEM*)output;                                                \
+        ELEM sum = 0;                                                           \
+        int i;                                                                  \
+        for (i = 0; i < n; ++i) {                                               \
+            ELEM element = x[i];                                                \
+            y[i] = inclusive ? sum + element : sum;                             \
+            sum += element;                                                     \
+        }                                                                       \
+    }
+
+void scan_cpu(StreamType type, const void* input, void* output, int n, int inclusive)
+{
+    if (type == STREAM_INT) {
+        SCAN_CPU(cl_int)
+    } else if (type == STREAM_FLOAT) {
+        SCAN_CPU(cl_float)
+    } else {
+        SCAN_CPU(cl_double)
+    }
+}
+
+int compact_cpu(const cl_uint* input, int n, cl_uint mask, cl_uint* output)
+{
+    int i, count = 0;
+
+    for (i = 0; i < n; ++i) {
+        if ((input[i] & mask) != 0) {
+            output[count++] = input[i];
+        }
+    }
+    return count;
+}
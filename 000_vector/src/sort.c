@@ -0,0 +1,143 @@
+#include "sort.h"
+
+#include <string.h>
+
+// Bits sorted per pass, RADIX_BITS of kernels/scan.cl
+#define RADIX_BITS 4
+#define RADIX (1 << RADIX_BITS)
+
+// Keys per work-item, ITEMS of the scanner program
+#define ITEMS 8
+
+#define MAX_LOCAL_SIZE 256
+
+cl_int radix_sorter_init(RadixSorter* sorter, cl_context context, cl_device_id device_id, BufferPool* pool)
+{
+    size_t max_work_group_size;
+    cl_int err;
+
+    memset(sorter, 0, sizeof(*sorter));
+    err = scanner_init(&sorter->scanner, context, device_id, pool, STREAM_INT);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    sorter->histogram_kernel = clCreateKernel(sorter->scanner.program, "radix_histogram_kernel", &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    sorter->scatter_kernel = clCreateKernel(sorter->scanner.program, "radix_scatter_kernel", &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    // Largest power of two the scatter can launch with, at least one work-item per digit
+    clGetKernelWorkGroupInfo(sorter->scatter_kernel, device_id, CL_KERNEL_WORK_GROUP_SIZE,
+        sizeof(max_work_group_size), &max_work_group_size, NULL);
+    sorter->local_size = RADIX;
+    while (sorter->local_size * 2 <= max_work_group_size && sorter->local_size * 2 <= MAX_LOCAL_SIZE) {
+        sorter->local_size *= 2;
+    }
+    sorter->tile = sorter->local_size * ITEMS;
+    return CL_SUCCESS;
+}
+
+cl_int radix_sort(RadixSorter* sorter, cl_command_queue command_queue, cl_mem keys, cl_mem values, int n,
+    int key_bits)
+{
+    BufferPool* pool = sorter->scanner.pool;
+    size_t local_size = sorter->local_size;
+    int groups = (int)((n + sorter->tile - 1) / sorter->tile);
+    size_t global_size = (size_t)groups * local_size;
+    cl_mem keys_in = keys, values_in = values;
+    cl_mem keys_out, values_out = NULL, counts = NULL;
+    cl_int err;
+    int shift;
+
+    if (n <= 1) {
+        return CL_SUCCESS;
+    }
+    keys_out = buffer_pool_acquire(pool, (size_t)n * sizeof(cl_uint), &err);
+    if (err == CL_SUCCESS && values != NULL) {
+        values_out = buffer_pool_acquire(pool, (size_t)n * sizeof(cl_int), &err);
+    }
+    if (err == CL_SUCCESS) {
+        counts = buffer_pool_acquire(pool, (size_t)groups * RADIX * sizeof(cl_int), &err);
+    }
+
+    for (shift = 0; shift < key_bits && err == CL_SUCCESS; shift += RADIX_BITS) {
+        cl_mem swap;
+        int total = groups * RADIX;
+
+        clSetKernelArg(sorter->histogram_kernel, 0, sizeof(cl_mem), &keys_in);
+        clSetKernelArg(sorter->histogram_kernel, 1, sizeof(int), &n);
+        clSetKernelArg(sorter->histogram_kernel, 2, sizeof(int), &shift);
+        clSetKernelArg(sorter->histogram_kernel, 3, sizeof(cl_mem), &counts);
+        clSetKernelArg(sorter->histogram_kernel, 4, sizeof(int), &groups);
+        clSetKernelArg(sorter->histogram_kernel, 5, RADIX * sizeof(cl_int), NULL);
+        err = clEnqueueNDRangeKernel(command_queue, sorter->histogram_kernel, 1, NULL, &global_size, &local_size,
+            0, NULL, NULL);
+        if (err == CL_SUCCESS) {
+            err = scanner_run(&sorter->scanner, command_queue, counts, counts, total, 0);
+        }
+        if (err != CL_SUCCESS) {
+            break;
+        }
+        clSetKernelArg(sorter->scatter_kernel, 0, sizeof(cl_mem), &keys_in);
+        clSetKernelArg(sorter->scatter_kernel, 1, sizeof(cl_mem), &values_in);
+        clSetKernelArg(sorter->scatter_kernel, 2, sizeof(int), &n);
+        clSetKernelArg(sorter->scatter_kernel, 3, sizeof(int), &shift);
+        clSetKernelArg(sorter->scatter_kernel, 4, sizeof(cl_mem), &counts);
+        clSetKernelArg(sorter->scatter_kernel, 5, sizeof(int), &groups);
+        clSetKernelArg(sorter->scatter_kernel, 6, sizeof(cl_mem), &keys_out);
+        clSetKernelArg(sorter->scatter_kernel, 7, sizeof(cl_mem), &values_out);
+        clSetKernelArg(sorter->scatter_kernel, 8, RADIX * local_size * sizeof(cl_int), NULL);
+        clSetKernelArg(sorter->scatter_kernel, 9, local_size * sizeof(cl_int), NULL);
+        err = clEnqueueNDRangeKernel(command_queue, sorter->scatter_kernel, 1, NULL, &global_size, &local_size,
+            0, NULL, NULL);
+
+        // Ping-pong between the caller's buffers and the pool ones
+        swap = keys_in;
+        keys_in = keys_out;
+        keys_out = swap;
+        swap = values_in;
+        values_in = values_out;
+        values_out = swap;
+    }
+
+    // An odd number of passes leaves the result in the pool buffers
+    if (err == CL_SUCCESS && keys_in != keys) {
+        clEnqueueCopyBuffer(command_queue, keys_in, keys, 0, 0, (size_t)n * sizeof(cl_uint), 0, NULL, NULL);
+        if (values != NULL) {
+            err = clEnqueueCopyBuffer(command_queue, values_in, values, 0, 0, (size_t)n * sizeof(cl_int),
+                0, NULL, NULL);
+        }
+    }
+
+    // Give back the pool buffers, whichever side of the ping-pong they ended on
+    if (keys_in != keys) {
+        keys_out = keys_in;
+        values_out = values_in;
+    }
+    if (keys_out != NULL) {
+        buffer_pool_give_back(pool, keys_out);
+    }
+    if (values_out != NULL) {
+        buffer_pool_give_back(pool, values_out);
+    }
+    if (counts != NULL) {
+        buffer_pool_give_back(pool, counts);
+    }
+    return err;
+}
+
+void radix_sorter_release(RadixSorter* sorter)
+{
+    if (sorter->histogram_kernel != NULL) {
+        clReleaseKernel(sorter->histogram_kernel);
+    }
+    if (sorter->scatter_kernel != NULL) {
+        clReleaseKernel(sorter->scatter_kernel);
+    }
+    scanner_release(&sorter->scanner);
+    memset(sorter, 0, sizeof(*sorter));
+}
@@ -0,0 +1,366 @@
+#include "stream.h"
+#include "kernel_loader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Scalar of scale and triad
+#define STREAM_SCALAR 3
+
+// Initial values of the arrays and their values after copy, scale, add and triad
+#define INITIAL_A 1
+#define INITIAL_B 2
+#define INITIAL_C 0
+#define EXPECTED_A (STREAM_SCALAR * INITIAL_A + STREAM_SCALAR * (INITIAL_A + STREAM_SCALAR * INITIAL_A))
+#define EXPECTED_B (STREAM_SCALAR * INITIAL_A)
+#define EXPECTED_C (INITIAL_A + STREAM_SCALAR * INITIAL_A)
+
+static const char* kernel_names[STREAM_KERNELS] = {
+    "stream_copy_kernel", "stream_scale_kernel", "stream_add_kernel", "stream_triad_kernel"
+};
+
+// Arrays read and written by each kernel
+static const int kernel_arrays[STREAM_KERNELS] = { 2, 2, 3, 3 };
+
+const char* stream_type_name(StreamType type)
+{
+    switch (type) {
+    case STREAM_INT:
+        return "int";
+    case STREAM_FLOAT:
+        return "float";
+    default:
+        return "double";
+    }
+}
+
+size_t stream_type_size(StreamType type)
+{
+    return type == STREAM_DOUBLE ? sizeof(cl_double) : sizeof(cl_int);
+}
+
+const char* stream_kernel_name(StreamKernel kernel)
+{
+    static const char* names[STREAM_KERNELS] = { "copy", "scale", "add", "triad" };
+
+    return names[kernel];
+}
+
+static double event_time(cl_event event, cl_profiling_info info)
+{
+    cl_ulong ns;
+
+    clGetEventProfilingInfo(event, info, sizeof(ns), &ns, NULL);
+    return (double)ns / 1000000000.0;
+}
+
+static double wall_time(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+/**
+ * Check whether the device supports an extension.
+ */
+static int device_has_extension(cl_device_id device_id, const char* extension)
+{
+    size_t size;
+    char* extensions;
+    int found;
+
+    clGetDeviceInfo(device_id, CL_DEVICE_EXTENSIONS, 0, NULL, &size);
+    extensions = (char*)malloc(size + 1);
+    clGetDeviceInfo(device_id, CL_DEVICE_EXTENSIONS, size, extensions, NULL);
+    extensions[size] = 0;
+    found = strstr(extensions, extension) != NULL;
+    free(extensions);
+    return found;
+}
+
+/**
+ * Set a scalar kernel argument of the element type.
+ */
+static cl_int set_scalar_arg(cl_kernel kernel, cl_uint index, StreamType type, int value)
+{
+    cl_int int_value = value;
+    cl_float float_value = (cl_float)value;
+    cl_double double_value = value;
+
+    switch (type) {
+    case STREAM_INT:
+        return clSetKernelArg(kernel, index, sizeof(int_value), &int_value);
+    case STREAM_FLOAT:
+        return clSetKernelArg(kernel, index, sizeof(float_value), &float_value);
+    default:
+        return clSetKernelArg(kernel, index, sizeof(double_value), &double_value);
+    }
+}
+
+/**
+ * Fill n elements of a device buffer with a value of the element type.
+ */
+static cl_int fill_array(cl_command_queue command_queue, cl_mem buffer, StreamType type, int value, size_t n)
+{
+    cl_int int_value = value;
+    cl_float float_value = (cl_float)value;
+    cl_double double_value = value;
+    const void* pattern = type == STREAM_INT ? (const void*)&int_value
+        : type == STREAM_FLOAT ? (const void*)&float_value : (const void*)&double_value;
+    size_t size = stream_type_size(type);
+
+    return clEnqueueFillBuffer(command_queue, buffer, pattern, size, 0, n * size, 0, NULL, NULL);
+}
+
+/**
+ * Check that the first n elements of a host array all hold the value.
+ */
+static int check_array(const void* array, StreamType type, int value, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        double element = type == STREAM_INT ? ((const cl_int*)array)[i]
+            : type == STREAM_FLOAT ? ((const cl_float*)array)[i] : ((const cl_double*)array)[i];
+        if (element != value) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+cl_int stream_run(cl_context context, cl_device_id device_id, cl_command_queue command_queue, BufferPool* pool,
+    StreamType type, int width, size_t array_bytes, int repeats, StreamResult results[STREAM_KERNELS], int* verified)
+{
+    size_t count = array_bytes / stream_type_size(type);
+    int n = (int)(count / width);
+    size_t global_work_size = (size_t)n;
+    cl_kernel kernels[STREAM_KERNELS] = { NULL };
+    cl_mem a = NULL, b = NULL, c = NULL;
+    cl_program program;
+    char options[128];
+    cl_int err;
+    int k, r;
+
+    *verified = 0;
+    if (type == STREAM_DOUBLE && !device_has_extension(device_id, "cl_khr_fp64")) {
+        return -1;
+    }
+    sprintf(options, "-D T=%s -D W=%d%s", stream_type_name(type), width,
+        type == STREAM_DOUBLE ? " -D USE_FP64" : "");
+    program = build_program(context, device_id, "kernels/stream.cl", options, &err);
+    if (program == NULL) {
+        return err;
+    }
+    for (k = 0; k < STREAM_KERNELS && err == CL_SUCCESS; ++k) {
+        kernels[k] = clCreateKernel(program, kernel_names[k], &err);
+    }
+    if (err == CL_SUCCESS) {
+        a = buffer_pool_acquire(pool, array_bytes, &err);
+    }
+    if (err == CL_SUCCESS) {
+        b = buffer_pool_acquire(pool, array_bytes, &err);
+    }
+    if (err == CL_SUCCESS) {
+        c = buffer_pool_acquire(pool, array_bytes, &err);
+    }
+    if (err == CL_SUCCESS) {
+        fill_array(command_queue, a, type, INITIAL_A, count);
+        fill_array(command_queue, b, type, INITIAL_B, count);
+        err = fill_array(command_queue, c, type, INITIAL_C, count);
+    }
+
+    // Each kernel leaves its own inputs unchanged, so its repeats compute the same result
+    if (err == CL_SUCCESS) {
+        cl_mem copy_args[] = { a, c };
+        cl_mem scale_args[] = { b, c };
+        cl_mem add_args[] = { a, b, c };
+        cl_mem triad_args[] = { a, b, c };
+        cl_mem* args[STREAM_KERNELS] = { copy_args, scale_args, add_args, triad_args };
+
+        for (k = 0; k < STREAM_KERNELS; ++k) {
+            cl_uint arg;
+            for (arg = 0; arg < (cl_uint)kernel_arrays[k]; ++arg) {
+                clSetKernelArg(kernels[k], arg, sizeof(cl_mem), &args[k][arg]);
+            }
+            if (k == STREAM_SCALE || k == STREAM_TRIAD) {
+                set_scalar_arg(kernels[k], arg++, type, STREAM_SCALAR);
+            }
+            clSetKernelArg(kernels[k], arg, sizeof(int), &n);
+        }
+    }
+    for (k = 0; k < STREAM_KERNELS && err == CL_SUCCESS; ++k) {
+        double total = 0.0;
+
+        results[k].best_s = -1.0;
+        // The first launch is a warm-up
+        for (r = 0; r <= repeats && err == CL_SUCCESS; ++r) {
+            cl_event event;
+            err = clEnqueueNDRangeKernel(command_queue, kernels[k], 1, NULL, &global_work_size, NULL, 0, NULL, &event);
+            if (err != CL_SUCCESS) {
+                break;
+            }
+            clWaitForEvents(1, &event);
+            double seconds = event_time(event, CL_PROFILING_COMMAND_END) - event_time(event, CL_PROFILING_COMMAND_START);
+            clReleaseEvent(event);
+            if (r > 0) {
+                total += seconds;
+                if (results[k].best_s < 0.0 || seconds < results[k].best_s) {
+                    results[k].best_s = seconds;
+                }
+            }
+        }
+        results[k].average_s = total / repeats;
+        results[k].gbs = (double)kernel_arrays[k] * n * width * stream_type_size(type) / results[k].best_s / 1e9;
+    }
+
+    // Read the arrays back through a pinned host buffer
+    if (err == CL_SUCCESS) {
+        void* host = buffer_pool_acquire_host(pool, array_bytes, &err);
+        size_t checked = (size_t)n * width;
+        if (host != NULL) {
+            *verified = clEnqueueReadBuffer(command_queue, a, CL_TRUE, 0, array_bytes, host, 0, NULL, NULL) == CL_SUCCESS
+                && check_array(host, type, EXPECTED_A, checked)
+                && clEnqueueReadBuffer(command_queue, b, CL_TRUE, 0, array_bytes, host, 0, NULL, NULL) == CL_SUCCESS
+                && check_array(host, type, EXPECTED_B, checked)
+                && clEnqueueReadBuffer(command_queue, c, CL_TRUE, 0, array_bytes, host, 0, NULL, NULL) == CL_SUCCESS
+                && check_array(host, type, EXPECTED_C, checked);
+            buffer_pool_give_back_host(pool, host);
+        }
+    }
+
+    if (a != NULL) {
+        buffer_pool_give_back(pool, a);
+    }
+    if (b != NULL) {
+        buffer_pool_give_back(pool, b);
+    }
+    if (c != NULL) {
+        buffer_pool_give_back(pool, c);
+    }
+    for (k = 0; k < STREAM_KERNELS; ++k) {
+        if (kernels[k] != NULL) {
+            clReleaseKernel(kernels[k]);
+        }
+    }
+    clReleaseProgram(program);
+    return err;
+}
+
+/**
+ * Best time of a write (to_device = 1) or read of bytes bytes between host and buffer.
+ */
+static double time_transfer(cl_command_queue command_queue, cl_mem buffer, void* host, size_t bytes,
+    int to_device, int repeats)
+{
+    double best = -1.0;
+    int r;
+
+    for (r = 0; r <= repeats; ++r) {
+        cl_event event;
+        cl_int err = to_device
+            ? clEnqueueWriteBuffer(command_queue, buffer, CL_TRUE, 0, bytes, host, 0, NULL, &event)
+            : clEnqueueReadBuffer(command_queue, buffer, CL_TRUE, 0, bytes, host, 0, NULL, &event);
+        if (err != CL_SUCCESS) {
+            return -1.0;
+        }
+        double seconds = event_time(event, CL_PROFILING_COMMAND_END) - event_time(event, CL_PROFILING_COMMAND_START);
+        clReleaseEvent(event);
+        if (r > 0 && (best < 0.0 || seconds < best)) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+cl_int transfer_bandwidth(cl_command_queue command_queue, BufferPool* pool, size_t bytes, int repeats,
+    TransferResult* result)
+{
+    cl_int err;
+    cl_mem buffer = buffer_pool_acquire(pool, bytes, &err);
+    void* pinned;
+    void* pageable;
+
+    if (buffer == NULL) {
+        return err;
+    }
+    pinned = buffer_pool_acquire_host(pool, bytes, &err);
+    if (pinned == NULL) {
+        buffer_pool_give_back(pool, buffer);
+        return err;
+    }
+    pageable = malloc(bytes);
+    memset(pageable, 0, bytes);
+    memset(pinned, 0, bytes);
+
+    result->h2d_pinned = bytes / time_transfer(command_queue, buffer, pinned, bytes, 1, repeats) / 1e9;
+    result->d2h_pinned = bytes / time_transfer(command_queue, buffer, pinned, bytes, 0, repeats) / 1e9;
+    result->h2d_pageable = bytes / time_transfer(command_queue, buffer, pageable, bytes, 1, repeats) / 1e9;
+    result->d2h_pageable = bytes / time_transfer(command_queue, buffer, pageable, bytes, 0, repeats) / 1e9;
+
+    free(pageable);
+    buffer_pool_give_back_host(pool, pinned);
+    buffer_pool_give_back(pool, buffer);
+    return CL_SUCCESS;
+}
+
+cl_int launch_latency(cl_context context, cl_device_id device_id, cl_command_queue command_queue, int repeats,
+    LatencyResult* result)
+{
+    size_t global_work_size = 1;
+    double queued_to_start = 0.0;
+    double round_trip = 0.0;
+    cl_program program;
+    cl_kernel kernel;
+    cl_mem buffer;
+    cl_int err;
+    int n = 0;
+    int r;
+
+    // A copy of zero elements does no work, leaving only the launch
+    program = build_program(context, device_id, "kernels/stream.cl", "-D T=int -D W=1", &err);
+    if (program == NULL) {
+        return err;
+    }
+    kernel = clCreateKernel(program, "stream_copy_kernel", &err);
+    if (err != CL_SUCCESS) {
+        clReleaseProgram(program);
+        return err;
+    }
+    buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_int), NULL, &err);
+    if (err != CL_SUCCESS) {
+        clReleaseKernel(kernel);
+        clReleaseProgram(program);
+        return err;
+    }
+    clSetKernelArg(kernel, 0, sizeof(cl_mem), &buffer);
+    clSetKernelArg(kernel, 1, sizeof(cl_mem), &buffer);
+    clSetKernelArg(kernel, 2, sizeof(int), &n);
+
+    for (r = 0; r <= repeats && err == CL_SUCCESS; ++r) {
+        cl_event event;
+        double start = wall_time();
+        err = clEnqueueNDRangeKernel(command_queue, kernel, 1, NULL, &global_work_size, NULL, 0, NULL, &event);
+        if (err != CL_SUCCESS) {
+            break;
+        }
+        clWaitForEvents(1, &event);
+        double seconds = wall_time() - start;
+        if (r > 0) {
+            round_trip += seconds;
+            queued_to_start += event_time(event, CL_PROFILING_COMMAND_START) - event_time(event, CL_PROFILING_COMMAND_QUEUED);
+        }
+        clReleaseEvent(event);
+    }
+    result->queued_to_start_us = queued_to_start / repeats * 1e6;
+    result->round_trip_us = round_trip / repeats * 1e6;
+
+    clReleaseMemObject(buffer);
+    clReleaseKernel(kernel);
+    clReleaseProgram(program);
+    return err;
+}
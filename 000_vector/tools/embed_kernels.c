@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Write a C file defining embedded_kernels (kernel_loader.h): the source of
+ * every kernel file given on the command line as a string constant, keyed by
+ * the path it is given with.
+ *
+ * Usage: embed_kernels output.c kernels/a.cl kernels/b.cl ...
+ */
+int main(int argc, char** argv)
+{
+    FILE* output;
+    int i, c;
+
+    if (argc < 2) {
+        printf("Usage: %s output.c kernels...\n", argv[0]);
+        return 1;
+    }
+    output = fopen(argv[1], "w");
+    if (output == NULL) {
+        printf("Error opening %s\n", argv[1]);
+        return 1;
+    }
+    fprintf(output, "// Generated by tools/embed_kernels.c, do not edit\n\n");
+    fprintf(output, "#include \"kernel_loader.h\"\n\n#include <stddef.h>\n\n");
+    fprintf(output, "const EmbeddedKernel embedded_kernels[] = {\n");
+
+    for (i = 2; i < argc; ++i) {
+        FILE* input = fopen(argv[i], "rb");
+        const char* p;
+        if (input == NULL) {
+            printf("Error opening %s\n", argv[i]);
+            fclose(output);
+            return 1;
+        }
+
+        // The path with forward slashes, as the tools pass it
+        fprintf(output, "    { \"");
+        for (p = argv[i]; *p != 0; ++p) {
+            fputc(*p == '\\' ? '/' : *p, output);
+        }
+        fprintf(output, "\",\n        \"");
+
+        // One string literal per source line
+        while ((c = fgetc(input)) != EOF) {
+            if (c == '\n') {
+                fprintf(output, "\\n\"\n        \"");
+            } else if (c == '\\' || c == '"' || c == '?') {
+                fprintf(output, "\\%c", c);
+            } else if (c == '\t') {
+                fprintf(output, "\\t");
+            } else if (c < 32 || c > 126) {
+                fprintf(output, "\\%03o", c);
+            } else {
+                fputc(c, output);
+            }
+        }
+        fprintf(output, "\" },\n");
+        fclose(input);
+    }
+
+    fprintf(output, "    { NULL, NULL }\n};\n");
+    fclose(output);
+    return 0;
+}
@@ -0,0 +1,54 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include "gemm.h"
+
+/**
+ * gemm_autotune result when no candidate could run, outside the OpenCL error codes
+ */
+#define GEMM_TUNE_NO_CANDIDATE 1
+
+/**
+ * Path of the tuning file of a device: gemm_<device name>.cfg in the
+ * directory given by the GEMM_CONFIG_DIR environment variable, or in the
+ * working directory.
+ */
+void gemm_config_path(cl_device_id device_id, char* path, size_t size);
+
+/**
+ * Load the tuned configuration of an element type and size class.
+ *
+ * Returns 0 on success, -1 if the device has no tuned configuration for them
+ */
+int gemm_config_load(cl_device_id device_id, GemmType type, int size_class, GemmConfig* config);
+
+/**
+ * Store the configurations of every size class of an element type in the
+ * tuning file of the device, keeping the entries of the other types.
+ *
+ * gflops: Measured performance of each configuration; classes at 0 were not
+ *         tuned and keep their previous entry, if any
+ *
+ * Returns 0 on success, -1 if the file could not be written
+ */
+int gemm_config_save(cl_device_id device_id, GemmType type,
+    const GemmConfig configs[GEMM_SIZE_CLASSES], const double gflops[GEMM_SIZE_CLASSES]);
+
+/**
+ * Benchmark the candidate configurations (register block, vector width,
+ * local size, batched tile size) with event profiling for every size class,
+ * then save the fastest ones with gemm_config_save.
+ *
+ * The command queue must be created with CL_QUEUE_PROFILING_ENABLE.
+ *
+ * configs: Fastest configuration of each size class
+ * gflops: Their performance
+ *
+ * Returns 0 on success, GEMM_TYPE_UNSUPPORTED if the device does not support the
+ * type, -1 if a kernel source could not be loaded, GEMM_TUNE_NO_CANDIDATE
+ * if no candidate ran (nothing is saved), otherwise an OpenCL error code
+ */
+int gemm_autotune(cl_context context, cl_device_id device_id, cl_command_queue command_queue,
+    GemmType type, GemmConfig configs[GEMM_SIZE_CLASSES], double gflops[GEMM_SIZE_CLASSES]);
+
+#endif
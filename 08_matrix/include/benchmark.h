@@ -0,0 +1,63 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "gemm.h"
+#include "sparse.h"
+
+/**
+ * Sweep square sizes and rectangular shapes across the kernel variants
+ * (naive, register-blocked, tuned and the CPU implementation) and write one
+ * CSV line per variant and shape:
+ *
+ * kernel_s: Kernel time from CL_PROFILING_COMMAND_START to END (best of the repeats)
+ * end_to_end_s: Upload of A and B, kernel and readback of C
+ * gflops, end_to_end_gflops: GFLOPS (GOPS for the integer types) of both times
+ * bandwidth_gbs: Minimal traffic (A, B and C once) divided by the kernel time
+ * verified: Result matches the CPU implementation (- when not checked)
+ *
+ * context, device_id, command_queue: Device to benchmark, NULL for the CPU only.
+ *                                    The queue must have profiling enabled.
+ *
+ * Returns 0 on success, -1 if the CSV file cannot be written
+ */
+int gemm_benchmark(cl_context context, cl_device_id device_id, cl_command_queue command_queue,
+    GemmType type, const char* csv_path);
+
+/**
+ * Compare gemm_strassen with the classical kernels on square sizes from 1024
+ * to 8192 (as far as device memory allows) and write size, both times and the
+ * speedup of Strassen-Winograd to a CSV file. Half results are verified
+ * against a worst-case bound of the rounding of the Strassen temporaries,
+ * "unbounded" when they may overflow half.
+ *
+ * cutoff: Recursion cutoff of gemm_strassen
+ *
+ * Returns 0 on success, -1 if the CSV file cannot be written
+ */
+int gemm_strassen_benchmark(cl_context context, cl_device_id device_id, cl_command_queue command_queue,
+    GemmType type, int cutoff, const char* csv_path);
+
+/**
+ * Time gemm_transpose on square and rectangular matrices against a
+ * clEnqueueCopyBuffer of the same size, verify the results and write the
+ * bandwidth of both (read and write traffic) and their ratio to a CSV file.
+ *
+ * Returns 0 on success, -1 if the CSV file cannot be written
+ */
+int gemm_transpose_benchmark(cl_context context, cl_device_id device_id, cl_command_queue command_queue,
+    GemmType type, const char* csv_path);
+
+/**
+ * Time the SpMV variants and SpMM with columns dense columns on a CSR matrix,
+ * verify them against the CPU and print the results. The dense GEMM of the
+ * same product is timed for comparison when the matrix is small enough.
+ *
+ * context, device_id, command_queue: Device to benchmark, NULL for the CPU only.
+ *                                    The queue must have profiling enabled.
+ *
+ * Returns 0
+ */
+int sparse_benchmark(cl_context context, cl_device_id device_id, cl_command_queue command_queue,
+    GemmType type, const CsrMatrix* matrix, int columns);
+
+#endif
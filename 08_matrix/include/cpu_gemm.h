@@ -0,0 +1,38 @@
+#ifndef CPU_GEMM_H
+#define CPU_GEMM_H
+
+#include "gemm_types.h"
+
+/**
+ * Host GEMM: C = alpha * A * B + beta * C, where A is M x K, B is K x N and C is M x N.
+ *
+ * Element (i, j) of a matrix X is X[i * x_row_stride + j * x_col_stride], so
+ * row-major, column-major and transposed operands only differ in strides, as
+ * in matrix_mult_kernel. Elements have the types of the OpenCL kernels (C is
+ * int32 for int8 inputs); half and int8 are computed in float and int32.
+ *
+ * The product is cache blocked: panels of A and B are packed into contiguous
+ * buffers and multiplied by SIMD micro-kernels, and the blocks of C are
+ * distributed over n_threads threads (0 uses every processor).
+ */
+void cpu_gemm(GemmType type, int M, int N, int K, double alpha,
+    const void* A, int a_row_stride, int a_col_stride,
+    const void* B, int b_row_stride, int b_col_stride,
+    double beta, void* C, int c_row_stride, int c_col_stride, int n_threads);
+
+/**
+ * Number of processors available to cpu_gemm.
+ */
+int cpu_count(void);
+
+/**
+ * Compare n elements of two C buffers of the type, with a tolerance relative
+ * to the accumulation length K for float and double, and of two ulps for
+ * half. NaN and infinite values only match bit-identical ones, and never
+ * for half.
+ *
+ * Returns the number of mismatching elements
+ */
+size_t gemm_compare(GemmType type, const void* expected, const void* actual, size_t n, int K);
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include "buffer_pool.h"
+#include "gemm.h"
+
+/**
+ * Backend a product was routed to.
+ */
+typedef enum {
+    BACKEND_CPU,
+    BACKEND_DEVICE
+} Backend;
+
+/**
+ * Routes host GEMM calls to cpu_gemm or to the device, whichever is faster
+ * for the problem size. Offloading pays for the transfers of A, B and C and
+ * the launch, so small products stay on the CPU.
+ *
+ * gemm: Device context, NULL to always use the CPU
+ * pool: Device buffers of offloaded products
+ * crossover: Multiply-adds (M * N * K) from which the device is faster,
+ *            negative if it never is
+ */
+typedef struct {
+    GemmContext* gemm;
+    GemmType type;
+    BufferPool pool;
+    double crossover;
+} GemmDispatch;
+
+/**
+ * Load the crossover of the device and type from the tuning file of the
+ * device (see autotune.h), calibrating and saving it if there is none.
+ *
+ * gemm: Device context, NULL for the CPU only
+ * recalibrate: Calibrate even if the tuning file has a crossover
+ *
+ * Returns 0 on success, -1 if calibration failed
+ */
+int gemm_dispatch_init(GemmDispatch* dispatch, GemmContext* gemm, GemmType type, int recalibrate);
+
+/**
+ * Time both backends end to end on square products of doubling size and set
+ * the crossover to the smallest size from which the device stays faster.
+ *
+ * Returns 0 on success, -1 if a device product failed
+ */
+int gemm_dispatch_calibrate(GemmDispatch* dispatch);
+
+/**
+ * Backend an M x K by K x N product is routed to.
+ */
+Backend gemm_dispatch_backend(const GemmDispatch* dispatch, int M, int N, int K);
+
+/**
+ * C = alpha * A * B + beta * C for densely packed row-major host matrices on
+ * the faster backend.
+ *
+ * backend: Set to the backend used, may be NULL
+ *
+ * Returns CL_SUCCESS or an OpenCL error code of the device backend
+ */
+cl_int gemm_dispatch_run(GemmDispatch* dispatch, int M, int N, int K, double alpha,
+    const void* A, const void* B, double beta, void* C, Backend* backend);
+
+/**
+ * Release the device buffers of the dispatcher.
+ */
+void gemm_dispatch_release(GemmDispatch* dispatch);
+
+/**
+ * Load the crossover of a type from the tuning file of the device.
+ *
+ * Returns 0 on success, -1 if there is none
+ */
+int gemm_crossover_load(cl_device_id device_id, GemmType type, double* crossover);
+
+/**
+ * Store the crossover of a type in the tuning file of the device, keeping the other entries.
+ *
+ * Returns 0 on success, -1 if the file could not be written
+ */
+int gemm_crossover_save(cl_device_id device_id, GemmType type, double crossover);
+
+#endif
@@ -0,0 +1,242 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include "gemm_types.h"
+#include "philox.h"
+
+/**
+ * Storage order of a matrix.
+ */
+typedef enum {
+    GEMM_ROW_MAJOR,
+    GEMM_COL_MAJOR
+} GemmLayout;
+
+/**
+ * Operation applied to an operand before the multiplication.
+ */
+typedef enum {
+    GEMM_NO_TRANS,
+    GEMM_TRANS
+} GemmTranspose;
+
+/**
+ * Tunable parameters of the GEMM kernels.
+ *
+ * block: Register block size of matrix_mult_reg_kernel (4 or 8),
+ *        0 to always use the generic kernel
+ * vector_width: Vector width of the B loads of matrix_mult_reg_kernel (4 or 8, divides block)
+ * local_size: Work-group size of the 2D kernels, 0 x 0 lets the runtime choose
+ * tile: Tile size of matrix_mult_batched_kernel
+ */
+typedef struct {
+    int block;
+    int vector_width;
+    int local_size[2];
+    int tile;
+} GemmConfig;
+
+/**
+ * Number of problem-size classes, see gemm_size_class.
+ */
+#define GEMM_SIZE_CLASSES 3
+
+/**
+ * Program and kernels built for one configuration.
+ */
+typedef struct {
+    GemmConfig config;
+    cl_program program;
+    cl_kernel kernel;
+    cl_kernel reg_kernel;
+    cl_kernel batched_kernel;
+    cl_kernel add_kernel;
+} GemmKernels;
+
+/**
+ * Number of transpose kernels, one per element size of 1, 2, 4 and 8 bytes.
+ */
+#define GEMM_TRANSPOSE_KERNELS 4
+
+/**
+ * Kernels and queue used by the GEMM calls of one element type, with one
+ * configuration per problem-size class.
+ *
+ * transpose_tile: Tile size of the transpose kernels
+ * pre_transpose_b: Transpose a row-major B into a scratch buffer before the
+ *                  generic kernel, so it reads A and B along their rows
+ *                  (gemm_run only, batched calls fail)
+ * transpose_event: Event of that transpose in the last gemm_run called with an
+ *                  event, NULL if it did not transpose; the product starts at
+ *                  its CL_PROFILING_COMMAND_START
+ * scratch, scratch_size: Scratch buffer of the transposed B, grown on demand
+ * random: Kernel filling matrices of the element type with random numbers
+ */
+typedef struct {
+    cl_context context;
+    cl_device_id device_id;
+    cl_command_queue command_queue;
+    GemmType type;
+    GemmKernels kernels[GEMM_SIZE_CLASSES];
+    cl_program transpose_program;
+    cl_kernel transpose_kernels[GEMM_TRANSPOSE_KERNELS];
+    int transpose_tile;
+    int pre_transpose_b;
+    cl_event transpose_event;
+    cl_mem scratch;
+    size_t scratch_size;
+    RandomFill random;
+} GemmContext;
+
+/**
+ * Matrix in a device buffer. The buffer stays resident between GEMM calls,
+ * so chained products only transfer what changes.
+ *
+ * rows, cols: Shape of the matrix
+ * layout: Storage order
+ * ld: Leading dimension in elements (row pitch for row-major, column pitch for column-major)
+ * offset: Index of the first element in the buffer
+ * is_output: Elements have the C type of the element type (int32 for int8)
+ * owner: The matrix owns its buffer (0 for views)
+ */
+typedef struct {
+    cl_mem buffer;
+    int rows;
+    int cols;
+    GemmLayout layout;
+    int ld;
+    int offset;
+    int is_output;
+    int owner;
+} GemmMatrix;
+
+/**
+ * Configuration used when no tuned one is available.
+ */
+extern const GemmConfig gemm_default_config;
+
+/**
+ * Problem-size class of an M x K by K x N product (0: small, 1: medium, 2: large),
+ * decided by the largest dimension.
+ */
+int gemm_size_class(int M, int N, int K);
+
+/**
+ * Build the GEMM program for the element type on the device.
+ *
+ * config: Configuration used for every size class, or NULL to load the tuned
+ *         configurations of the device (see autotune.h) and use
+ *         gemm_default_config for classes without one
+ *
+ * Returns 0 on success, GEMM_TYPE_UNSUPPORTED if the device does not support the
+ * type, -1 if a kernel source could not be loaded, otherwise an OpenCL error code
+ */
+int gemm_init(GemmContext* gemm, cl_context context, cl_device_id device_id,
+    cl_command_queue command_queue, GemmType type, const GemmConfig* config);
+
+/**
+ * Release the programs and kernels of the context.
+ */
+void gemm_release(GemmContext* gemm);
+
+/**
+ * Allocate a densely packed rows x cols matrix on the device.
+ *
+ * Returns CL_SUCCESS or the error of clCreateBuffer
+ */
+cl_int gemm_matrix_create(const GemmContext* gemm, GemmMatrix* matrix, int rows, int cols,
+    GemmLayout layout, int is_output);
+
+/**
+ * Allocate batch_count densely packed rows x cols matrices in one buffer.
+ * The matrix describes the first element of the batch, the others follow
+ * with a stride of rows * cols elements.
+ *
+ * Returns CL_SUCCESS or the error of clCreateBuffer
+ */
+cl_int gemm_matrix_create_batched(const GemmContext* gemm, GemmMatrix* matrix, int rows, int cols,
+    GemmLayout layout, int is_output, int batch_count);
+
+/**
+ * Get a rows x cols submatrix of a matrix starting at (row, col). The view
+ * shares the buffer of its parent.
+ */
+GemmMatrix gemm_matrix_view(const GemmMatrix* matrix, int row, int col, int rows, int cols);
+
+/**
+ * Copy densely packed host data, stored in the layout of the matrix, to the device.
+ */
+cl_int gemm_matrix_write(const GemmContext* gemm, GemmMatrix* matrix, const void* host, cl_bool blocking);
+
+/**
+ * Copy the matrix into densely packed host memory in the layout of the matrix.
+ */
+cl_int gemm_matrix_read(const GemmContext* gemm, const GemmMatrix* matrix, void* host, cl_bool blocking);
+
+/**
+ * Enqueue filling a matrix, or batch_count densely packed matrices, with random
+ * integers in [min, max] from a Philox seed. The values equal those of
+ * gemm_type_fill_seeded for densely packed host data in the layout of the matrix.
+ *
+ * Returns CL_SUCCESS or an OpenCL error code
+ */
+cl_int gemm_matrix_fill_random(GemmContext* gemm, GemmMatrix* matrix, int batch_count,
+    cl_ulong seed, int min, int max);
+
+/**
+ * Release the buffer of a matrix unless it is a view.
+ */
+void gemm_matrix_release(GemmMatrix* matrix);
+
+/**
+ * Size of one element of the matrix in bytes.
+ */
+size_t gemm_matrix_elem_size(const GemmContext* gemm, const GemmMatrix* matrix);
+
+/**
+ * Enqueue C = alpha * op(A) * op(B) + beta * C.
+ *
+ * op(A) must be M x K, op(B) K x N and C M x N. C is not read when beta is 0.
+ * event: Event of the kernel launch, may be NULL; with pre_transpose_b the
+ *        transpose before it has gemm->transpose_event
+ *
+ * Returns CL_SUCCESS, CL_INVALID_VALUE for mismatching shapes or an OpenCL error code
+ */
+cl_int gemm_run(GemmContext* gemm, GemmTranspose trans_a, GemmTranspose trans_b,
+    double alpha, const GemmMatrix* A, const GemmMatrix* B,
+    double beta, GemmMatrix* C, cl_event* event);
+
+/**
+ * Enqueue Y = X^T. Y must be X->cols x X->rows with the layout and element
+ * size of X, and must not overlap it.
+ *
+ * event: Event of the kernel launch, may be NULL
+ *
+ * Returns CL_SUCCESS, CL_INVALID_VALUE for mismatching shapes or an OpenCL error code
+ */
+cl_int gemm_transpose(GemmContext* gemm, const GemmMatrix* X, GemmMatrix* Y, cl_event* event);
+
+/**
+ * Enqueue Z = alpha * X + beta * Y element-wise. The matrices must have the
+ * same shape and the element size of C (the type may not be int8); Z may be X or Y.
+ *
+ * Returns CL_SUCCESS, CL_INVALID_VALUE for mismatching shapes or an OpenCL error code
+ */
+cl_int gemm_add(GemmContext* gemm, double alpha, const GemmMatrix* X, double beta, const GemmMatrix* Y,
+    GemmMatrix* Z, cl_event* event);
+
+/**
+ * Enqueue C_b = alpha * op(A_b) * op(B_b) + beta * C_b for b = 0 .. batch_count - 1
+ * in a single launch.
+ *
+ * A, B and C describe the first matrix of each batch; matrix b of X starts
+ * b * stride_x elements after it. A stride of 0 reuses the same matrix for the whole batch.
+ *
+ * Returns CL_SUCCESS, CL_INVALID_VALUE for mismatching shapes or with
+ * pre_transpose_b, or an OpenCL error code
+ */
+cl_int gemm_run_batched(GemmContext* gemm, GemmTranspose trans_a, GemmTranspose trans_b,
+    double alpha, const GemmMatrix* A, int stride_a, const GemmMatrix* B, int stride_b,
+    double beta, GemmMatrix* C, int stride_c, int batch_count, cl_event* event);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef GEMM_OOC_H
+#define GEMM_OOC_H
+
+#include "gemm.h"
+
+/**
+ * Out-of-core C = alpha * A * B + beta * C for row-major host matrices
+ * (A is M x K, B is K x N, C is M x N) that need not fit on the device.
+ *
+ * The operands are split into panels that are streamed through
+ * double-buffered device slots of at most budget bytes in total: panels are
+ * uploaded on a second command queue while the GEMM context's queue computes
+ * with the previous ones, and finished blocks of C are read back the same way.
+ *
+ * budget: Device memory available for the panels in bytes
+ *
+ * Returns CL_SUCCESS, CL_INVALID_VALUE if the budget is too small, or an OpenCL error code
+ */
+cl_int gemm_out_of_core(GemmContext* gemm, int M, int N, int K,
+    double alpha, const void* A, const void* B, double beta, void* C, size_t budget);
+
+#endif
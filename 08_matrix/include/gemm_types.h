@@ -0,0 +1,94 @@
+#ifndef GEMM_TYPES_H
+#define GEMM_TYPES_H
+
+#define CL_TARGET_OPENCL_VERSION 220
+#include <CL/cl.h>
+
+#include <stddef.h>
+
+/**
+ * Element types of the GEMM kernel family.
+ */
+typedef enum {
+    GEMM_INT,
+    GEMM_FLOAT,
+    GEMM_DOUBLE,
+    GEMM_HALF,
+    GEMM_INT8
+} GemmType;
+
+/**
+ * Description of an element type.
+ *
+ * name: Name used on the command line
+ * elem_size: Size of one element of A and B in bytes
+ * out_size: Size of one element of C in bytes
+ * options: Build options selecting the type in kernels/matrix_mult.cl
+ * extension: Device extension required by the type, NULL if none
+ */
+typedef struct {
+    const char* name;
+    size_t elem_size;
+    size_t out_size;
+    const char* options;
+    const char* extension;
+} GemmTypeInfo;
+
+/**
+ * Get the description of an element type.
+ */
+const GemmTypeInfo* gemm_type_info(GemmType type);
+
+/**
+ * Parse a type name (int, float, double, half, int8).
+ *
+ * Returns 0 on success, -1 for an unknown name
+ */
+int gemm_type_parse(const char* name, GemmType* type);
+
+/**
+ * Check whether the device supports an extension.
+ */
+int device_has_extension(cl_device_id device_id, const char* extension);
+
+/**
+ * Result of the init functions when the device lacks the extension of the
+ * element type, outside the OpenCL error codes and the -1 of a missing kernel source
+ */
+#define GEMM_TYPE_UNSUPPORTED 2
+
+/**
+ * Write the program build options of the type for the device into options.
+ *
+ * Returns 0 on success, -1 if the device does not support the type
+ */
+int gemm_type_build_options(GemmType type, cl_device_id device_id, char* options, size_t size);
+
+/**
+ * Fill n elements of the given type with random integers in [min, max].
+ */
+void gemm_type_fill_random(GemmType type, void* buffer, size_t n, int min, int max);
+
+/**
+ * Fill n elements of the given type with random integers i = 0 .. n - 1 of a
+ * Philox seed in [min, max], the values random_fill writes on the device.
+ */
+void gemm_type_fill_seeded(GemmType type, void* buffer, size_t n, cl_ulong seed, int min, int max);
+
+/**
+ * Read element i of an A/B buffer (is_output = 0) or a C buffer (is_output = 1) as double.
+ */
+double gemm_type_get(GemmType type, const void* buffer, size_t i, int is_output);
+
+/**
+ * Write element i of an A/B buffer (is_output = 0) or a C buffer (is_output = 1) from double.
+ */
+void gemm_type_set(GemmType type, void* buffer, size_t i, double value, int is_output);
+
+/**
+ * Convert between IEEE single and half precision.
+ */
+cl_half float_to_half(float value);
+float half_to_float(cl_half value);
+
+#endif
@@ -1,14 +1,67 @@
 #ifndef KERNEL_LOADER_H
 #define KERNEL_LOADER_H
 
+#define CL_TARGET_OPENCL_VERSION 220
+#include <CL/cl.h>
+
+/**
+ * Kernel source compiled into the executable.
+ *
+ * path: Path of the source file relative to the tool, such as "kernels/stream.cl"
+ */
+typedef struct {
+    const char* path;
+    const char* source;
+} EmbeddedKernel;
+
+/**
+ * Every .cl file of kernels/, generated by tools/embed_kernels.c at build time.
+ * The last entry has a NULL path.
+ */
+extern const EmbeddedKernel embedded_kernels[];
+
 /**
- * Load the OpenCL kernel source code from a file.
+ * Load the OpenCL kernel source code of a file. The embedded copy is used
+ * unless the KERNEL_SOURCE_DIR environment variable is set, in which case
+ * the file is read from that directory, for example "." to try kernel
+ * changes without rebuilding. Files that are not embedded are read from disk.
  * 
  * path: Path of the source file
  * error_code: 0 on successful file loading
  * 
  * Returns by a dynamically allocated string
  */
-char* load_kernel_source(const char* const path, int* error_code);
+char* load_kernel_source(const char* path, int* error_code);
+
+/**
+ * Build an OpenCL program from source code, through the binary cache.
+ * The device binary of every program built is kept in
+ * kernel_<hash>.bin of the directory given by the KERNEL_CACHE_DIR
+ * environment variable, or of the working directory, the hash covering the
+ * device, the driver version, the options and the source. Later builds of
+ * the same source load the binary instead of compiling it.
+ * The build log is printed when the build fails.
+ *
+ * source: Source code
+ * options: Build options
+ * error_code: CL_SUCCESS on success
+ *
+ * Returns the program, NULL on error
+ */
+cl_program build_program_source(cl_context context, cl_device_id device_id, const char* source,
+    const char* options, cl_int* error_code);
+
+/**
+ * Load and build an OpenCL program from a source file, through the binary cache.
+ * The build log is printed when the build fails.
+ *
+ * path: Path of the source file
+ * options: Build options
+ * error_code: CL_SUCCESS on success, -1 if the source could not be loaded
+ *
+ * Returns the program, NULL on error
+ */
+cl_program build_program(cl_context context, cl_device_id device_id, const char* path,
+    const char* options, cl_int* error_code);
 
 #endif
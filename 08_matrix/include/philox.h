@@ -0,0 +1,69 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#define CL_TARGET_OPENCL_VERSION 220
+#include <CL/cl.h>
+
+#include <stddef.h>
+
+/**
+ * Counter-based random numbers with Philox4x32-10: random number i of a seed
+ * only depends on (seed, i), so device and host produce the same sequence
+ * in any order and with any number of work-items.
+ */
+
+/**
+ * Device kernel filling buffers in place, see kernels/random.cl.
+ */
+typedef struct {
+    cl_program program;
+    cl_kernel kernel;
+} RandomFill;
+
+/**
+ * One Philox4x32-10 block: 4 random words of a 128-bit counter under a 64-bit key.
+ */
+void philox4x32(const cl_uint counter[4], const cl_uint key[2], cl_uint result[4]);
+
+/**
+ * Random word i of the sequence of a seed.
+ */
+cl_uint philox_uint(cl_ulong seed, cl_ulong index);
+
+/**
+ * Random integer i of the sequence of a seed in [min, max], as written by random_fill.
+ */
+int philox_int(cl_ulong seed, cl_ulong index, int min, int max);
+
+/**
+ * Fill n ints with random integers i = 0 .. n - 1 of a seed in [min, max] on the host.
+ */
+void philox_fill_int(int* buffer, size_t n, cl_ulong seed, int min, int max);
+
+/**
+ * Build the fill kernel.
+ *
+ * options: Build options selecting the element type (ELEM_T, ELEM_HALF, USE_FP64)
+ *
+ * Returns CL_SUCCESS, -1 if the source could not be loaded or an OpenCL error code
+ */
+cl_int random_fill_init(RandomFill* random, cl_context context, cl_device_id device_id, const char* options);
+
+/**
+ * Release the program and kernel.
+ */
+void random_fill_release(RandomFill* random);
+
+/**
+ * Enqueue filling lines x line_length elements of a buffer with random
+ * integers in [min, max] converted to the element type. Element j of line i
+ * is at offset + i * ld + j and gets random number i * line_length + j.
+ *
+ * event: Event of the kernel launch, may be NULL
+ *
+ * Returns CL_SUCCESS or an OpenCL error code
+ */
+cl_int random_fill(RandomFill* random, cl_command_queue command_queue, cl_mem buffer, int offset,
+    int lines, int line_length, int ld, cl_ulong seed, int min, int max, cl_event* event);
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include "gemm_types.h"
+
+/**
+ * Sparse matrix in compressed sparse row (CSR) format on the host.
+ * Row i holds the entries row_ptr[i] .. row_ptr[i + 1] - 1, sorted by column.
+ *
+ * row_ptr: rows + 1 entry offsets
+ * col_idx: Column index of every entry
+ * values: Value of every entry, elements of the A/B type of the GemmType
+ */
+typedef struct {
+    int rows;
+    int cols;
+    int nnz;
+    int* row_ptr;
+    int* col_idx;
+    void* values;
+} CsrMatrix;
+
+/**
+ * SpMV kernel variants: one work-item per row, a group of lanes per row or
+ * a whole work-group per row.
+ */
+typedef enum {
+    SPMV_SCALAR,
+    SPMV_VECTOR,
+    SPMV_GROUP
+} SpmvVariant;
+
+/**
+ * Row-length statistics of a CSR matrix and the SpMV variant chosen for them.
+ *
+ * lanes: Work-items per row of the vector variant (power of two)
+ */
+typedef struct {
+    double mean_row_length;
+    int max_row_length;
+    SpmvVariant variant;
+    int lanes;
+} CsrRowStats;
+
+/**
+ * Sparse kernels built for one device and element type.
+ *
+ * group_size: Work-group size of the vector and group variants (power of two)
+ */
+typedef struct {
+    cl_context context;
+    cl_device_id device_id;
+    cl_command_queue command_queue;
+    GemmType type;
+    cl_program program;
+    cl_kernel scalar_kernel;
+    cl_kernel vector_kernel;
+    cl_kernel group_kernel;
+    cl_kernel spmm_kernel;
+    int group_size;
+} SparseContext;
+
+/**
+ * CSR matrix in device memory.
+ */
+typedef struct {
+    cl_mem row_ptr;
+    cl_mem col_idx;
+    cl_mem values;
+    int rows;
+    int cols;
+    int nnz;
+    CsrRowStats stats;
+} CsrDeviceMatrix;
+
+/**
+ * Load a matrix from a Matrix Market coordinate file (real, integer or
+ * pattern; general, symmetric or skew-symmetric). Values are converted to
+ * the element type, pattern entries are 1.
+ *
+ * Returns 0 on success, -1 if the file cannot be read or is not supported
+ */
+int csr_load_matrix_market(const char* path, GemmType type, CsrMatrix* matrix);
+
+/**
+ * Create a random rows x cols matrix with about density * cols entries per
+ * row. Row lengths vary exponentially around the mean, values are random
+ * integers in [min, max].
+ */
+void csr_random(GemmType type, int rows, int cols, double density, int min, int max, CsrMatrix* matrix);
+
+/**
+ * Free the arrays of a host CSR matrix.
+ */
+void csr_release(CsrMatrix* matrix);
+
+/**
+ * Compute the row-length statistics and choose the SpMV variant: scalar for
+ * short rows, vector with lanes close to the mean row length for moderate
+ * rows and a work-group per row for long rows.
+ */
+CsrRowStats csr_row_stats(const CsrMatrix* matrix);
+
+/**
+ * Get the name of a SpMV variant.
+ */
+const char* spmv_variant_name(SpmvVariant variant);
+
+/**
+ * y = A * x on the host, x has A->cols elements, y has A->rows output elements.
+ */
+void csr_spmv_cpu(GemmType type, const CsrMatrix* A, const void* x, void* y);
+
+/**
+ * C = A * B on the host for dense row-major A->cols x N matrix B and A->rows x N matrix C.
+ */
+void csr_spmm_cpu(GemmType type, const CsrMatrix* A, int N, const void* B, void* C);
+
+/**
+ * Build the sparse kernels for the type.
+ *
+ * Returns CL_SUCCESS, GEMM_TYPE_UNSUPPORTED if the device does not support the
+ * type, -1 if the kernel source could not be loaded or an OpenCL error code
+ */
+cl_int sparse_init(SparseContext* sparse, cl_context context, cl_device_id device_id,
+    cl_command_queue command_queue, GemmType type);
+
+/**
+ * Release the program and kernels.
+ */
+void sparse_release(SparseContext* sparse);
+
+/**
+ * Upload a host CSR matrix and choose its SpMV variant.
+ *
+ * Returns CL_SUCCESS or an OpenCL error code
+ */
+cl_int csr_device_create(SparseContext* sparse, const CsrMatrix* host, CsrDeviceMatrix* matrix);
+
+/**
+ * Release the buffers of a device CSR matrix.
+ */
+void csr_device_release(CsrDeviceMatrix* matrix);
+
+/**
+ * y = A * x with the given variant, A->stats.variant chooses by row lengths.
+ *
+ * event: Event of the kernel, may be NULL
+ *
+ * Returns CL_SUCCESS or an OpenCL error code
+ */
+cl_int sparse_spmv(SparseContext* sparse, const CsrDeviceMatrix* A, SpmvVariant variant,
+    cl_mem x, cl_mem y, cl_event* event);
+
+/**
+ * C = A * B for dense row-major matrices B (A->cols x N, leading dimension
+ * ldb) and C (A->rows x N, leading dimension ldc).
+ *
+ * event: Event of the kernel, may be NULL
+ *
+ * Returns CL_SUCCESS or an OpenCL error code
+ */
+cl_int sparse_spmm(SparseContext* sparse, const CsrDeviceMatrix* A, int N, cl_mem B, int ldb,
+    cl_mem C, int ldc, cl_event* event);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef STRASSEN_H
+#define STRASSEN_H
+
+#include "buffer_pool.h"
+#include "gemm.h"
+
+/**
+ * Enqueue C = A * B with the Strassen-Winograd algorithm (7 half-size
+ * products and 15 additions per level) on top of gemm_run.
+ *
+ * The recursion stops, calling the classical kernels, when a dimension is at
+ * most cutoff or odd. Temporaries come from the pool and are handed back when
+ * a level is done, so the pool can serve further calls.
+ * A and C must have the same element size (every type but int8).
+ *
+ * Returns CL_SUCCESS, CL_INVALID_VALUE for mismatching shapes or types, or an OpenCL error code
+ */
+cl_int gemm_strassen(GemmContext* gemm, BufferPool* pool, const GemmMatrix* A, const GemmMatrix* B,
+    GemmMatrix* C, int cutoff);
+
+#endif
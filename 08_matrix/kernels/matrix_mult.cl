@@ -1,9 +1,291 @@
-__kernel void matrix_mult_kernel(__global int* A, __global int* B, __global int* C, int N) {
+/**
+ * GEMM kernel template. The element and accumulator types are chosen at
+ * build time:
+ *
+ * ELEM_T: element type of A and B (int, float, double, half, char)
+ * ACC_T: accumulator type (int, float, double)
+ * OUT_T: element type of C, defaults to ELEM_T
+ * ELEM_HALF: A, B and C are stored as half and accessed with vload_half
+ * USE_FP64: enable cl_khr_fp64 for double matrices
+ * USE_INT_DOT: use cl_khr_integer_dot_product for char inputs
+ * RB: register block size of matrix_mult_reg_kernel
+ * VW: vector width of the B loads and C stores of matrix_mult_reg_kernel (4 or 8, divides RB)
+ * TS: tile size of matrix_mult_batched_kernel
+ */
+#ifdef USE_FP64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+#ifndef ELEM_T
+#define ELEM_T int
+#endif
+#ifndef ACC_T
+#define ACC_T int
+#endif
+#ifndef OUT_T
+#define OUT_T ELEM_T
+#endif
+#ifndef RB
+#define RB 4
+#endif
+#ifndef VW
+#define VW 4
+#endif
+#ifndef TS
+#define TS 8
+#endif
+
+#define CAT_(a, b) a##b
+#define CAT(a, b) CAT_(a, b)
+#define ACC4_T CAT(ACC_T, 4)
+#define ACCV_T CAT(ACC_T, VW)
+
+#ifdef ELEM_HALF
+#define LOAD(p, i) vload_half((i), (p))
+#define LOAD4(p) vload_half4(0, (p))
+#define STORE(v, p, i) vstore_half((v), (i), (p))
+#define LOADV(p) CAT(vload_half, VW)(0, (p))
+#define STOREV(v, p) CAT(vstore_half, VW)((v), 0, (p))
+#else
+#define LOAD(p, i) ((ACC_T)(p)[i])
+#define LOAD4(p) CAT(convert_, ACC4_T)(vload4(0, (p)))
+#define STORE(v, p, i) ((p)[i] = (OUT_T)(v))
+#define LOADV(p) CAT(convert_, ACCV_T)(CAT(vload, VW)(0, (p)))
+#define STOREV(v, p) CAT(vstore, VW)(CAT(convert_, CAT(OUT_T, VW))(v), 0, (p))
+#endif
+
+/**
+ * C = alpha * op(A) * op(B) + beta * C, where op(A) is M x K and op(B) is K x N.
+ * Element (i, j) of a matrix X is X[x_offset + i * x_row_stride + j * x_col_stride],
+ * so row-major, column-major and transposed operands only differ in strides.
+ */
+__kernel void matrix_mult_kernel(
+    int M, int N, int K, ACC_T alpha,
+    __global const ELEM_T* A, int a_offset, int a_row_stride, int a_col_stride,
+    __global const ELEM_T* B, int b_offset, int b_row_stride, int b_col_stride,
+    ACC_T beta,
+    __global OUT_T* C, int c_offset, int c_row_stride, int c_col_stride
+) {
     int row = get_global_id(0);
     int col = get_global_id(1);
-    int sum = 0;
-    for (int k = 0; k < N; ++k) {
-        sum += A[row * N + k] * B[k * N + col];
+    if (row >= M || col >= N) {
+        return;
     }
-    C[row * N + col] = sum;
-}
\ No newline at end of file
+    ACC_T sum = 0;
+    for (int k = 0; k < K; ++k) {
+        sum += LOAD(A, a_offset + row * a_row_stride + k * a_col_stride)
+            * LOAD(B, b_offset + k * b_row_stride + col * b_col_stride);
+    }
+    int c_index = c_offset + row * c_row_stride + col * c_col_stride;
+    ACC_T result = alpha * sum;
+    if (beta != 0) {
+        result += beta * LOAD(C, c_index);
+    }
+    STORE(result, C, c_index);
+}
+
+/**
+ * Strided-batched matrix_mult_kernel: the third NDRange dimension is the batch
+ * index and matrix b of X starts at x_offset + b * x_batch_stride. Each TS x TS
+ * work-group stages tiles of A and B in local memory, which suits the small
+ * matrices batches are made of.
+ */
+__kernel void matrix_mult_batched_kernel(
+    int M, int N, int K, ACC_T alpha,
+    __global const ELEM_T* A, int a_offset, int a_row_stride, int a_col_stride, int a_batch_stride,
+    __global const ELEM_T* B, int b_offset, int b_row_stride, int b_col_stride, int b_batch_stride,
+    ACC_T beta,
+    __global OUT_T* C, int c_offset, int c_row_stride, int c_col_stride, int c_batch_stride
+) {
+    __local ACC_T a_tile[TS][TS];
+    __local ACC_T b_tile[TS][TS + 1];
+    int local_row = get_local_id(0);
+    int local_col = get_local_id(1);
+    int row = get_global_id(0);
+    int col = get_global_id(1);
+    int batch = get_global_id(2);
+
+    a_offset += batch * a_batch_stride;
+    b_offset += batch * b_batch_stride;
+    c_offset += batch * c_batch_stride;
+
+    ACC_T sum = 0;
+    for (int k0 = 0; k0 < K; k0 += TS) {
+        int a_k = k0 + local_col;
+        int b_k = k0 + local_row;
+        a_tile[local_row][local_col] = (row < M && a_k < K)
+            ? LOAD(A, a_offset + row * a_row_stride + a_k * a_col_stride) : 0;
+        b_tile[local_row][local_col] = (b_k < K && col < N)
+            ? LOAD(B, b_offset + b_k * b_row_stride + col * b_col_stride) : 0;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        for (int k = 0; k < TS; ++k) {
+            sum += a_tile[local_row][k] * b_tile[k][local_col];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (row < M && col < N) {
+        int c_index = c_offset + row * c_row_stride + col * c_col_stride;
+        ACC_T result = alpha * sum;
+        if (beta != 0) {
+            result += beta * LOAD(C, c_index);
+        }
+        STORE(result, C, c_index);
+    }
+}
+
+/**
+ * Z = alpha * X + beta * Y for M x N matrices of the C element type, with the
+ * same strided addressing as matrix_mult_kernel. Z may be X or Y.
+ */
+__kernel void matrix_add_kernel(
+    int M, int N, ACC_T alpha,
+    __global const OUT_T* X, int x_offset, int x_row_stride, int x_col_stride,
+    ACC_T beta,
+    __global const OUT_T* Y, int y_offset, int y_row_stride, int y_col_stride,
+    __global OUT_T* Z, int z_offset, int z_row_stride, int z_col_stride
+) {
+    int row = get_global_id(0);
+    int col = get_global_id(1);
+    if (row >= M || col >= N) {
+        return;
+    }
+    ACC_T result = alpha * LOAD(X, x_offset + row * x_row_stride + col * x_col_stride)
+        + beta * LOAD(Y, y_offset + row * y_row_stride + col * y_col_stride);
+    STORE(result, Z, z_offset + row * z_row_stride + col * z_col_stride);
+}
+
+#ifdef USE_INT_DOT
+
+/**
+ * Register-blocked variant for char inputs: four products along k are
+ * accumulated by one integer dot product instruction.
+ */
+__kernel void matrix_mult_reg_kernel(
+    int M, int N, int K, int alpha,
+    __global const char* A, int a_offset, int lda,
+    __global const char* B, int b_offset, int ldb,
+    int beta,
+    __global int* C, int c_offset, int ldc
+) {
+    int row0 = get_global_id(0) * RB;
+    int col0 = get_global_id(1) * RB;
+    int acc[RB][RB];
+    char4 a[RB];
+
+    if (row0 >= M || col0 >= N) {
+        return;
+    }
+
+    A += a_offset;
+    B += b_offset;
+    C += c_offset;
+
+    for (int i = 0; i < RB; ++i) {
+        for (int j = 0; j < RB; ++j) {
+            acc[i][j] = 0;
+        }
+    }
+
+    for (int k = 0; k < K; k += 4) {
+        for (int i = 0; i < RB; ++i) {
+            a[i] = vload4(0, A + (row0 + i) * lda + k);
+        }
+        for (int j = 0; j < RB; j += 4) {
+            char4 r0 = vload4(0, B + (k + 0) * ldb + col0 + j);
+            char4 r1 = vload4(0, B + (k + 1) * ldb + col0 + j);
+            char4 r2 = vload4(0, B + (k + 2) * ldb + col0 + j);
+            char4 r3 = vload4(0, B + (k + 3) * ldb + col0 + j);
+            char4 b0 = (char4)(r0.x, r1.x, r2.x, r3.x);
+            char4 b1 = (char4)(r0.y, r1.y, r2.y, r3.y);
+            char4 b2 = (char4)(r0.z, r1.z, r2.z, r3.z);
+            char4 b3 = (char4)(r0.w, r1.w, r2.w, r3.w);
+            for (int i = 0; i < RB; ++i) {
+                acc[i][j + 0] += dot(a[i], b0);
+                acc[i][j + 1] += dot(a[i], b1);
+                acc[i][j + 2] += dot(a[i], b2);
+                acc[i][j + 3] += dot(a[i], b3);
+            }
+        }
+    }
+
+    for (int i = 0; i < RB; ++i) {
+        for (int j = 0; j < RB; j += 4) {
+            __global int* c = C + (row0 + i) * ldc + col0 + j;
+            int4 result = alpha * (int4)(acc[i][j], acc[i][j + 1], acc[i][j + 2], acc[i][j + 3]);
+            if (beta != 0) {
+                result += beta * vload4(0, c);
+            }
+            vstore4(result, 0, c);
+        }
+    }
+}
+
+#else
+
+/**
+ * Register-blocked variant of matrix_mult_kernel for row-major, untransposed
+ * operands: every work-item computes an RB x RB block of C in private memory,
+ * reading A with 4-wide and B with VW-wide vector loads.
+ * M and N must be multiples of RB (4 or 8, set with -D RB=<n>), K a multiple of 4.
+ */
+__kernel void matrix_mult_reg_kernel(
+    int M, int N, int K, ACC_T alpha,
+    __global const ELEM_T* A, int a_offset, int lda,
+    __global const ELEM_T* B, int b_offset, int ldb,
+    ACC_T beta,
+    __global OUT_T* C, int c_offset, int ldc
+) {
+    int row0 = get_global_id(0) * RB;
+    int col0 = get_global_id(1) * RB;
+    ACCV_T acc[RB][RB / VW];
+    ACC_T a[RB][4];
+
+    if (row0 >= M || col0 >= N) {
+        return;
+    }
+
+    A += a_offset;
+    B += b_offset;
+    C += c_offset;
+
+    for (int i = 0; i < RB; ++i) {
+        for (int j = 0; j < RB / VW; ++j) {
+            acc[i][j] = (ACCV_T)(0);
+        }
+    }
+
+    for (int k = 0; k < K; k += 4) {
+        for (int i = 0; i < RB; ++i) {
+            ACC4_T av = LOAD4(A + (row0 + i) * lda + k);
+            a[i][0] = av.x;
+            a[i][1] = av.y;
+            a[i][2] = av.z;
+            a[i][3] = av.w;
+        }
+        for (int kk = 0; kk < 4; ++kk) {
+            ACCV_T b[RB / VW];
+            for (int j = 0; j < RB / VW; ++j) {
+                b[j] = LOADV(B + (k + kk) * ldb + col0 + VW * j);
+            }
+            for (int i = 0; i < RB; ++i) {
+                for (int j = 0; j < RB / VW; ++j) {
+                    acc[i][j] += a[i][kk] * b[j];
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < RB; ++i) {
+        for (int j = 0; j < RB / VW; ++j) {
+            __global OUT_T* c = C + (row0 + i) * ldc + col0 + VW * j;
+            ACCV_T result = alpha * acc[i][j];
+            if (beta != 0) {
+                result += beta * LOADV(c);
+            }
+            STOREV(result, c);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,172 @@
+/**
+ * CSR sparse kernels. The element types are chosen at build time with the
+ * same options as kernels/matrix_mult.cl:
+ *
+ * ELEM_T: element type of the sparse values and the dense operand
+ * ACC_T: accumulator type
+ * OUT_T: element type of the result, defaults to ELEM_T
+ * ELEM_HALF: values and vectors are stored as half and accessed with vload_half
+ * USE_FP64: enable cl_khr_fp64 for double matrices
+ *
+ * Row i of the sparse matrix holds the entries row_ptr[i] .. row_ptr[i + 1] - 1
+ * with their column indices in col_idx and their values in values.
+ */
+#ifdef USE_FP64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+#ifndef ELEM_T
+#define ELEM_T int
+#endif
+#ifndef ACC_T
+#define ACC_T int
+#endif
+#ifndef OUT_T
+#define OUT_T ELEM_T
+#endif
+
+#ifdef ELEM_HALF
+#define LOAD(p, i) vload_half((i), (p))
+#define STORE(v, p, i) vstore_half((v), (i), (p))
+#else
+#define LOAD(p, i) ((ACC_T)(p)[i])
+#define STORE(v, p, i) ((p)[i] = (OUT_T)(v))
+#endif
+
+/**
+ * Sum the partial results of the work-items [first, first + count) in local
+ * memory, count is a power of two. The sum is left in partial[first].
+ */
+void reduce_partial(__local ACC_T* partial, int lane, int first, int count)
+{
+    int s;
+
+    for (s = count / 2; s > 0; s /= 2) {
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if (lane < s) {
+            partial[first + lane] += partial[first + lane + s];
+        }
+    }
+}
+
+/**
+ * y = A * x with one work-item per row. Suited to short rows.
+ */
+__kernel void csr_spmv_scalar_kernel(
+    const int rows,
+    __global const int* row_ptr,
+    __global const int* col_idx,
+    __global const ELEM_T* values,
+    __global const ELEM_T* x,
+    __global OUT_T* y)
+{
+    int row = get_global_id(0);
+    ACC_T sum = 0;
+    int k;
+
+    if (row >= rows) {
+        return;
+    }
+    for (k = row_ptr[row]; k < row_ptr[row + 1]; ++k) {
+        sum += LOAD(values, k) * LOAD(x, col_idx[k]);
+    }
+    STORE(sum, y, row);
+}
+
+/**
+ * y = A * x with lanes work-items per row, lanes is a power of two dividing
+ * the work-group size. Consecutive lanes read consecutive entries of the
+ * row, so the loads are coalesced for rows of moderate length.
+ *
+ * partial: Local memory of one accumulator per work-item
+ */
+__kernel void csr_spmv_vector_kernel(
+    const int rows,
+    const int lanes,
+    __global const int* row_ptr,
+    __global const int* col_idx,
+    __global const ELEM_T* values,
+    __global const ELEM_T* x,
+    __global OUT_T* y,
+    __local ACC_T* partial)
+{
+    int local_id = get_local_id(0);
+    int lane = local_id % lanes;
+    int first = local_id - lane;
+    int row = get_global_id(0) / lanes;
+    ACC_T sum = 0;
+    int k;
+
+    // Rows past the end still take part in the barriers of the reduction
+    if (row < rows) {
+        for (k = row_ptr[row] + lane; k < row_ptr[row + 1]; k += lanes) {
+            sum += LOAD(values, k) * LOAD(x, col_idx[k]);
+        }
+    }
+    partial[local_id] = sum;
+    reduce_partial(partial, lane, first, lanes);
+    if (row < rows && lane == 0) {
+        STORE(partial[first], y, row);
+    }
+}
+
+/**
+ * y = A * x with one work-group per row, the work-group size is a power of
+ * two. Suited to long rows, which would serialize a single work-item.
+ *
+ * partial: Local memory of one accumulator per work-item
+ */
+__kernel void csr_spmv_group_kernel(
+    const int rows,
+    __global const int* row_ptr,
+    __global const int* col_idx,
+    __global const ELEM_T* values,
+    __global const ELEM_T* x,
+    __global OUT_T* y,
+    __local ACC_T* partial)
+{
+    int local_id = get_local_id(0);
+    int size = get_local_size(0);
+    int row = get_group_id(0);
+    ACC_T sum = 0;
+    int k;
+
+    for (k = row_ptr[row] + local_id; k < row_ptr[row + 1]; k += size) {
+        sum += LOAD(values, k) * LOAD(x, col_idx[k]);
+    }
+    partial[local_id] = sum;
+    reduce_partial(partial, local_id, 0, size);
+    if (local_id == 0) {
+        STORE(partial[0], y, row);
+    }
+}
+
+/**
+ * C = A * B for a sparse rows x K matrix A and dense row-major K x N matrix B
+ * and C. Work-item (j, i) computes C[i][j]; neighbouring work-items share the
+ * sparse row and read neighbouring elements of the rows of B.
+ */
+__kernel void csr_spmm_kernel(
+    const int rows,
+    const int N,
+    __global const int* row_ptr,
+    __global const int* col_idx,
+    __global const ELEM_T* values,
+    __global const ELEM_T* B,
+    const int ldb,
+    __global OUT_T* C,
+    const int ldc)
+{
+    int col = get_global_id(0);
+    int row = get_global_id(1);
+    ACC_T sum = 0;
+    int k;
+
+    if (row >= rows || col >= N) {
+        return;
+    }
+    for (k = row_ptr[row]; k < row_ptr[row + 1]; ++k) {
+        sum += LOAD(values, k) * LOAD(B, col_idx[k] * ldb + col);
+    }
+    STORE(sum, C, row * ldc + col);
+}
@@ -0,0 +1,45 @@
+/**
+ * Matrix transpose through local memory. Elements are moved as unsigned
+ * integers of their size, so one kernel per size serves every element type.
+ *
+ * TILE: tile size, the work-group is TILE x TILE
+ */
+#ifndef TILE
+#define TILE 16
+#endif
+
+/**
+ * dst = src^T for a rows x cols row-major src and cols x rows row-major dst,
+ * with leading dimensions src_ld and dst_ld.
+ *
+ * Work-item (x, y) reads src[y][x], so a work-group reads whole tile rows of
+ * src and, after the exchange through local memory, writes whole tile rows
+ * of dst. The tile is padded by one column so the column-wise reads of the
+ * exchange fall into different banks.
+ */
+#define DEFINE_TRANSPOSE(T) \
+__kernel void transpose_##T##_kernel( \
+    int rows, int cols, \
+    __global const T* src, int src_offset, int src_ld, \
+    __global T* dst, int dst_offset, int dst_ld \
+) { \
+    __local T tile[TILE][TILE + 1]; \
+    int local_x = get_local_id(0); \
+    int local_y = get_local_id(1); \
+    int x = get_group_id(0) * TILE + local_x; \
+    int y = get_group_id(1) * TILE + local_y; \
+    if (x < cols && y < rows) { \
+        tile[local_y][local_x] = src[src_offset + y * src_ld + x]; \
+    } \
+    barrier(CLK_LOCAL_MEM_FENCE); \
+    x = get_group_id(1) * TILE + local_x; \
+    y = get_group_id(0) * TILE + local_y; \
+    if (x < rows && y < cols) { \
+        dst[dst_offset + y * dst_ld + x] = tile[local_x][local_y]; \
+    } \
+}
+
+DEFINE_TRANSPOSE(uchar)
+DEFINE_TRANSPOSE(ushort)
+DEFINE_TRANSPOSE(uint)
+DEFINE_TRANSPOSE(ulong)
@@ -1,196 +1,536 @@
-#include "kernel_loader.h"
+#include "autotune.h"
+#include "benchmark.h"
+#include "cpu_gemm.h"
+#include "dispatch.h"
+#include "gemm.h"
+#include "gemm_ooc.h"
+#include "sparse.h"
 
 #define CL_TARGET_OPENCL_VERSION 220
 #include <CL/cl.h>
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #define MIN 1
 #define MAX 100
 
-int main(void)
+// Half products of values up to MAX overflow past K of about 6, so half matrices use a bounded range
+#define HALF_MIN -2
+#define HALF_MAX 2
+#define FILL_MIN(type) ((type) == GEMM_HALF ? HALF_MIN : MIN)
+#define FILL_MAX(type) ((type) == GEMM_HALF ? HALF_MAX : MAX)
+
+// Philox seeds of the input matrices
+#define SEED_A 1
+#define SEED_B 2
+
+// Larger matrices are not printed
+#define MAX_PRINTED_SIZE 16
+
+// Largest product of the dispatch mode
+#define DISPATCH_MAX_SIZE 2048
+
+// Fraction of nonzeros of the random sparse matrices
+#define SPARSE_DENSITY 0.005
+
+/**
+ * Print a densely packed row-major matrix.
+ */
+static void print_matrix(GemmType type, const void* buffer, int rows, int cols, int is_output)
 {
-    // Initialize
     int i;
-    cl_int err;
-    int error_code;
-    int MATRIX_SIZE = 4;
 
-    // Get platform
-    cl_uint n_platforms;
+    if (rows > MAX_PRINTED_SIZE || cols > MAX_PRINTED_SIZE) {
+        return;
+    }
+    for (i = 0; i < rows * cols; ++i) {
+        printf("%g ", gemm_type_get(type, buffer, i, is_output));
+        if((i+1) % cols == 0){
+            printf("\n");
+        }
+    }
+    printf("\n");
+}
+
+/**
+ * C_b = A_b * B_b on the host for every densely packed, row-major product of a batch.
+ */
+static void cpu_gemm_batch(GemmType type, int M, int N, int K, const void* A, const void* B, void* C, int batch_count)
+{
+    const GemmTypeInfo* info = gemm_type_info(type);
+    int b;
+
+    for (b = 0; b < batch_count; ++b) {
+        cpu_gemm(type, M, N, K, 1.0,
+            (const char*)A + (size_t)b * M * K * info->elem_size, K, 1,
+            (const char*)B + (size_t)b * K * N * info->elem_size, N, 1,
+            0.0, (char*)C + (size_t)b * M * N * info->out_size, N, 1, 0);
+    }
+}
+
+/**
+ * Open the first GPU with a profiling command queue.
+ *
+ * Returns 0 on success, -1 if there is no OpenCL GPU
+ */
+static int open_gpu(cl_device_id* device_id, cl_context* context, cl_command_queue* command_queue)
+{
     cl_platform_id platform_id;
-    err = clGetPlatformIDs(1, &platform_id, &n_platforms);
-    if (err != CL_SUCCESS) {
-        printf("[ERROR] Error calling clGetPlatformIDs. Error code: %d\n", err);
-        return 0;
+
+    *context = NULL;
+    *command_queue = NULL;
+    if (clGetPlatformIDs(1, &platform_id, NULL) != CL_SUCCESS
+        || clGetDeviceIDs(platform_id, CL_DEVICE_TYPE_GPU, 1, device_id, NULL) != CL_SUCCESS) {
+        return -1;
     }
+    *context = clCreateContext(NULL, 1, device_id, NULL, NULL, NULL);
+    *command_queue = clCreateCommandQueue(*context, *device_id, CL_QUEUE_PROFILING_ENABLE, NULL);
+    return 0;
+}
+
+static void close_gpu(cl_device_id device_id, cl_context context, cl_command_queue command_queue)
+{
+    if (context != NULL) {
+        clReleaseCommandQueue(command_queue);
+        clReleaseContext(context);
+        clReleaseDevice(device_id);
+    }
+}
+
+/**
+ * Benchmark modes, writing their results to a CSV file:
+ * bench sweeps sizes and kernel variants on the first GPU (only the CPU
+ * implementation when there is none), strassen compares Strassen-Winograd
+ * with the classical kernels and transpose compares the transpose kernel
+ * with a buffer copy.
+ */
+static int run_benchmark(const char* mode, GemmType type, const char* csv_path, int strassen_cutoff)
+{
+    int result;
 
-    // Get device
     cl_device_id device_id;
-    cl_uint n_devices;
-    err = clGetDeviceIDs(
-        platform_id,
-        CL_DEVICE_TYPE_GPU,
-        1,
-        &device_id,
-        &n_devices
-    );
-    if (err != CL_SUCCESS) {
-        printf("[ERROR] Error calling clGetDeviceIDs. Error code: %d\n", err);
+    cl_context context;
+    cl_command_queue command_queue;
+
+    if (open_gpu(&device_id, &context, &command_queue) != 0) {
+        printf("No OpenCL GPU found, benchmarking the CPU only\n");
+    }
+
+    if (strcmp(mode, "bench") != 0 && context == NULL) {
+        printf("The %s benchmark runs on the device only\n", mode);
         return 0;
     }
+    if (strcmp(mode, "strassen") == 0) {
+        result = gemm_strassen_benchmark(context, device_id, command_queue, type, strassen_cutoff, csv_path);
+    } else if (strcmp(mode, "transpose") == 0) {
+        result = gemm_transpose_benchmark(context, device_id, command_queue, type, csv_path);
+    } else {
+        result = gemm_benchmark(context, device_id, command_queue, type, csv_path);
+    }
+    close_gpu(device_id, context, command_queue);
+    if (result != 0) {
+        printf("Error opening file!\n");
+        return 1;
+    }
+    printf("Results written to %s\n", csv_path);
+    return 0;
+}
 
-    // Create OpenCL context
-    cl_context context = clCreateContext(NULL, n_devices, &device_id, NULL, NULL, NULL);
+/**
+ * Sparse mode: SpMV and SpMM of a Matrix Market file, or of a random N x N
+ * matrix when source is a number.
+ */
+static int run_sparse(const char* source, GemmType type, int columns)
+{
+    cl_device_id device_id;
+    cl_context context;
+    cl_command_queue command_queue;
+    CsrMatrix matrix;
+    int n = atoi(source);
 
-    // Build the program
-    const char* kernel_code = load_kernel_source("kernels/matrix_mult.cl", &error_code);
-    if (error_code != 0) {
-        printf("Source code loading error!\n");
+    if (n > 0) {
+        csr_random(type, n, n, SPARSE_DENSITY, FILL_MIN(type), FILL_MAX(type), &matrix);
+    } else if (csr_load_matrix_market(source, type, &matrix) != 0) {
+        printf("Cannot read the Matrix Market file: %s\n", source);
         return 0;
     }
-    cl_program program = clCreateProgramWithSource(context, 1, &kernel_code, NULL, NULL);
-    const char options[] = "";
-    err = clBuildProgram(
-        program,
-        1,
-        &device_id,
-        options,
-        NULL,
-        NULL
-    );
-    if (err != CL_SUCCESS) {
-        printf("Build error! Code: %d\n", err);
-        size_t real_size;
-        err = clGetProgramBuildInfo(
-            program,
-            device_id,
-            CL_PROGRAM_BUILD_LOG,
-            0,
-            NULL,
-            &real_size
-        );
-        char* build_log = (char*)malloc(sizeof(char) * (real_size + 1));
-        err = clGetProgramBuildInfo(
-            program,
-            device_id,
-            CL_PROGRAM_BUILD_LOG,
-            real_size + 1,
-            build_log,
-            &real_size
-        );
-        printf("Build log: %s\n", build_log);
-        free(build_log);
+    if (open_gpu(&device_id, &context, &command_queue) != 0) {
+        printf("No OpenCL GPU found, running on the CPU only\n");
+    }
+    sparse_benchmark(context, device_id, command_queue, type, &matrix, columns);
+    close_gpu(device_id, context, command_queue);
+    csr_release(&matrix);
+    return 0;
+}
+
+/**
+ * Dispatch mode: load or calibrate the CPU/device crossover of the first GPU
+ * and route products of doubling size to the faster backend.
+ */
+static int run_dispatch(GemmType type, int recalibrate)
+{
+    const GemmTypeInfo* info = gemm_type_info(type);
+    cl_device_id device_id;
+    cl_context context;
+    cl_command_queue command_queue;
+    GemmContext gemm;
+    GemmDispatch dispatch;
+    int has_device = 0;
+    int n;
+
+    if (open_gpu(&device_id, &context, &command_queue) != 0) {
+        printf("No OpenCL GPU found, every product runs on the CPU\n");
+    } else if (gemm_init(&gemm, context, device_id, command_queue, type, NULL) != CL_SUCCESS) {
+        printf("GEMM initialization error, every product runs on the CPU\n");
+        gemm_release(&gemm);
+    } else {
+        has_device = 1;
+    }
+    if (gemm_dispatch_init(&dispatch, has_device ? &gemm : NULL, type, recalibrate) != 0) {
+        printf("Calibration error!\n");
         return 0;
     }
+    if (dispatch.crossover < 0.0) {
+        printf("Crossover: none, the CPU is always faster\n");
+    } else {
+        printf("Crossover: %.0f multiply-adds (about %.0f^3)\n", dispatch.crossover, cbrt(dispatch.crossover));
+    }
+
+    for (n = 16; n <= DISPATCH_MAX_SIZE; n *= 2) {
+        size_t count = (size_t)n * n;
+        void* A = malloc(count * info->elem_size);
+        void* B = malloc(count * info->elem_size);
+        void* C = malloc(count * info->out_size);
+        Backend backend;
 
-    cl_kernel kernel = clCreateKernel(program, "matrix_mult_kernel", NULL);
+        gemm_type_fill_seeded(type, A, count, SEED_A, FILL_MIN(type), FILL_MAX(type));
+        gemm_type_fill_seeded(type, B, count, SEED_B, FILL_MIN(type), FILL_MAX(type));
+        struct timespec start, end;
+        timespec_get(&start, TIME_UTC);
+        cl_int err = gemm_dispatch_run(&dispatch, n, n, n, 1.0, A, B, 0.0, C, &backend);
+        timespec_get(&end, TIME_UTC);
+        double seconds = (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+        if (err != CL_SUCCESS) {
+            printf("%5d: error %d\n", n, err);
+        } else {
+            printf("%5d: %-6s %.6f s\n", n, backend == BACKEND_DEVICE ? "device" : "CPU", seconds);
+        }
+        free(A);
+        free(B);
+        free(C);
+    }
+
+    gemm_dispatch_release(&dispatch);
+    if (has_device) {
+        gemm_release(&gemm);
+    }
+    close_gpu(device_id, context, command_queue);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    // Initialize
+    cl_int err;
+    int M = 4;
+    int N = 4;
+    int K = 4;
+
+    // Mode selection: bench sweeps sizes and variants into a CSV file; a single
+    // product runs with auto (tuned configuration of the device), naive, reg4 or
+    // reg8 (register-blocked, 4x4 or 8x8 per work-item) or cpu (host implementation);
+    // tune runs the autotuner first and naive_bt transposes B before the naive kernel
+    const char* variant = argc > 1 ? argv[1] : "bench";
+    GemmConfig config = gemm_default_config;
+    const GemmConfig* selected_config = &config;
+    int use_cpu = 0;
+    if (strcmp(variant, "bench") == 0) {
+        GemmType type = GEMM_INT;
+        if (argc > 2 && gemm_type_parse(argv[2], &type) != 0) {
+            printf("Unknown element type: %s\n", argv[2]);
+            return 0;
+        }
+        return run_benchmark(variant, type, argc > 3 ? argv[3] : "gemm_benchmark.csv", 0);
+    } else if (strcmp(variant, "transpose") == 0) {
+        GemmType type = GEMM_FLOAT;
+        if (argc > 2 && gemm_type_parse(argv[2], &type) != 0) {
+            printf("Unknown element type: %s\n", argv[2]);
+            return 0;
+        }
+        return run_benchmark(variant, type, argc > 3 ? argv[3] : "transpose_benchmark.csv", 0);
+    } else if (strcmp(variant, "strassen") == 0) {
+        GemmType type = GEMM_FLOAT;
+        if (argc > 2 && gemm_type_parse(argv[2], &type) != 0) {
+            printf("Unknown element type: %s\n", argv[2]);
+            return 0;
+        }
+        int cutoff = argc > 3 ? atoi(argv[3]) : 512;
+        if (cutoff < 1) {
+            printf("Invalid cutoff: %s\n", argv[3]);
+            return 0;
+        }
+        return run_benchmark(variant, type, argc > 4 ? argv[4] : "strassen_benchmark.csv", cutoff);
+    } else if (strcmp(variant, "sparse") == 0 && argc > 2) {
+        GemmType type = GEMM_FLOAT;
+        if (argc > 3 && gemm_type_parse(argv[3], &type) != 0) {
+            printf("Unknown element type: %s\n", argv[3]);
+            return 0;
+        }
+        int columns = argc > 4 ? atoi(argv[4]) : 64;
+        if (columns < 1) {
+            printf("Invalid column count: %s\n", argv[4]);
+            return 0;
+        }
+        return run_sparse(argv[2], type, columns);
+    } else if (strcmp(variant, "dispatch") == 0) {
+        GemmType type = GEMM_FLOAT;
+        if (argc > 2 && gemm_type_parse(argv[2], &type) != 0) {
+            printf("Unknown element type: %s\n", argv[2]);
+            return 0;
+        }
+        return run_dispatch(type, argc > 3 && strcmp(argv[3], "recalibrate") == 0);
+    } else if (strcmp(variant, "auto") == 0 || strcmp(variant, "tune") == 0) {
+        selected_config = NULL;
+    } else if (strcmp(variant, "naive") == 0 || strcmp(variant, "naive_bt") == 0) {
+        config.block = 0;
+    } else if (strcmp(variant, "reg4") == 0) {
+        config.block = 4;
+    } else if (strcmp(variant, "reg8") == 0) {
+        config.block = 8;
+    } else if (strcmp(variant, "cpu") == 0) {
+        use_cpu = 1;
+    } else {
+        printf("Usage: %s bench [int|float|double|half|int8] [output.csv]\n", argv[0]);
+        printf("       %s strassen [int|float|double|half] [cutoff] [output.csv]\n", argv[0]);
+        printf("       %s transpose [int|float|double|half|int8] [output.csv]\n", argv[0]);
+        printf("       %s dispatch [int|float|double|half|int8] [recalibrate]\n", argv[0]);
+        printf("       %s sparse <matrix.mtx|N> [int|float|double|half|int8] [SpMM columns]\n", argv[0]);
+        printf("       %s [auto|tune|naive|naive_bt|reg4|reg8|cpu] [N|MxNxK] [int|float|double|half|int8] [batch count] [device budget MiB]\n", argv[0]);
+        return 0;
+    }
+    if (argc > 2 && sscanf(argv[2], "%dx%dx%d", &M, &N, &K) != 3) {
+        M = N = K = atoi(argv[2]);
+    }
+    if (M < 1 || N < 1 || K < 1) {
+        printf("Invalid matrix size: %s\n", argv[2]);
+        return 0;
+    }
+    GemmType type = GEMM_INT;
+    if (argc > 3 && gemm_type_parse(argv[3], &type) != 0) {
+        printf("Unknown element type: %s\n", argv[3]);
+        return 0;
+    }
+    // Batches of small matrices are multiplied in a single launch
+    int batch_count = argc > 4 ? atoi(argv[4]) : 1;
+    if (batch_count < 1) {
+        printf("Invalid batch count: %s\n", argv[4]);
+        return 0;
+    }
+    // A device memory budget in MiB selects the out-of-core mode
+    size_t budget_mib = argc > 5 ? (size_t)atol(argv[5]) : 0;
+    if (budget_mib > 0 && batch_count > 1) {
+        printf("The out-of-core mode multiplies a single pair of matrices!\n");
+        return 0;
+    }
+    if (strcmp(variant, "naive_bt") == 0 && batch_count > 1) {
+        printf("naive_bt multiplies a single pair of matrices!\n");
+        return 0;
+    }
+    size_t elem_size = gemm_type_info(type)->elem_size;
+    size_t out_size = gemm_type_info(type)->out_size;
 
     // Create the host buffers and initialize them
-    int* host_buffer_a = (int*)malloc(MATRIX_SIZE * MATRIX_SIZE * sizeof(int));
-    int* host_buffer_b = (int*)malloc(MATRIX_SIZE * MATRIX_SIZE * sizeof(int));
-    int* host_buffer_result = (int*)malloc(MATRIX_SIZE * MATRIX_SIZE * sizeof(int));
+    void* host_buffer_a = malloc((size_t)M * K * batch_count * elem_size);
+    void* host_buffer_b = malloc((size_t)K * N * batch_count * elem_size);
+    void* host_buffer_result = malloc((size_t)M * N * batch_count * out_size);
+
+    // Get platform
+    cl_uint n_platforms;
+    cl_platform_id platform_id;
+    cl_device_id device_id = NULL;
+    cl_uint n_devices;
+    cl_context context = NULL;
+    cl_command_queue command_queue = NULL;
+    GemmContext gemm;
+    memset(&gemm, 0, sizeof(gemm));
+    if (!use_cpu) {
+        err = clGetPlatformIDs(1, &platform_id, &n_platforms);
+        if (err != CL_SUCCESS) {
+            printf("[ERROR] Error calling clGetPlatformIDs. Error code: %d\n", err);
+            use_cpu = 1;
+        }
+    }
 
-    for (i = 0; i < MATRIX_SIZE * MATRIX_SIZE; ++i) {
-        // Random number between MIN and MAX
-        host_buffer_a[i] = MIN + rand() % (MAX - MIN + 1); 
-        host_buffer_b[i] = MIN + rand() % (MAX - MIN + 1); 
+    // Get device
+    if (!use_cpu) {
+        err = clGetDeviceIDs(
+            platform_id,
+            CL_DEVICE_TYPE_GPU,
+            1,
+            &device_id,
+            &n_devices
+        );
+        if (err != CL_SUCCESS) {
+            printf("[ERROR] Error calling clGetDeviceIDs. Error code: %d\n", err);
+            use_cpu = 1;
+        }
     }
 
-    for (i = 0; i < MATRIX_SIZE * MATRIX_SIZE; ++i) {
-        printf("%d ", host_buffer_a[i]);
-        if((i+1) % MATRIX_SIZE == 0){
-            printf("\n");
+    if (!use_cpu) {
+        // Create OpenCL context
+        context = clCreateContext(NULL, n_devices, &device_id, NULL, NULL, NULL);
+
+        // Create the command queue
+        command_queue = clCreateCommandQueue(
+            context, device_id, CL_QUEUE_PROFILING_ENABLE, NULL);
+
+        // Benchmark the configurations and store the fastest ones for later runs
+        if (strcmp(variant, "tune") == 0) {
+            GemmConfig configs[GEMM_SIZE_CLASSES];
+            double gflops[GEMM_SIZE_CLASSES];
+            char path[512];
+            err = gemm_autotune(context, device_id, command_queue, type, configs, gflops);
+            if (err == GEMM_TYPE_UNSUPPORTED) {
+                printf("The device does not support %s matrices (%s missing)!\n",
+                    gemm_type_info(type)->name, gemm_type_info(type)->extension);
+                return 0;
+            } else if (err == GEMM_TUNE_NO_CANDIDATE) {
+                printf("No configuration could be benchmarked, nothing saved!\n");
+                return 0;
+            } else if (err != CL_SUCCESS) {
+                printf("Autotuning error! Code: %d\n", err);
+                return 0;
+            }
+            gemm_config_path(device_id, path, sizeof(path));
+            for (int c = 0; c < GEMM_SIZE_CLASSES; ++c) {
+                if (!(gflops[c] > 0.0)) {
+                    printf("Class %d: no configuration ran, not saved\n", c);
+                    continue;
+                }
+                printf("Class %d: block %d, vector width %d, local %dx%d, tile %d (%.2f GFLOPS)\n",
+                    c, configs[c].block, configs[c].vector_width,
+                    configs[c].local_size[0], configs[c].local_size[1], configs[c].tile, gflops[c]);
+            }
+            printf("Saved to %s\n", path);
+        }
+
+        // Build the program
+        err = gemm_init(&gemm, context, device_id, command_queue, type, selected_config);
+        if (err == GEMM_TYPE_UNSUPPORTED) {
+            printf("The device does not support %s matrices (%s missing)!\n",
+                gemm_type_info(type)->name, gemm_type_info(type)->extension);
+            use_cpu = 1;
+        } else if (err == -1) {
+            printf("The GEMM kernel sources could not be loaded!\n");
+            return 0;
+        } else if (err != CL_SUCCESS) {
+            printf("GEMM initialization error! Code: %d\n", err);
+            return 0;
         }
+        gemm.pre_transpose_b = strcmp(variant, "naive_bt") == 0;
     }
 
-    for (i = 0; i < MATRIX_SIZE * MATRIX_SIZE; ++i) {
-        printf("%d ", host_buffer_b[i]);
-        if((i+1) % MATRIX_SIZE == 0){
-            printf("\n");
+    // Random numbers between FILL_MIN and FILL_MAX from fixed seeds, generated on the
+    // device when the matrices live there and identical on either side
+    if (use_cpu || budget_mib > 0) {
+        gemm_type_fill_seeded(type, host_buffer_a, (size_t)M * K * batch_count, SEED_A, FILL_MIN(type), FILL_MAX(type));
+        gemm_type_fill_seeded(type, host_buffer_b, (size_t)K * N * batch_count, SEED_B, FILL_MIN(type), FILL_MAX(type));
+        print_matrix(type, host_buffer_a, M, K, 0);
+        print_matrix(type, host_buffer_b, K, N, 0);
+    }
+
+    if (use_cpu) {
+        // Fallback backend
+        printf("Using the CPU backend (%d threads)\n", cpu_count());
+        clock_t start = clock();
+        cpu_gemm_batch(type, M, N, K, host_buffer_a, host_buffer_b, host_buffer_result, batch_count);
+        printf("CPU time: %.6f seconds\n", (double)(clock() - start) / CLOCKS_PER_SEC);
+    } else if (budget_mib > 0) {
+        // Out-of-core: the operands stay in host memory and are streamed through the budget
+        err = gemm_out_of_core(&gemm, M, N, K, 1.0, host_buffer_a, host_buffer_b, 0.0,
+            host_buffer_result, budget_mib << 20);
+        if (err != CL_SUCCESS) {
+            printf("Out-of-core GEMM error! Code: %d\n", err);
+            return 0;
+        }
+    } else {
+        // Create the device matrices, they stay resident for further products
+        GemmMatrix matrix_a, matrix_b, matrix_result;
+        gemm_matrix_create_batched(&gemm, &matrix_a, M, K, GEMM_ROW_MAJOR, 0, batch_count);
+        gemm_matrix_create_batched(&gemm, &matrix_b, K, N, GEMM_ROW_MAJOR, 0, batch_count);
+        gemm_matrix_create_batched(&gemm, &matrix_result, M, N, GEMM_ROW_MAJOR, 1, batch_count);
+
+        // Fill the inputs in place and copy them to the host for the verification (the batch is densely packed)
+        gemm_matrix_fill_random(&gemm, &matrix_a, batch_count, SEED_A, FILL_MIN(type), FILL_MAX(type));
+        gemm_matrix_fill_random(&gemm, &matrix_b, batch_count, SEED_B, FILL_MIN(type), FILL_MAX(type));
+        clEnqueueReadBuffer(command_queue, matrix_a.buffer, CL_FALSE, 0,
+            (size_t)M * K * batch_count * elem_size, host_buffer_a, 0, NULL, NULL);
+        clEnqueueReadBuffer(command_queue, matrix_b.buffer, CL_FALSE, 0,
+            (size_t)K * N * batch_count * elem_size, host_buffer_b, 0, NULL, NULL);
+
+        // C = A * B
+        cl_event event;
+        if (batch_count > 1) {
+            err = gemm_run_batched(&gemm, GEMM_NO_TRANS, GEMM_NO_TRANS,
+                1.0, &matrix_a, M * K, &matrix_b, K * N,
+                0.0, &matrix_result, M * N, batch_count, &event);
+        } else {
+            err = gemm_run(&gemm, GEMM_NO_TRANS, GEMM_NO_TRANS, 1.0, &matrix_a, &matrix_b, 0.0, &matrix_result, &event);
+        }
+        if (err != CL_SUCCESS) {
+            printf("Kernel launch error! Code: %d\n", err);
+            return 0;
         }
+        clFinish(command_queue);
+        // naive_bt also counts the transpose of B it depends on
+        cl_ulong gpu_start, gpu_end;
+        clGetEventProfilingInfo(gemm.transpose_event != NULL ? gemm.transpose_event : event,
+            CL_PROFILING_COMMAND_START, sizeof(gpu_start), &gpu_start, NULL);
+        clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(gpu_end), &gpu_end, NULL);
+        printf("GPU time: %.6f seconds%s\n", (gpu_end - gpu_start) * 1e-9,
+            gemm.transpose_event != NULL ? " (including the transpose of B)" : "");
+        clReleaseEvent(event);
+
+        // Host buffer <- Device buffer
+        clEnqueueReadBuffer(command_queue, matrix_result.buffer, CL_TRUE, 0,
+            (size_t)M * N * batch_count * out_size, host_buffer_result, 0, NULL, NULL);
+        print_matrix(type, host_buffer_a, M, K, 0);
+        print_matrix(type, host_buffer_b, K, N, 0);
+
+        gemm_matrix_release(&matrix_a);
+        gemm_matrix_release(&matrix_b);
+        gemm_matrix_release(&matrix_result);
     }
 
-    // Create the device buffers
-    cl_mem device_buffer_a = clCreateBuffer(context, CL_MEM_READ_ONLY, MATRIX_SIZE * MATRIX_SIZE * sizeof(int), NULL, NULL);
-    cl_mem device_buffer_b = clCreateBuffer(context, CL_MEM_READ_ONLY, MATRIX_SIZE * MATRIX_SIZE * sizeof(int), NULL, NULL);
-    cl_mem device_buffer_result = clCreateBuffer(context, CL_MEM_WRITE_ONLY, MATRIX_SIZE * MATRIX_SIZE * sizeof(int), NULL, NULL);
-
-    // Set kernel arguments
-    clSetKernelArg(kernel, 0, sizeof(cl_mem), (void*)&device_buffer_a);
-    clSetKernelArg(kernel, 1, sizeof(cl_mem), (void*)&device_buffer_b);
-    clSetKernelArg(kernel, 2, sizeof(cl_mem), (void*)&device_buffer_result);
-    clSetKernelArg(kernel, 3, sizeof(int), (void*)&MATRIX_SIZE);
-
-    // Create the command queue
-    cl_command_queue command_queue = clCreateCommandQueue(
-        context, device_id, CL_QUEUE_PROFILING_ENABLE, NULL);
-
-    // Host buffer -> Device buffer
-    clEnqueueWriteBuffer(
-        command_queue,
-        device_buffer_a,
-        CL_FALSE,
-        0,
-        MATRIX_SIZE * MATRIX_SIZE * sizeof(int),
-        host_buffer_a,
-        0,
-        NULL,
-        NULL
-    );
-    clEnqueueWriteBuffer(
-        command_queue,
-        device_buffer_b,
-        CL_FALSE,
-        0,
-        MATRIX_SIZE * MATRIX_SIZE * sizeof(int),
-        host_buffer_b,
-        0,
-        NULL,
-        NULL
-    );
-
-    // Size specification
-    size_t local_work_size = 16;
-    size_t global_work_size[2] = { MATRIX_SIZE, MATRIX_SIZE };
-
-    // Apply the kernel on the range
-    cl_event event;
-    clEnqueueNDRangeKernel(
-        command_queue,
-        kernel,
-        2,
-        NULL,
-        global_work_size,
-        &local_work_size,
-        0,
-        NULL,
-        &event
-    );
-    clFinish(command_queue);
-
-    // Host buffer <- Device buffer
-    clEnqueueReadBuffer(
-        command_queue,
-        device_buffer_result,
-        CL_TRUE,
-        0,
-        MATRIX_SIZE * MATRIX_SIZE * sizeof(int),
-        host_buffer_result,
-        0,
-        NULL,
-        NULL
-    );
+    // Only the first product of a batch is shown
+    print_matrix(type, host_buffer_result, M, N, 1);
+
+    // Check the device result against the host implementation
+    if (!use_cpu) {
+        void* expected = malloc((size_t)M * N * batch_count * out_size);
+        cpu_gemm_batch(type, M, N, K, host_buffer_a, host_buffer_b, expected, batch_count);
+        size_t mismatches = gemm_compare(type, expected, host_buffer_result, (size_t)M * N * batch_count, K);
+        if (mismatches == 0) {
+            printf("Result verified\n");
+        } else {
+            printf("[ERROR] %zu elements differ from the CPU result\n", mismatches);
+        }
+        free(expected);
+    }
 
     free(host_buffer_a);
     free(host_buffer_b);
     free(host_buffer_result);
 
     // Release Resources
-    clReleaseKernel(kernel);
-    clReleaseProgram(program);
-    clReleaseContext(context);
-    clReleaseDevice(device_id);
+    if (context != NULL) {
+        gemm_release(&gemm);
+        clReleaseCommandQueue(command_queue);
+        clReleaseContext(context);
+        clReleaseDevice(device_id);
+    }
 }
@@ -0,0 +1,288 @@
+#include "autotune.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Matrix size benchmarked for each size class
+static const int class_sizes[GEMM_SIZE_CLASSES] = { 128, 512, 2048 };
+
+// Candidate parameters
+static const int blocks[][2] = { { 0, 4 }, { 4, 4 }, { 8, 4 }, { 8, 8 } };
+static const int local_sizes[][2] = { { 0, 0 }, { 8, 8 }, { 16, 16 }, { 16, 4 }, { 4, 16 } };
+static const int tiles[] = { 4, 8, 16 };
+
+// Batch benchmarked for the tile size
+#define TILE_MATRIX_SIZE 32
+#define TILE_BATCH_COUNT 1024
+
+#define REPEATS 3
+
+void gemm_config_path(cl_device_id device_id, char* path, size_t size)
+{
+    char name[256] = "";
+    const char* dir = getenv("GEMM_CONFIG_DIR");
+    int i;
+
+    clGetDeviceInfo(device_id, CL_DEVICE_NAME, sizeof(name) - 1, name, NULL);
+    for (i = 0; name[i] != 0; ++i) {
+        if (!isalnum((unsigned char)name[i])) {
+            name[i] = '_';
+        }
+    }
+    snprintf(path, size, "%s/gemm_%s.cfg", dir != NULL ? dir : ".", name);
+}
+
+int gemm_config_load(cl_device_id device_id, GemmType type, int size_class, GemmConfig* config)
+{
+    char path[512];
+    char line[256];
+    char type_name[32];
+    int line_class;
+    GemmConfig line_config;
+    FILE* file;
+    int result = -1;
+
+    gemm_config_path(device_id, path, sizeof(path));
+    file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%31s %d %d %d %d %d %d", type_name, &line_class,
+            &line_config.block, &line_config.vector_width,
+            &line_config.local_size[0], &line_config.local_size[1], &line_config.tile) != 7) continue;
+        if (strcmp(type_name, gemm_type_info(type)->name) == 0 && line_class == size_class) {
+            *config = line_config;
+            result = 0;
+        }
+    }
+    fclose(file);
+    return result;
+}
+
+int gemm_config_save(cl_device_id device_id, GemmType type,
+    const GemmConfig configs[GEMM_SIZE_CLASSES], const double gflops[GEMM_SIZE_CLASSES])
+{
+    char path[512];
+    char line[256];
+    char type_name[32];
+    int line_class;
+    char* kept = NULL;
+    size_t kept_size = 0;
+    FILE* file;
+    int i;
+
+    // Keep the entries of the other types and of the classes that were not tuned
+    gemm_config_path(device_id, path, sizeof(path));
+    file = fopen(path, "r");
+    if (file != NULL) {
+        while (fgets(line, sizeof(line), file)) {
+            if (line[0] == '#' || sscanf(line, "%31s %d", type_name, &line_class) != 2) continue;
+            if (strcmp(type_name, gemm_type_info(type)->name) == 0
+                && (line_class < 0 || line_class >= GEMM_SIZE_CLASSES || gflops[line_class] > 0.0)) continue;
+            kept = (char*)realloc(kept, kept_size + strlen(line) + 1);
+            strcpy(kept + kept_size, line);
+            kept_size += strlen(line);
+        }
+        fclose(file);
+    }
+
+    file = fopen(path, "w");
+    if (file == NULL) {
+        free(kept);
+        return -1;
+    }
+    fprintf(file, "# type size_class block vector_width local_x local_y tile gflops\n");
+    if (kept != NULL) {
+        fputs(kept, file);
+        free(kept);
+    }
+    for (i = 0; i < GEMM_SIZE_CLASSES; ++i) {
+        if (!(gflops[i] > 0.0)) continue;
+        fprintf(file, "%s %d %d %d %d %d %d %.3f\n", gemm_type_info(type)->name, i,
+            configs[i].block, configs[i].vector_width,
+            configs[i].local_size[0], configs[i].local_size[1], configs[i].tile, gflops[i]);
+    }
+    fclose(file);
+    return 0;
+}
+
+/**
+ * Kernel time of an event in seconds.
+ */
+static double event_seconds(cl_event event)
+{
+    cl_ulong start_ns;
+    cl_ulong end_ns;
+
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(start_ns), &start_ns, NULL);
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(end_ns), &end_ns, NULL);
+    return (double)(end_ns - start_ns) / 1000000000.0;
+}
+
+/**
+ * Best kernel time of REPEATS runs after a warm-up run, a negative value if the launch fails.
+ * batch_count: 0 for gemm_run, otherwise the batch size of gemm_run_batched
+ */
+static double time_gemm(GemmContext* gemm, GemmMatrix* A, GemmMatrix* B, GemmMatrix* C, int batch_count)
+{
+    double best = -1.0;
+    int i;
+
+    for (i = 0; i <= REPEATS; ++i) {
+        cl_event event;
+        cl_int err;
+
+        if (batch_count > 0) {
+            err = gemm_run_batched(gemm, GEMM_NO_TRANS, GEMM_NO_TRANS, 1.0, A, A->rows * A->cols,
+                B, B->rows * B->cols, 0.0, C, C->rows * C->cols, batch_count, &event);
+        } else {
+            err = gemm_run(gemm, GEMM_NO_TRANS, GEMM_NO_TRANS, 1.0, A, B, 0.0, C, &event);
+        }
+        if (err != CL_SUCCESS) {
+            return -1.0;
+        }
+        if (clWaitForEvents(1, &event) != CL_SUCCESS) {
+            clReleaseEvent(event);
+            return -1.0;
+        }
+        double seconds = event_seconds(event);
+        clReleaseEvent(event);
+        if (i > 0 && (best < 0.0 || seconds < best)) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+/**
+ * Create A, B and C with random contents.
+ */
+static void create_operands(GemmContext* gemm, int n, int batch_count, GemmMatrix* A, GemmMatrix* B, GemmMatrix* C)
+{
+    size_t count = (size_t)n * n * batch_count;
+    void* host = malloc(count * gemm_type_info(gemm->type)->elem_size);
+
+    gemm_matrix_create_batched(gemm, A, n, n, GEMM_ROW_MAJOR, 0, batch_count);
+    gemm_matrix_create_batched(gemm, B, n, n, GEMM_ROW_MAJOR, 0, batch_count);
+    gemm_matrix_create_batched(gemm, C, n, n, GEMM_ROW_MAJOR, 1, batch_count);
+    gemm_type_fill_random(gemm->type, host, count, -2, 2);
+    clEnqueueWriteBuffer(gemm->command_queue, A->buffer, CL_TRUE, 0,
+        count * gemm_type_info(gemm->type)->elem_size, host, 0, NULL, NULL);
+    clEnqueueWriteBuffer(gemm->command_queue, B->buffer, CL_TRUE, 0,
+        count * gemm_type_info(gemm->type)->elem_size, host, 0, NULL, NULL);
+    free(host);
+}
+
+static void release_operands(GemmMatrix* A, GemmMatrix* B, GemmMatrix* C)
+{
+    gemm_matrix_release(A);
+    gemm_matrix_release(B);
+    gemm_matrix_release(C);
+}
+
+int gemm_autotune(cl_context context, cl_device_id device_id, cl_command_queue command_queue,
+    GemmType type, GemmConfig configs[GEMM_SIZE_CLASSES], double gflops[GEMM_SIZE_CLASSES])
+{
+    GemmMatrix A[GEMM_SIZE_CLASSES], B[GEMM_SIZE_CLASSES], C[GEMM_SIZE_CLASSES];
+    GemmContext gemm;
+    size_t max_work_group_size;
+    int b, l, c, t;
+    int err;
+
+    for (c = 0; c < GEMM_SIZE_CLASSES; ++c) {
+        configs[c] = gemm_default_config;
+        gflops[c] = 0.0;
+    }
+    clGetDeviceInfo(device_id, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(max_work_group_size), &max_work_group_size, NULL);
+
+    // Register block, vector width and local size per size class
+    for (b = 0; b < (int)(sizeof(blocks) / sizeof(blocks[0])); ++b) {
+        GemmConfig config = gemm_default_config;
+
+        config.block = blocks[b][0];
+        config.vector_width = blocks[b][1];
+        err = gemm_init(&gemm, context, device_id, command_queue, type, &config);
+        if (err == GEMM_TYPE_UNSUPPORTED || err == -1) {
+            // Every other candidate would fail the same way
+            gemm_release(&gemm);
+            return err;
+        } else if (err != CL_SUCCESS) {
+            gemm_release(&gemm);
+            continue;
+        }
+        for (c = 0; c < GEMM_SIZE_CLASSES; ++c) {
+            create_operands(&gemm, class_sizes[c], 1, &A[c], &B[c], &C[c]);
+        }
+
+        for (l = 0; l < (int)(sizeof(local_sizes) / sizeof(local_sizes[0])); ++l) {
+            if ((size_t)(local_sizes[l][0] * local_sizes[l][1]) > max_work_group_size) continue;
+            for (c = 0; c < GEMM_SIZE_CLASSES; ++c) {
+                gemm.kernels[c].config.local_size[0] = local_sizes[l][0];
+                gemm.kernels[c].config.local_size[1] = local_sizes[l][1];
+            }
+            for (c = 0; c < GEMM_SIZE_CLASSES; ++c) {
+                double n = class_sizes[c];
+                double seconds = time_gemm(&gemm, &A[c], &B[c], &C[c], 0);
+                if (seconds <= 0.0) continue;
+                double result = 2.0 * n * n * n / seconds / 1e9;
+                printf("%s class %d: block %d, vector width %d, local %dx%d: %.2f GFLOPS\n",
+                    gemm_type_info(type)->name, c, config.block, config.vector_width,
+                    local_sizes[l][0], local_sizes[l][1], result);
+                if (result > gflops[c]) {
+                    gflops[c] = result;
+                    configs[c] = gemm.kernels[c].config;
+                }
+            }
+        }
+
+        for (c = 0; c < GEMM_SIZE_CLASSES; ++c) {
+            release_operands(&A[c], &B[c], &C[c]);
+        }
+        gemm_release(&gemm);
+    }
+
+    // Tile size of the batched kernel, shared by all classes
+    int best_tile = gemm_default_config.tile;
+    double best_seconds = -1.0;
+    for (t = 0; t < (int)(sizeof(tiles) / sizeof(tiles[0])); ++t) {
+        GemmConfig config = gemm_default_config;
+
+        if ((size_t)(tiles[t] * tiles[t]) > max_work_group_size) continue;
+        config.tile = tiles[t];
+        if (gemm_init(&gemm, context, device_id, command_queue, type, &config) != CL_SUCCESS) {
+            gemm_release(&gemm);
+            continue;
+        }
+        create_operands(&gemm, TILE_MATRIX_SIZE, TILE_BATCH_COUNT, &A[0], &B[0], &C[0]);
+        double seconds = time_gemm(&gemm, &A[0], &B[0], &C[0], TILE_BATCH_COUNT);
+        if (seconds > 0.0) {
+            printf("%s batched: tile %d: %.6f s\n", gemm_type_info(type)->name, tiles[t], seconds);
+            if (best_seconds < 0.0 || seconds < best_seconds) {
+                best_seconds = seconds;
+                best_tile = tiles[t];
+            }
+        }
+        release_operands(&A[0], &B[0], &C[0]);
+        gemm_release(&gemm);
+    }
+    for (c = 0; c < GEMM_SIZE_CLASSES; ++c) {
+        configs[c].tile = best_tile;
+    }
+
+    // Nothing ran: keep the cache free of untuned defaults
+    int tuned = 0;
+    for (c = 0; c < GEMM_SIZE_CLASSES; ++c) {
+        tuned |= gflops[c] > 0.0;
+    }
+    if (!tuned) {
+        return GEMM_TUNE_NO_CANDIDATE;
+    }
+    if (gemm_config_save(device_id, type, configs, gflops) != 0) {
+        printf("Could not save the tuning results!\n");
+    }
+    return CL_SUCCESS;
+}
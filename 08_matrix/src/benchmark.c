@@ -0,0 +1,743 @@
+#include "benchmark.h"
+#include "cpu_gemm.h"
+#include "sparse.h"
+#include "strassen.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define REPEATS 3
+
+// Results are checked against the CPU up to this many multiply-adds
+#define MAX_VERIFIED_WORK (1LL << 30)
+
+// The CPU variant is skipped above this many multiply-adds
+#define MAX_CPU_WORK (1LL << 32)
+
+typedef struct {
+    const char* name;
+    int block;
+    int vector_width;
+    int tuned;
+} BenchmarkVariant;
+
+static const BenchmarkVariant variants[] = {
+    { "naive", 0, 4, 0 },
+    { "reg4", 4, 4, 0 },
+    { "reg8", 8, 4, 0 },
+    { "reg8_vw8", 8, 8, 0 },
+    { "auto", 0, 0, 1 }
+};
+#define N_VARIANTS ((int)(sizeof(variants) / sizeof(variants[0])))
+
+// Rectangular M x N x K shapes after the square sweep
+static const int shapes[][3] = {
+    { 4096, 256, 1024 },
+    { 256, 4096, 1024 },
+    { 1024, 1024, 64 },
+    { 64, 64, 16384 },
+    { 8192, 64, 512 }
+};
+
+#define MIN_SQUARE_SIZE 64
+#define MAX_SQUARE_SIZE 4096
+
+// Square sizes of the Strassen-Winograd comparison, and the largest magnitude of its inputs
+#define MIN_STRASSEN_SIZE 1024
+#define MAX_STRASSEN_SIZE 8192
+#define STRASSEN_INPUT_MAX 2
+
+// Shapes of the transpose benchmark, including ones that are not whole tiles
+static const int transpose_shapes[][2] = {
+    { 1024, 1024 },
+    { 2048, 2048 },
+    { 4096, 4096 },
+    { 8192, 8192 },
+    { 1000, 3000 },
+    { 8192, 512 }
+};
+
+// The sparse benchmark also times the dense product up to this many elements of A
+#define MAX_DENSE_ELEMENTS (1LL << 26)
+
+static double event_time(cl_event event, cl_profiling_info info)
+{
+    cl_ulong ns;
+
+    clGetEventProfilingInfo(event, info, sizeof(ns), &ns, NULL);
+    return (double)ns / 1000000000.0;
+}
+
+static double wall_time(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+/**
+ * Time one product on the device.
+ *
+ * Returns 0 on success
+ */
+static int run_device(GemmContext* gemm, int M, int N, int K, const void* A, const void* B, void* C,
+    double* kernel_s, double* end_to_end_s)
+{
+    GemmMatrix matrix_a = { 0 }, matrix_b = { 0 }, matrix_c = { 0 };
+    int result = 0;
+    int r;
+
+    *kernel_s = -1.0;
+    *end_to_end_s = -1.0;
+    if (gemm_matrix_create(gemm, &matrix_a, M, K, GEMM_ROW_MAJOR, 0) != CL_SUCCESS
+        || gemm_matrix_create(gemm, &matrix_b, K, N, GEMM_ROW_MAJOR, 0) != CL_SUCCESS
+        || gemm_matrix_create(gemm, &matrix_c, M, N, GEMM_ROW_MAJOR, 1) != CL_SUCCESS) {
+        result = -1;
+    }
+
+    // The first run is a warm-up
+    for (r = 0; r <= REPEATS && result == 0; ++r) {
+        cl_event upload, kernel, readback;
+
+        if (clEnqueueWriteBuffer(gemm->command_queue, matrix_a.buffer, CL_FALSE, 0,
+                (size_t)M * K * gemm_matrix_elem_size(gemm, &matrix_a), A, 0, NULL, &upload) != CL_SUCCESS
+            || clEnqueueWriteBuffer(gemm->command_queue, matrix_b.buffer, CL_FALSE, 0,
+                (size_t)K * N * gemm_matrix_elem_size(gemm, &matrix_b), B, 0, NULL, NULL) != CL_SUCCESS
+            || gemm_run(gemm, GEMM_NO_TRANS, GEMM_NO_TRANS, 1.0, &matrix_a, &matrix_b, 0.0, &matrix_c, &kernel) != CL_SUCCESS
+            || clEnqueueReadBuffer(gemm->command_queue, matrix_c.buffer, CL_TRUE, 0,
+                (size_t)M * N * gemm_matrix_elem_size(gemm, &matrix_c), C, 0, NULL, &readback) != CL_SUCCESS) {
+            result = -1;
+            break;
+        }
+        double kernel_time = event_time(kernel, CL_PROFILING_COMMAND_END) - event_time(kernel, CL_PROFILING_COMMAND_START);
+        double total_time = event_time(readback, CL_PROFILING_COMMAND_END) - event_time(upload, CL_PROFILING_COMMAND_START);
+        if (r > 0 && (*kernel_s < 0.0 || kernel_time < *kernel_s)) {
+            *kernel_s = kernel_time;
+        }
+        if (r > 0 && (*end_to_end_s < 0.0 || total_time < *end_to_end_s)) {
+            *end_to_end_s = total_time;
+        }
+        clReleaseEvent(upload);
+        clReleaseEvent(kernel);
+        clReleaseEvent(readback);
+    }
+
+    gemm_matrix_release(&matrix_a);
+    gemm_matrix_release(&matrix_b);
+    gemm_matrix_release(&matrix_c);
+    return result;
+}
+
+/**
+ * Print and write one result line.
+ */
+static void report(FILE* file, const char* variant, GemmType type, int M, int N, int K,
+    double kernel_s, double end_to_end_s, const char* verified)
+{
+    const GemmTypeInfo* info = gemm_type_info(type);
+    double ops = 2.0 * M * N * K;
+    double bytes = ((double)M * K + (double)K * N) * info->elem_size + (double)M * N * info->out_size;
+    const char* unit = type == GEMM_INT || type == GEMM_INT8 ? "GOPS" : "GFLOPS";
+
+    printf("%-8s %-6s %5dx%5dx%5d  kernel %.6f s  %8.2f %s  %7.2f GB/s  end-to-end %.6f s  %8.2f %s  %s\n",
+        variant, info->name, M, N, K, kernel_s, ops / kernel_s / 1e9, unit, bytes / kernel_s / 1e9,
+        end_to_end_s, ops / end_to_end_s / 1e9, unit, verified);
+    fprintf(file, "%s,%s,%d,%d,%d,%.9f,%.9f,%.3f,%.3f,%.3f,%s\n",
+        variant, info->name, M, N, K, kernel_s, end_to_end_s,
+        ops / kernel_s / 1e9, ops / end_to_end_s / 1e9, bytes / kernel_s / 1e9, verified);
+    fflush(file);
+}
+
+/**
+ * Benchmark every variant on one M x N x K shape.
+ */
+static void benchmark_shape(FILE* file, GemmContext* contexts, const int* built, GemmType type, int M, int N, int K)
+{
+    const GemmTypeInfo* info = gemm_type_info(type);
+    long long work = (long long)M * N * K;
+    void* A = malloc((size_t)M * K * info->elem_size);
+    void* B = malloc((size_t)K * N * info->elem_size);
+    void* C = malloc((size_t)M * N * info->out_size);
+    void* expected = NULL;
+    double kernel_s, end_to_end_s;
+    int v;
+
+    gemm_type_fill_random(type, A, (size_t)M * K, -2, 2);
+    gemm_type_fill_random(type, B, (size_t)K * N, -2, 2);
+
+    if (work <= MAX_CPU_WORK) {
+        double start = wall_time();
+        cpu_gemm(type, M, N, K, 1.0, A, K, 1, B, N, 1, 0.0, C, N, 1, 0);
+        double seconds = wall_time() - start;
+        report(file, "cpu", type, M, N, K, seconds, seconds, "-");
+        if (work <= MAX_VERIFIED_WORK) {
+            expected = C;
+            C = malloc((size_t)M * N * info->out_size);
+        }
+    }
+
+    for (v = 0; v < N_VARIANTS; ++v) {
+        if (!built[v]) continue;
+        if (run_device(&contexts[v], M, N, K, A, B, C, &kernel_s, &end_to_end_s) != 0) {
+            printf("%-8s %-6s %5dx%5dx%5d  failed\n", variants[v].name, info->name, M, N, K);
+            continue;
+        }
+        const char* verified = "-";
+        if (expected != NULL) {
+            verified = gemm_compare(type, expected, C, (size_t)M * N, K) == 0 ? "yes" : "no";
+        }
+        report(file, variants[v].name, type, M, N, K, kernel_s, end_to_end_s, verified);
+    }
+
+    free(A);
+    free(B);
+    free(C);
+    free(expected);
+}
+
+int gemm_benchmark(cl_context context, cl_device_id device_id, cl_command_queue command_queue,
+    GemmType type, const char* csv_path)
+{
+    GemmContext contexts[N_VARIANTS];
+    int built[N_VARIANTS];
+    FILE* file;
+    int v, n, s;
+
+    file = fopen(csv_path, "w");
+    if (file == NULL) {
+        return -1;
+    }
+    fprintf(file, "variant,type,M,N,K,kernel_s,end_to_end_s,gflops,end_to_end_gflops,bandwidth_gbs,verified\n");
+
+    for (v = 0; v < N_VARIANTS; ++v) {
+        GemmConfig config = gemm_default_config;
+
+        config.block = variants[v].block;
+        config.vector_width = variants[v].vector_width;
+        built[v] = context != NULL && gemm_init(&contexts[v], context, device_id, command_queue,
+            type, variants[v].tuned ? NULL : &config) == CL_SUCCESS;
+        if (context != NULL && !built[v]) {
+            gemm_release(&contexts[v]);
+        }
+    }
+
+    for (n = MIN_SQUARE_SIZE; n <= MAX_SQUARE_SIZE; n *= 2) {
+        benchmark_shape(file, contexts, built, type, n, n, n);
+    }
+    for (s = 0; s < (int)(sizeof(shapes) / sizeof(shapes[0])); ++s) {
+        benchmark_shape(file, contexts, built, type, shapes[s][0], shapes[s][1], shapes[s][2]);
+    }
+
+    for (v = 0; v < N_VARIANTS; ++v) {
+        if (built[v]) {
+            gemm_release(&contexts[v]);
+        }
+    }
+    fclose(file);
+    return 0;
+}
+
+/**
+ * Wall time of the work enqueued by one call, a negative value if it fails.
+ * strassen: Use gemm_strassen instead of gemm_run
+ */
+static double time_product(GemmContext* gemm, BufferPool* pool, const GemmMatrix* A, const GemmMatrix* B,
+    GemmMatrix* C, int strassen, int cutoff)
+{
+    double best = -1.0;
+    int r;
+
+    // The first run is a warm-up, which also fills the pool
+    for (r = 0; r <= REPEATS; ++r) {
+        double start = wall_time();
+        cl_int err = strassen
+            ? gemm_strassen(gemm, pool, A, B, C, cutoff)
+            : gemm_run(gemm, GEMM_NO_TRANS, GEMM_NO_TRANS, 1.0, A, B, 0.0, C, NULL);
+        if (err != CL_SUCCESS || clFinish(gemm->command_queue) != CL_SUCCESS) {
+            return -1.0;
+        }
+        double seconds = wall_time() - start;
+        if (r > 0 && (best < 0.0 || seconds < best)) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+// Unit roundoffs of half and float, and the largest finite half
+#define HALF_UNIT_ROUNDOFF (1.0 / 2048.0)
+#define FLOAT_UNIT_ROUNDOFF (1.0 / 16777216.0)
+#define HALF_MAX_VALUE 65504.0
+
+/**
+ * Worst case of the elements of a half matrix: largest magnitude and absolute error.
+ */
+typedef struct {
+    double max;
+    double error;
+} HalfBound;
+
+/**
+ * Bound of x + y rounded to half, raising peak to its magnitude.
+ */
+static HalfBound half_add_bound(HalfBound x, HalfBound y, double* peak)
+{
+    HalfBound r;
+
+    r.max = x.max + y.max;
+    r.error = x.error + y.error + HALF_UNIT_ROUNDOFF * r.max;
+    if (r.max > *peak) {
+        *peak = r.max;
+    }
+    return r;
+}
+
+static HalfBound half_max_bound(HalfBound x, HalfBound y)
+{
+    HalfBound r;
+
+    r.max = x.max > y.max ? x.max : y.max;
+    r.error = x.error > y.error ? x.error : y.error;
+    return r;
+}
+
+/**
+ * Bound of C = A * B computed by gemm_strassen on n x n half matrices,
+ * following its recursion: every S, T, M and U temporary is rounded to half,
+ * the classical products accumulate in float. peak is raised to the largest
+ * magnitude of any temporary; once it passes the half range the temporaries
+ * may overflow, no bound exists and the search stops.
+ */
+static HalfBound strassen_half_bound(int n, int cutoff, HalfBound a, HalfBound b, double* peak)
+{
+    HalfBound c = { 0.0, 0.0 };
+
+    if (*peak > HALF_MAX_VALUE) {
+        return c;
+    }
+    if (n <= cutoff || n % 2 != 0) {
+        c.max = n * (a.max + a.error) * (b.max + b.error);
+        c.error = n * (a.max * b.error + b.max * a.error + a.error * b.error)
+            + (n * FLOAT_UNIT_ROUNDOFF + HALF_UNIT_ROUNDOFF) * c.max;
+        if (c.max > *peak) {
+            *peak = c.max;
+        }
+        return c;
+    }
+
+    // S1 = A21 + A22, S2 = S1 - A11, S3 = A11 - A21, S4 = A12 - S2, and the same for T
+    HalfBound s1 = half_add_bound(a, a, peak), s2 = half_add_bound(s1, a, peak);
+    HalfBound s3 = half_add_bound(a, a, peak), s4 = half_add_bound(a, s2, peak);
+    HalfBound t1 = half_add_bound(b, b, peak), t2 = half_add_bound(t1, b, peak);
+    HalfBound t3 = half_add_bound(b, b, peak), t4 = half_add_bound(b, t2, peak);
+
+    // The products that grow fastest first, so that an overflow ends the search early
+    int h = n / 2;
+    HalfBound m6 = strassen_half_bound(h, cutoff, s2, t2, peak);
+    HalfBound m3 = strassen_half_bound(h, cutoff, s4, b, peak);
+    HalfBound m4 = strassen_half_bound(h, cutoff, a, t4, peak);
+    HalfBound m5 = strassen_half_bound(h, cutoff, s1, t1, peak);
+    HalfBound m7 = strassen_half_bound(h, cutoff, s3, t3, peak);
+    HalfBound m1 = strassen_half_bound(h, cutoff, a, b, peak);
+
+    // U1 = M1 + M2, U2 = M1 + M6, U3 = U2 + M7, U4 = U2 + M5, U5 = U4 + M3, U6 = U3 - M4, U7 = U3 + M5
+    HalfBound u1 = half_add_bound(m1, m1, peak), u2 = half_add_bound(m1, m6, peak);
+    HalfBound u3 = half_add_bound(u2, m7, peak), u4 = half_add_bound(u2, m5, peak);
+    HalfBound u5 = half_add_bound(u4, m3, peak), u6 = half_add_bound(u3, m4, peak);
+    HalfBound u7 = half_add_bound(u3, m5, peak);
+    return half_max_bound(half_max_bound(u1, u5), half_max_bound(u6, u7));
+}
+
+/**
+ * Compare half Strassen results with the classical ones of n x n products of
+ * elements in [-bound, bound].
+ *
+ * Returns "yes", "no", or "unbounded" if the temporaries may overflow half
+ */
+static const char* check_strassen_half(const void* classical, const void* strassen, int n, int cutoff, double bound)
+{
+    HalfBound input = { bound, 0.0 };
+    double peak = 0.0;
+    size_t i, count = (size_t)n * n;
+
+    HalfBound c = strassen_half_bound(n, cutoff, input, input, &peak);
+    if (peak > HALF_MAX_VALUE) {
+        return "unbounded";
+    }
+    // The classical result is the exact float sum rounded once to half
+    double tolerance = c.error + HALF_UNIT_ROUNDOFF * n * bound * bound;
+    for (i = 0; i < count; ++i) {
+        double e = gemm_type_get(GEMM_HALF, classical, i, 1);
+        double a = gemm_type_get(GEMM_HALF, strassen, i, 1);
+        if (!isfinite(a) || !(fabs(e - a) <= tolerance)) {
+            return "no";
+        }
+    }
+    return "yes";
+}
+
+int gemm_strassen_benchmark(cl_context context, cl_device_id device_id, cl_command_queue command_queue,
+    GemmType type, int cutoff, const char* csv_path)
+{
+    const GemmTypeInfo* info = gemm_type_info(type);
+    GemmContext gemm;
+    BufferPool pool;
+    FILE* file;
+    int n;
+
+    file = fopen(csv_path, "w");
+    if (file == NULL) {
+        return -1;
+    }
+    fprintf(file, "type,N,cutoff,classical_s,strassen_s,speedup,verified\n");
+    if (gemm_init(&gemm, context, device_id, command_queue, type, NULL) != CL_SUCCESS) {
+        printf("GEMM initialization error!\n");
+        gemm_release(&gemm);
+        fclose(file);
+        return 0;
+    }
+    buffer_pool_init(&pool, context, command_queue);
+
+    for (n = MIN_STRASSEN_SIZE; n <= MAX_STRASSEN_SIZE; n *= 2) {
+        GemmMatrix A = { 0 }, B = { 0 }, C_classical = { 0 }, C_strassen = { 0 };
+        size_t count = (size_t)n * n;
+        void* result_classical = malloc(count * info->out_size);
+        void* result_strassen = malloc(count * info->out_size);
+
+        // Small integers keep both algorithms exact for int, float and double; half temporaries
+        // round once they pass 2048, so half is checked against a bound of that rounding.
+        // The inputs are generated on the device as only the results are compared
+        if (gemm_matrix_create(&gemm, &A, n, n, GEMM_ROW_MAJOR, 0) != CL_SUCCESS
+            || gemm_matrix_create(&gemm, &B, n, n, GEMM_ROW_MAJOR, 0) != CL_SUCCESS
+            || gemm_matrix_create(&gemm, &C_classical, n, n, GEMM_ROW_MAJOR, 1) != CL_SUCCESS
+            || gemm_matrix_create(&gemm, &C_strassen, n, n, GEMM_ROW_MAJOR, 1) != CL_SUCCESS
+            || gemm_matrix_fill_random(&gemm, &A, 1, n, -STRASSEN_INPUT_MAX, STRASSEN_INPUT_MAX) != CL_SUCCESS
+            || gemm_matrix_fill_random(&gemm, &B, 1, 2 * n + 1, -STRASSEN_INPUT_MAX, STRASSEN_INPUT_MAX)
+                != CL_SUCCESS) {
+            printf("%d: not enough device memory\n", n);
+            n = MAX_STRASSEN_SIZE;
+        } else {
+            double classical_s = time_product(&gemm, &pool, &A, &B, &C_classical, 0, cutoff);
+            double strassen_s = time_product(&gemm, &pool, &A, &B, &C_strassen, 1, cutoff);
+            const char* verified = "no";
+
+            if (classical_s > 0.0 && strassen_s > 0.0) {
+                gemm_matrix_read(&gemm, &C_classical, result_classical, CL_TRUE);
+                gemm_matrix_read(&gemm, &C_strassen, result_strassen, CL_TRUE);
+                if (type == GEMM_HALF) {
+                    verified = check_strassen_half(result_classical, result_strassen, n, cutoff,
+                        STRASSEN_INPUT_MAX);
+                } else if (gemm_compare(type, result_classical, result_strassen, count, n) == 0) {
+                    verified = "yes";
+                }
+                printf("%-6s N = %5d  classical %.6f s  Strassen-Winograd %.6f s  speedup %.3f  %s\n",
+                    info->name, n, classical_s, strassen_s, classical_s / strassen_s, verified);
+                fprintf(file, "%s,%d,%d,%.9f,%.9f,%.4f,%s\n",
+                    info->name, n, cutoff, classical_s, strassen_s, classical_s / strassen_s, verified);
+                fflush(file);
+            } else {
+                printf("%d: failed\n", n);
+            }
+        }
+
+        gemm_matrix_release(&A);
+        gemm_matrix_release(&B);
+        gemm_matrix_release(&C_classical);
+        gemm_matrix_release(&C_strassen);
+        free(result_classical);
+        free(result_strassen);
+    }
+
+    buffer_pool_release(&pool);
+    gemm_release(&gemm);
+    fclose(file);
+    return 0;
+}
+
+/**
+ * Best kernel time of an enqueued operation over the repeats, a negative value if it fails.
+ * operation: 0 to 2 for the SpMV variants, 3 for SpMM, 4 for dense GEMM
+ */
+static double time_sparse(SparseContext* sparse, GemmContext* gemm, const CsrDeviceMatrix* A, int operation,
+    int columns, cl_mem x, cl_mem y, const GemmMatrix* dense_a, const GemmMatrix* dense_b, GemmMatrix* dense_c)
+{
+    double best = -1.0;
+    int r;
+
+    for (r = 0; r <= REPEATS; ++r) {
+        cl_event event;
+        cl_int err;
+
+        if (operation < 3) {
+            err = sparse_spmv(sparse, A, (SpmvVariant)operation, x, y, &event);
+        } else if (operation == 3) {
+            err = sparse_spmm(sparse, A, columns, x, columns, y, columns, &event);
+        } else {
+            err = gemm_run(gemm, GEMM_NO_TRANS, GEMM_NO_TRANS, 1.0, dense_a, dense_b, 0.0, dense_c, &event);
+        }
+        if (err != CL_SUCCESS) {
+            return -1.0;
+        }
+        clWaitForEvents(1, &event);
+        double seconds = event_time(event, CL_PROFILING_COMMAND_END) - event_time(event, CL_PROFILING_COMMAND_START);
+        clReleaseEvent(event);
+        if (r > 0 && (best < 0.0 || seconds < best)) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+int sparse_benchmark(cl_context context, cl_device_id device_id, cl_command_queue command_queue,
+    GemmType type, const CsrMatrix* matrix, int columns)
+{
+    const GemmTypeInfo* info = gemm_type_info(type);
+    CsrRowStats stats = csr_row_stats(matrix);
+    size_t dense_b_count = (size_t)matrix->cols * columns;
+    size_t dense_c_count = (size_t)matrix->rows * columns;
+    void* x = malloc((size_t)matrix->cols * info->elem_size);
+    void* y = malloc((size_t)matrix->rows * info->out_size);
+    void* expected_y = malloc((size_t)matrix->rows * info->out_size);
+    void* B = malloc(dense_b_count * info->elem_size);
+    void* C = malloc(dense_c_count * info->out_size);
+    void* expected_c = malloc(dense_c_count * info->out_size);
+    SparseContext sparse;
+    CsrDeviceMatrix device_matrix = { 0 };
+    cl_mem x_buffer = NULL, y_buffer = NULL, b_buffer = NULL, c_buffer = NULL;
+    cl_int err;
+    int v;
+
+    printf("%d x %d, %d nonzeros (%.3f%%), row length mean %.1f max %d: %s",
+        matrix->rows, matrix->cols, matrix->nnz, 100.0 * matrix->nnz / ((double)matrix->rows * matrix->cols),
+        stats.mean_row_length, stats.max_row_length, spmv_variant_name(stats.variant));
+    if (stats.variant == SPMV_VECTOR) {
+        printf(" (%d lanes)", stats.lanes);
+    }
+    printf("\n");
+
+    gemm_type_fill_random(type, x, matrix->cols, -2, 2);
+    gemm_type_fill_random(type, B, dense_b_count, -2, 2);
+    double start = wall_time();
+    csr_spmv_cpu(type, matrix, x, expected_y);
+    printf("CPU SpMV: %.6f s\n", wall_time() - start);
+    start = wall_time();
+    csr_spmm_cpu(type, matrix, columns, B, expected_c);
+    printf("CPU SpMM (%d columns): %.6f s\n", columns, wall_time() - start);
+    if (context == NULL) {
+        free(x);
+        free(y);
+        free(expected_y);
+        free(B);
+        free(C);
+        free(expected_c);
+        return 0;
+    }
+
+    err = sparse_init(&sparse, context, device_id, command_queue, type);
+    if (err == CL_SUCCESS) {
+        err = csr_device_create(&sparse, matrix, &device_matrix);
+    }
+    if (err == CL_SUCCESS) {
+        x_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+            (size_t)matrix->cols * info->elem_size, x, &err);
+    }
+    if (err == CL_SUCCESS) {
+        y_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY, (size_t)matrix->rows * info->out_size, NULL, &err);
+    }
+    if (err == CL_SUCCESS) {
+        b_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+            dense_b_count * info->elem_size, B, &err);
+    }
+    if (err == CL_SUCCESS) {
+        c_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY, dense_c_count * info->out_size, NULL, &err);
+    }
+
+    // Useful work: one multiply-add per nonzero (and column); traffic: the CSR arrays, x and y once
+    double flops = 2.0 * matrix->nnz;
+    double bytes = (double)matrix->nnz * (info->elem_size + sizeof(int)) + (matrix->rows + 1.0) * sizeof(int)
+        + (double)matrix->cols * info->elem_size + (double)matrix->rows * info->out_size;
+    for (v = SPMV_SCALAR; err == CL_SUCCESS && v <= SPMV_GROUP; ++v) {
+        double seconds = time_sparse(&sparse, NULL, &device_matrix, v, 0, x_buffer, y_buffer, NULL, NULL, NULL);
+        if (seconds < 0.0) {
+            printf("SpMV %s: failed\n", spmv_variant_name(v));
+            continue;
+        }
+        clEnqueueReadBuffer(command_queue, y_buffer, CL_TRUE, 0, (size_t)matrix->rows * info->out_size, y, 0, NULL, NULL);
+        printf("SpMV %-6s: %.6f s  %.2f GFLOPS  %.2f GB/s  %s%s\n", spmv_variant_name(v), seconds,
+            flops / seconds / 1e9, bytes / seconds / 1e9,
+            gemm_compare(type, expected_y, y, matrix->rows, stats.max_row_length) == 0 ? "verified" : "MISMATCH",
+            v == (int)device_matrix.stats.variant ? " (selected)" : "");
+    }
+    if (err == CL_SUCCESS) {
+        double seconds = time_sparse(&sparse, NULL, &device_matrix, 3, columns, b_buffer, c_buffer, NULL, NULL, NULL);
+        if (seconds < 0.0) {
+            printf("SpMM: failed\n");
+        } else {
+            clEnqueueReadBuffer(command_queue, c_buffer, CL_TRUE, 0, dense_c_count * info->out_size, C, 0, NULL, NULL);
+            printf("SpMM (%d columns): %.6f s  %.2f GFLOPS  %s\n", columns, seconds, flops * columns / seconds / 1e9,
+                gemm_compare(type, expected_c, C, dense_c_count, stats.max_row_length) == 0 ? "verified" : "MISMATCH");
+        }
+    }
+
+    // The dense product of the same matrices, as long as A fits comfortably
+    if (err == CL_SUCCESS && (long long)matrix->rows * matrix->cols <= MAX_DENSE_ELEMENTS) {
+        GemmContext gemm;
+        GemmMatrix dense_a = { 0 }, dense_b = { 0 }, dense_c = { 0 };
+        void* host_a = calloc((size_t)matrix->rows * matrix->cols, info->elem_size);
+        int i, k;
+
+        for (i = 0; i < matrix->rows; ++i) {
+            for (k = matrix->row_ptr[i]; k < matrix->row_ptr[i + 1]; ++k) {
+                gemm_type_set(type, host_a, (size_t)i * matrix->cols + matrix->col_idx[k],
+                    gemm_type_get(type, matrix->values, k, 0), 0);
+            }
+        }
+        if (gemm_init(&gemm, context, device_id, command_queue, type, NULL) == CL_SUCCESS
+            && gemm_matrix_create(&gemm, &dense_a, matrix->rows, matrix->cols, GEMM_ROW_MAJOR, 0) == CL_SUCCESS
+            && gemm_matrix_create(&gemm, &dense_b, matrix->cols, columns, GEMM_ROW_MAJOR, 0) == CL_SUCCESS
+            && gemm_matrix_create(&gemm, &dense_c, matrix->rows, columns, GEMM_ROW_MAJOR, 1) == CL_SUCCESS
+            && gemm_matrix_write(&gemm, &dense_a, host_a, CL_TRUE) == CL_SUCCESS
+            && gemm_matrix_write(&gemm, &dense_b, B, CL_TRUE) == CL_SUCCESS) {
+            double seconds = time_sparse(NULL, &gemm, NULL, 4, 0, NULL, NULL, &dense_a, &dense_b, &dense_c);
+            if (seconds > 0.0) {
+                printf("Dense GEMM (%d columns): %.6f s\n", columns, seconds);
+            }
+        }
+        gemm_matrix_release(&dense_a);
+        gemm_matrix_release(&dense_b);
+        gemm_matrix_release(&dense_c);
+        gemm_release(&gemm);
+        free(host_a);
+    }
+
+    if (err == GEMM_TYPE_UNSUPPORTED) {
+        printf("The device does not support %s matrices (%s missing)!\n", info->name, info->extension);
+    } else if (err != CL_SUCCESS) {
+        printf("Sparse kernel error! Code: %d\n", err);
+    }
+    if (c_buffer != NULL) {
+        clReleaseMemObject(c_buffer);
+    }
+    if (b_buffer != NULL) {
+        clReleaseMemObject(b_buffer);
+    }
+    if (y_buffer != NULL) {
+        clReleaseMemObject(y_buffer);
+    }
+    if (x_buffer != NULL) {
+        clReleaseMemObject(x_buffer);
+    }
+    csr_device_release(&device_matrix);
+    sparse_release(&sparse);
+    free(x);
+    free(y);
+    free(expected_y);
+    free(B);
+    free(C);
+    free(expected_c);
+    return 0;
+}
+
+/**
+ * Best kernel time of a transpose (copy = 0) or a buffer copy of the same size (copy = 1).
+ */
+static double time_transpose(GemmContext* gemm, const GemmMatrix* X, GemmMatrix* Y, int copy)
+{
+    size_t size = (size_t)X->rows * X->cols * gemm_matrix_elem_size(gemm, X);
+    double best = -1.0;
+    int r;
+
+    for (r = 0; r <= REPEATS; ++r) {
+        cl_event event;
+        cl_int err = copy
+            ? clEnqueueCopyBuffer(gemm->command_queue, X->buffer, Y->buffer, 0, 0, size, 0, NULL, &event)
+            : gemm_transpose(gemm, X, Y, &event);
+        if (err != CL_SUCCESS) {
+            return -1.0;
+        }
+        clWaitForEvents(1, &event);
+        double seconds = event_time(event, CL_PROFILING_COMMAND_END) - event_time(event, CL_PROFILING_COMMAND_START);
+        clReleaseEvent(event);
+        if (r > 0 && (best < 0.0 || seconds < best)) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+int gemm_transpose_benchmark(cl_context context, cl_device_id device_id, cl_command_queue command_queue,
+    GemmType type, const char* csv_path)
+{
+    const GemmTypeInfo* info = gemm_type_info(type);
+    GemmContext gemm;
+    FILE* file;
+    int s;
+
+    file = fopen(csv_path, "w");
+    if (file == NULL) {
+        return -1;
+    }
+    fprintf(file, "type,rows,cols,transpose_s,transpose_gbs,copy_s,copy_gbs,copy_fraction,verified\n");
+    if (gemm_init(&gemm, context, device_id, command_queue, type, NULL) != CL_SUCCESS) {
+        printf("GEMM initialization error!\n");
+        gemm_release(&gemm);
+        fclose(file);
+        return 0;
+    }
+
+    for (s = 0; s < (int)(sizeof(transpose_shapes) / sizeof(transpose_shapes[0])); ++s) {
+        int rows = transpose_shapes[s][0];
+        int cols = transpose_shapes[s][1];
+        size_t count = (size_t)rows * cols;
+        GemmMatrix X = { 0 }, Y = { 0 };
+        void* host_x = malloc(count * info->elem_size);
+        void* host_y = malloc(count * info->elem_size);
+
+        if (gemm_matrix_create(&gemm, &X, rows, cols, GEMM_ROW_MAJOR, 0) != CL_SUCCESS
+            || gemm_matrix_create(&gemm, &Y, cols, rows, GEMM_ROW_MAJOR, 0) != CL_SUCCESS
+            || gemm_matrix_fill_random(&gemm, &X, 1, s, -100, 100) != CL_SUCCESS
+            || gemm_matrix_read(&gemm, &X, host_x, CL_TRUE) != CL_SUCCESS) {
+            printf("%d x %d: not enough device memory\n", rows, cols);
+        } else {
+            double copy_s = time_transpose(&gemm, &X, &Y, 1);
+            double transpose_s = time_transpose(&gemm, &X, &Y, 0);
+            // Every element is read and written once
+            double bytes = 2.0 * count * info->elem_size;
+            const char* verified = "no";
+            size_t i, mismatches = 0;
+
+            if (copy_s > 0.0 && transpose_s > 0.0) {
+                gemm_matrix_read(&gemm, &Y, host_y, CL_TRUE);
+                for (i = 0; i < count; ++i) {
+                    size_t row = i / cols;
+                    size_t col = i % cols;
+                    if (gemm_type_get(type, host_x, i, 0) != gemm_type_get(type, host_y, col * rows + row, 0)) {
+                        ++mismatches;
+                    }
+                }
+                verified = mismatches == 0 ? "yes" : "no";
+                printf("%-6s %5d x %-5d  transpose %.2f GB/s  copy %.2f GB/s  %.0f%% of copy  %s\n",
+                    info->name, rows, cols, bytes / transpose_s / 1e9, bytes / copy_s / 1e9,
+                    100.0 * copy_s / transpose_s, verified);
+                fprintf(file, "%s,%d,%d,%.9f,%.3f,%.9f,%.3f,%.4f,%s\n", info->name, rows, cols,
+                    transpose_s, bytes / transpose_s / 1e9, copy_s, bytes / copy_s / 1e9, copy_s / transpose_s, verified);
+                fflush(file);
+            } else {
+                printf("%d x %d: failed\n", rows, cols);
+            }
+        }
+
+        gemm_matrix_release(&X);
+        gemm_matrix_release(&Y);
+        free(host_x);
+        free(host_y);
+    }
+
+    gemm_release(&gemm);
+    fclose(file);
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include "buffer_pool.h"
+
+#include <stdlib.h>
+
+void buffer_pool_init(BufferPool* pool, cl_context context, cl_command_queue command_queue)
+{
+    pool->context = context;
+    pool->command_queue = command_queue;
+    pool->entries = NULL;
+    pool->count = 0;
+    pool->capacity = 0;
+}
+
+size_t buffer_pool_size_class(size_t size)
+{
+    size_t size_class = BUFFER_POOL_MIN_SIZE;
+
+    while (size_class < size) {
+        size_class *= 2;
+    }
+    return size_class;
+}
+
+/**
+ * Release the buffer of an entry, unmapping it first if it is a host buffer.
+ */
+static void release_entry(BufferPool* pool, PoolEntry* entry)
+{
+    if (entry->host != NULL) {
+        clEnqueueUnmapMemObject(pool->command_queue, entry->buffer, entry->host, 0, NULL, NULL);
+        clFinish(pool->command_queue);
+    }
+    clReleaseMemObject(entry->buffer);
+    entry->buffer = NULL;
+    entry->host = NULL;
+}
+
+/**
+ * Create the buffer of an entry, mapping it for host buffers.
+ */
+static cl_int create_entry(BufferPool* pool, PoolEntry* entry, size_t size, int host)
+{
+    cl_int err;
+
+    entry->size = size;
+    entry->host = NULL;
+    entry->buffer = clCreateBuffer(pool->context,
+        CL_MEM_READ_WRITE | (host ? CL_MEM_ALLOC_HOST_PTR : 0), size, NULL, &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    if (host) {
+        entry->host = clEnqueueMapBuffer(pool->command_queue, entry->buffer, CL_TRUE,
+            CL_MAP_READ | CL_MAP_WRITE, 0, size, 0, NULL, NULL, &err);
+        if (err != CL_SUCCESS) {
+            clReleaseMemObject(entry->buffer);
+            entry->buffer = NULL;
+        }
+    }
+    return err;
+}
+
+/**
+ * Find or make a free entry of the kind that holds size bytes and mark it as used.
+ *
+ * Returns the entry, NULL on error
+ */
+static PoolEntry* acquire_entry(BufferPool* pool, size_t size, int host, cl_int* error_code)
+{
+    int best = -1;
+    int largest = -1;
+    int i;
+
+    // Smallest free buffer that is large enough, otherwise the largest free one is grown
+    for (i = 0; i < pool->count; ++i) {
+        PoolEntry* entry = &pool->entries[i];
+        if (entry->in_use || (entry->host != NULL) != host) {
+            continue;
+        }
+        if (entry->size >= size && (best < 0 || entry->size < pool->entries[best].size)) {
+            best = i;
+        }
+        if (largest < 0 || entry->size > pool->entries[largest].size) {
+            largest = i;
+        }
+    }
+    *error_code = CL_SUCCESS;
+    if (best < 0) {
+        if (largest >= 0) {
+            best = largest;
+            release_entry(pool, &pool->entries[best]);
+        } else {
+            if (pool->count == pool->capacity) {
+                pool->capacity = pool->capacity > 0 ? 2 * pool->capacity : 16;
+                pool->entries = (PoolEntry*)realloc(pool->entries, pool->capacity * sizeof(PoolEntry));
+            }
+            best = pool->count++;
+        }
+        *error_code = create_entry(pool, &pool->entries[best], buffer_pool_size_class(size), host);
+        if (*error_code != CL_SUCCESS) {
+            // The failed slot is dropped, it may be in the middle of the array
+            pool->entries[best] = pool->entries[--pool->count];
+            return NULL;
+        }
+    }
+    pool->entries[best].in_use = 1;
+    return &pool->entries[best];
+}
+
+cl_mem buffer_pool_acquire(BufferPool* pool, size_t size, cl_int* error_code)
+{
+    PoolEntry* entry = acquire_entry(pool, size, 0, error_code);
+
+    return entry != NULL ? entry->buffer : NULL;
+}
+
+void* buffer_pool_acquire_host(BufferPool* pool, size_t size, cl_int* error_code)
+{
+    PoolEntry* entry = acquire_entry(pool, size, 1, error_code);
+
+    return entry != NULL ? entry->host : NULL;
+}
+
+void buffer_pool_give_back(BufferPool* pool, cl_mem buffer)
+{
+    int i;
+
+    if (buffer == NULL) {
+        return;
+    }
+    for (i = 0; i < pool->count; ++i) {
+        if (pool->entries[i].buffer == buffer) {
+            pool->entries[i].in_use = 0;
+            return;
+        }
+    }
+}
+
+void buffer_pool_give_back_host(BufferPool* pool, void* host)
+{
+    int i;
+
+    if (host == NULL) {
+        return;
+    }
+    for (i = 0; i < pool->count; ++i) {
+        if (pool->entries[i].host == host) {
+            pool->entries[i].in_use = 0;
+            return;
+        }
+    }
+}
+
+void buffer_pool_release(BufferPool* pool)
+{
+    int i;
+
+    for (i = 0; i < pool->count; ++i) {
+        release_entry(pool, &pool->entries[i]);
+    }
+    free(pool->entries);
+    pool->entries = NULL;
+    pool->count = 0;
+    pool->capacity = 0;
+}
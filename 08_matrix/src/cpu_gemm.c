@@ -0,0 +1,244 @@
+#include "cpu_gemm.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// Register tile (MR rows x one vector of NR columns) and cache block sizes
+#define MR 4
+#define MC 128
+#define KC 256
+#define NC 1024
+
+// SIMD vectors of 32 bytes, lowered to the widest instructions the target has
+#define VECTOR_BYTES 32
+typedef cl_int vint __attribute__((vector_size(VECTOR_BYTES)));
+typedef cl_float vfloat __attribute__((vector_size(VECTOR_BYTES)));
+typedef cl_double vdouble __attribute__((vector_size(VECTOR_BYTES)));
+
+typedef struct {
+    GemmType type;
+    int M, N, K;
+    double alpha, beta;
+    const void* A;
+    int a_rs, a_cs;
+    const void* B;
+    int b_rs, b_cs;
+    void* C;
+    int c_rs, c_cs;
+    int thread;
+    int n_threads;
+} CpuGemmTask;
+
+/**
+ * Packing, micro-kernel and block loop for one accumulator type T with vector type V.
+ * Elements of A and B are converted to T while packing, C is read and written
+ * through gemm_type_get/gemm_type_set.
+ */
+#define DEFINE_CPU_GEMM(T, V)                                                                   \
+static void pack_a_##T(const CpuGemmTask* task, int i0, int p0, int mc, int kc, T* buffer)       \
+{                                                                                               \
+    for (int ir = 0; ir < mc; ir += MR) {                                                       \
+        for (int p = 0; p < kc; ++p) {                                                          \
+            for (int i = 0; i < MR; ++i) {                                                      \
+                *buffer++ = ir + i < mc ? (T)gemm_type_get(task->type, task->A,                 \
+                    (size_t)(i0 + ir + i) * task->a_rs + (size_t)(p0 + p) * task->a_cs, 0) : 0; \
+            }                                                                                   \
+        }                                                                                       \
+    }                                                                                           \
+}                                                                                               \
+                                                                                                \
+static void pack_b_##T(const CpuGemmTask* task, int p0, int j0, int kc, int nc, T* buffer)       \
+{                                                                                               \
+    const int nr = VECTOR_BYTES / sizeof(T);                                                    \
+    for (int jr = 0; jr < nc; jr += nr) {                                                       \
+        for (int p = 0; p < kc; ++p) {                                                          \
+            for (int j = 0; j < nr; ++j) {                                                      \
+                *buffer++ = jr + j < nc ? (T)gemm_type_get(task->type, task->B,                 \
+                    (size_t)(p0 + p) * task->b_rs + (size_t)(j0 + jr + j) * task->b_cs, 0) : 0; \
+            }                                                                                   \
+        }                                                                                       \
+    }                                                                                           \
+}                                                                                               \
+                                                                                                \
+static void micro_kernel_##T(int kc, const T* a, const T* b, V c[MR])                           \
+{                                                                                               \
+    for (int i = 0; i < MR; ++i) {                                                              \
+        c[i] = (V){ 0 };                                                                        \
+    }                                                                                           \
+    for (int p = 0; p < kc; ++p) {                                                              \
+        V bv;                                                                                   \
+        memcpy(&bv, b + (size_t)p * (VECTOR_BYTES / sizeof(T)), sizeof(bv));                     \
+        for (int i = 0; i < MR; ++i) {                                                          \
+            c[i] += a[p * MR + i] * bv;                                                         \
+        }                                                                                       \
+    }                                                                                           \
+}                                                                                               \
+                                                                                                \
+static void block_##T(const CpuGemmTask* task, int i0, int j0, int mc, int nc, T* a_buffer, T* b_buffer) \
+{                                                                                               \
+    const int nr = VECTOR_BYTES / sizeof(T);                                                    \
+    T alpha = (T)task->alpha;                                                                   \
+    for (int p0 = 0; p0 < task->K; p0 += KC) {                                                  \
+        int kc = task->K - p0 < KC ? task->K - p0 : KC;                                         \
+        T beta = p0 == 0 ? (T)task->beta : 1;                                                   \
+        pack_a_##T(task, i0, p0, mc, kc, a_buffer);                                             \
+        pack_b_##T(task, p0, j0, kc, nc, b_buffer);                                             \
+        for (int jr = 0; jr < nc; jr += nr) {                                                   \
+            for (int ir = 0; ir < mc; ir += MR) {                                               \
+                V c[MR];                                                                        \
+                micro_kernel_##T(kc, a_buffer + (size_t)ir * kc, b_buffer + (size_t)jr * kc, c); \
+                for (int i = 0; i < MR && ir + i < mc; ++i) {                                   \
+                    for (int j = 0; j < nr && jr + j < nc; ++j) {                               \
+                        size_t index = (size_t)(i0 + ir + i) * task->c_rs                       \
+                            + (size_t)(j0 + jr + j) * task->c_cs;                               \
+                        T value = alpha * c[i][j];                                              \
+                        if (beta != 0) {                                                        \
+                            value += beta * (T)gemm_type_get(task->type, task->C, index, 1);    \
+                        }                                                                       \
+                        gemm_type_set(task->type, task->C, index, value, 1);                    \
+                    }                                                                           \
+                }                                                                               \
+            }                                                                                   \
+        }                                                                                       \
+    }                                                                                           \
+}
+
+DEFINE_CPU_GEMM(cl_int, vint)
+DEFINE_CPU_GEMM(cl_float, vfloat)
+DEFINE_CPU_GEMM(cl_double, vdouble)
+
+/**
+ * Compute the MC x NC blocks of C assigned to one thread (round robin).
+ */
+static void* cpu_gemm_thread(void* arg)
+{
+    const CpuGemmTask* task = (const CpuGemmTask*)arg;
+    int n_row_blocks = (task->M + MC - 1) / MC;
+    int n_col_blocks = (task->N + NC - 1) / NC;
+    // Room for the largest (double) packed panels including the padding of the last sliver
+    void* a_buffer = malloc((size_t)(MC + MR) * KC * sizeof(cl_double));
+    void* b_buffer = malloc((size_t)(NC + VECTOR_BYTES) * KC * sizeof(cl_double));
+    int block;
+
+    for (block = task->thread; block < n_row_blocks * n_col_blocks; block += task->n_threads) {
+        int i0 = block / n_col_blocks * MC;
+        int j0 = block % n_col_blocks * NC;
+        int mc = task->M - i0 < MC ? task->M - i0 : MC;
+        int nc = task->N - j0 < NC ? task->N - j0 : NC;
+
+        switch (task->type) {
+        case GEMM_FLOAT:
+        case GEMM_HALF:
+            block_cl_float(task, i0, j0, mc, nc, (cl_float*)a_buffer, (cl_float*)b_buffer);
+            break;
+        case GEMM_DOUBLE:
+            block_cl_double(task, i0, j0, mc, nc, (cl_double*)a_buffer, (cl_double*)b_buffer);
+            break;
+        default:
+            block_cl_int(task, i0, j0, mc, nc, (cl_int*)a_buffer, (cl_int*)b_buffer);
+            break;
+        }
+    }
+    free(a_buffer);
+    free(b_buffer);
+    return NULL;
+}
+
+int cpu_count(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
+
+void cpu_gemm(GemmType type, int M, int N, int K, double alpha,
+    const void* A, int a_row_stride, int a_col_stride,
+    const void* B, int b_row_stride, int b_col_stride,
+    double beta, void* C, int c_row_stride, int c_col_stride, int n_threads)
+{
+    int n_blocks = ((M + MC - 1) / MC) * ((N + NC - 1) / NC);
+    CpuGemmTask* tasks;
+    pthread_t* threads;
+    int t;
+
+    if (n_threads < 1) {
+        n_threads = cpu_count();
+    }
+    if (n_threads > n_blocks) {
+        n_threads = n_blocks;
+    }
+    tasks = (CpuGemmTask*)malloc(n_threads * sizeof(CpuGemmTask));
+    threads = (pthread_t*)malloc(n_threads * sizeof(pthread_t));
+    for (t = 0; t < n_threads; ++t) {
+        CpuGemmTask task = {
+            type, M, N, K, alpha, beta,
+            A, a_row_stride, a_col_stride,
+            B, b_row_stride, b_col_stride,
+            C, c_row_stride, c_col_stride,
+            t, n_threads
+        };
+        tasks[t] = task;
+    }
+    // The calling thread takes the first share
+    for (t = 1; t < n_threads; ++t) {
+        pthread_create(&threads[t], NULL, cpu_gemm_thread, &tasks[t]);
+    }
+    if (n_threads > 0) {
+        cpu_gemm_thread(&tasks[0]);
+    }
+    for (t = 1; t < n_threads; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+    free(tasks);
+    free(threads);
+}
+
+size_t gemm_compare(GemmType type, const void* expected, const void* actual, size_t n, int K)
+{
+    double tolerance;
+    size_t mismatches = 0;
+    size_t size = gemm_type_info(type)->out_size;
+    size_t i;
+
+    switch (type) {
+    case GEMM_FLOAT:
+        tolerance = 1e-6 * K;
+        break;
+    case GEMM_DOUBLE:
+        tolerance = 1e-13 * K;
+        break;
+    case GEMM_HALF:
+        // Float sums of the small integer inputs are exact, only the half store rounds: two half ulps
+        tolerance = 2.0 / 1024.0;
+        break;
+    default:
+        tolerance = 0.0;
+        break;
+    }
+    for (i = 0; i < n; ++i) {
+        double e = gemm_type_get(type, expected, i, 1);
+        double a = gemm_type_get(type, actual, i, 1);
+        // A NaN or inf only matches the bit-identical value (never for half, whose results are
+        // always finite), and a NaN difference fails the <= test
+        if (!isfinite(a) || !isfinite(e)) {
+            if (type == GEMM_HALF || memcmp((const char*)expected + i * size, (const char*)actual + i * size, size) != 0) {
+                ++mismatches;
+            }
+        } else if (!(fabs(e - a) <= tolerance * (fabs(e) > 1.0 ? fabs(e) : 1.0))) {
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
@@ -0,0 +1,235 @@
+#include "dispatch.h"
+#include "autotune.h"
+#include "cpu_gemm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Square sizes timed by the calibration
+#define MIN_CALIBRATION_SIZE 8
+#define MAX_CALIBRATION_SIZE 1024
+
+#define REPEATS 3
+
+static double wall_time(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+int gemm_crossover_load(cl_device_id device_id, GemmType type, double* crossover)
+{
+    char path[512];
+    char line[256];
+    char tag[32], type_name[32];
+    double value;
+    FILE* file;
+    int result = -1;
+
+    gemm_config_path(device_id, path, sizeof(path));
+    file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "%31s %31s %lf", tag, type_name, &value) != 3) continue;
+        if (strcmp(tag, "crossover") == 0 && strcmp(type_name, gemm_type_info(type)->name) == 0) {
+            *crossover = value;
+            result = 0;
+        }
+    }
+    fclose(file);
+    return result;
+}
+
+int gemm_crossover_save(cl_device_id device_id, GemmType type, double crossover)
+{
+    char path[512];
+    char line[256];
+    char tag[32], type_name[32];
+    char* kept = NULL;
+    size_t kept_size = 0;
+    FILE* file;
+
+    // Keep the tuned configurations and the crossovers of the other types
+    gemm_config_path(device_id, path, sizeof(path));
+    file = fopen(path, "r");
+    if (file != NULL) {
+        while (fgets(line, sizeof(line), file)) {
+            if (sscanf(line, "%31s %31s", tag, type_name) == 2 && strcmp(tag, "crossover") == 0
+                && strcmp(type_name, gemm_type_info(type)->name) == 0) continue;
+            kept = (char*)realloc(kept, kept_size + strlen(line) + 1);
+            strcpy(kept + kept_size, line);
+            kept_size += strlen(line);
+        }
+        fclose(file);
+    }
+
+    file = fopen(path, "w");
+    if (file == NULL) {
+        free(kept);
+        return -1;
+    }
+    if (kept != NULL) {
+        fputs(kept, file);
+        free(kept);
+    }
+    fprintf(file, "crossover %s %.0f\n", gemm_type_info(type)->name, crossover);
+    fclose(file);
+    return 0;
+}
+
+int gemm_dispatch_init(GemmDispatch* dispatch, GemmContext* gemm, GemmType type, int recalibrate)
+{
+    dispatch->gemm = gemm;
+    dispatch->type = type;
+    dispatch->crossover = -1.0;
+    if (gemm == NULL) {
+        return 0;
+    }
+    buffer_pool_init(&dispatch->pool, gemm->context, gemm->command_queue);
+    if (!recalibrate && gemm_crossover_load(gemm->device_id, type, &dispatch->crossover) == 0) {
+        return 0;
+    }
+    if (gemm_dispatch_calibrate(dispatch) != 0) {
+        return -1;
+    }
+    gemm_crossover_save(gemm->device_id, type, dispatch->crossover);
+    return 0;
+}
+
+Backend gemm_dispatch_backend(const GemmDispatch* dispatch, int M, int N, int K)
+{
+    double work = (double)M * N * K;
+
+    if (dispatch->gemm == NULL || dispatch->crossover < 0.0 || work < dispatch->crossover) {
+        return BACKEND_CPU;
+    }
+    return BACKEND_DEVICE;
+}
+
+/**
+ * Run the product on the device: upload, multiply and read back through pool buffers.
+ */
+static cl_int run_device(GemmDispatch* dispatch, int M, int N, int K, double alpha,
+    const void* A, const void* B, double beta, void* C)
+{
+    GemmContext* gemm = dispatch->gemm;
+    const GemmTypeInfo* info = gemm_type_info(dispatch->type);
+    GemmMatrix matrix_a = { 0 }, matrix_b = { 0 }, matrix_c = { 0 };
+    cl_int err;
+
+    matrix_a.buffer = buffer_pool_acquire(&dispatch->pool, (size_t)M * K * info->elem_size, &err);
+    matrix_b.buffer = err == CL_SUCCESS ? buffer_pool_acquire(&dispatch->pool, (size_t)K * N * info->elem_size, &err) : NULL;
+    matrix_c.buffer = err == CL_SUCCESS ? buffer_pool_acquire(&dispatch->pool, (size_t)M * N * info->out_size, &err) : NULL;
+    if (err == CL_SUCCESS) {
+        // Pool buffers are wrapped as views, the pool keeps owning them
+        matrix_a.rows = M;
+        matrix_a.cols = K;
+        matrix_a.ld = K;
+        matrix_b.rows = K;
+        matrix_b.cols = N;
+        matrix_b.ld = N;
+        matrix_c.rows = M;
+        matrix_c.cols = N;
+        matrix_c.ld = N;
+        matrix_c.is_output = 1;
+        gemm_matrix_write(gemm, &matrix_a, A, CL_FALSE);
+        gemm_matrix_write(gemm, &matrix_b, B, CL_FALSE);
+        if (beta != 0.0) {
+            gemm_matrix_write(gemm, &matrix_c, C, CL_FALSE);
+        }
+        err = gemm_run(gemm, GEMM_NO_TRANS, GEMM_NO_TRANS, alpha, &matrix_a, &matrix_b, beta, &matrix_c, NULL);
+    }
+    if (err == CL_SUCCESS) {
+        err = gemm_matrix_read(gemm, &matrix_c, C, CL_TRUE);
+    }
+    if (matrix_a.buffer != NULL) {
+        buffer_pool_give_back(&dispatch->pool, matrix_a.buffer);
+    }
+    if (matrix_b.buffer != NULL) {
+        buffer_pool_give_back(&dispatch->pool, matrix_b.buffer);
+    }
+    if (matrix_c.buffer != NULL) {
+        buffer_pool_give_back(&dispatch->pool, matrix_c.buffer);
+    }
+    return err;
+}
+
+cl_int gemm_dispatch_run(GemmDispatch* dispatch, int M, int N, int K, double alpha,
+    const void* A, const void* B, double beta, void* C, Backend* backend)
+{
+    Backend selected = gemm_dispatch_backend(dispatch, M, N, K);
+
+    if (backend != NULL) {
+        *backend = selected;
+    }
+    if (selected == BACKEND_DEVICE) {
+        return run_device(dispatch, M, N, K, alpha, A, B, beta, C);
+    }
+    cpu_gemm(dispatch->type, M, N, K, alpha, A, K, 1, B, N, 1, beta, C, N, 1, 0);
+    return CL_SUCCESS;
+}
+
+int gemm_dispatch_calibrate(GemmDispatch* dispatch)
+{
+    const GemmTypeInfo* info = gemm_type_info(dispatch->type);
+    int n, r;
+
+    // The smallest size of the run of sizes the device wins up to the largest one
+    dispatch->crossover = -1.0;
+    for (n = MIN_CALIBRATION_SIZE; n <= MAX_CALIBRATION_SIZE; n *= 2) {
+        size_t count = (size_t)n * n;
+        void* A = malloc(count * info->elem_size);
+        void* B = malloc(count * info->elem_size);
+        void* C = malloc(count * info->out_size);
+        double cpu_s = -1.0, device_s = -1.0;
+        cl_int err = CL_SUCCESS;
+
+        gemm_type_fill_seeded(dispatch->type, A, count, 1, -2, 2);
+        gemm_type_fill_seeded(dispatch->type, B, count, 2, -2, 2);
+        // The first runs are warm-ups
+        for (r = 0; r <= REPEATS && err == CL_SUCCESS; ++r) {
+            double start = wall_time();
+            cpu_gemm(dispatch->type, n, n, n, 1.0, A, n, 1, B, n, 1, 0.0, C, n, 1, 0);
+            double seconds = wall_time() - start;
+            if (r > 0 && (cpu_s < 0.0 || seconds < cpu_s)) {
+                cpu_s = seconds;
+            }
+            start = wall_time();
+            err = run_device(dispatch, n, n, n, 1.0, A, B, 0.0, C);
+            seconds = wall_time() - start;
+            if (r > 0 && (device_s < 0.0 || seconds < device_s)) {
+                device_s = seconds;
+            }
+        }
+        free(A);
+        free(B);
+        free(C);
+        if (err != CL_SUCCESS) {
+            return -1;
+        }
+
+        printf("Calibration %5d: CPU %.6f s, device %.6f s\n", n, cpu_s, device_s);
+        if (device_s < cpu_s) {
+            if (dispatch->crossover < 0.0) {
+                dispatch->crossover = (double)n * n * n;
+            }
+        } else {
+            dispatch->crossover = -1.0;
+        }
+    }
+    return 0;
+}
+
+void gemm_dispatch_release(GemmDispatch* dispatch)
+{
+    if (dispatch->gemm != NULL) {
+        buffer_pool_release(&dispatch->pool);
+    }
+    dispatch->gemm = NULL;
+}
@@ -0,0 +1,594 @@
+#include "gemm.h"
+#include "autotune.h"
+#include "kernel_loader.h"
+
+#include <stdio.h>
+#include <string.h>
+
+const GemmConfig gemm_default_config = { 4, 4, { 0, 0 }, 8 };
+
+/**
+ * Set a scalar kernel argument in the accumulator type of the element type.
+ */
+static cl_int set_scalar_arg(const GemmContext* gemm, cl_kernel kernel, cl_uint index, double value)
+{
+    cl_int int_value = (cl_int)value;
+    cl_float float_value = (cl_float)value;
+    cl_double double_value = value;
+
+    switch (gemm->type) {
+    case GEMM_FLOAT:
+    case GEMM_HALF:
+        return clSetKernelArg(kernel, index, sizeof(cl_float), &float_value);
+    case GEMM_DOUBLE:
+        return clSetKernelArg(kernel, index, sizeof(cl_double), &double_value);
+    default:
+        return clSetKernelArg(kernel, index, sizeof(cl_int), &int_value);
+    }
+}
+
+/**
+ * Strides of op(X) in elements: element (i, j) is at offset + i * row_stride + j * col_stride.
+ */
+static void matrix_strides(const GemmMatrix* matrix, GemmTranspose trans, int* row_stride, int* col_stride)
+{
+    int rs = matrix->layout == GEMM_ROW_MAJOR ? matrix->ld : 1;
+    int cs = matrix->layout == GEMM_ROW_MAJOR ? 1 : matrix->ld;
+
+    *row_stride = trans == GEMM_TRANS ? cs : rs;
+    *col_stride = trans == GEMM_TRANS ? rs : cs;
+}
+
+int gemm_size_class(int M, int N, int K)
+{
+    int size = M > N ? M : N;
+
+    size = size > K ? size : K;
+    if (size < 256) {
+        return 0;
+    }
+    return size < 1024 ? 1 : 2;
+}
+
+/**
+ * Build the program and kernels of one configuration.
+ */
+static int build_kernels(const GemmContext* gemm, GemmKernels* kernels, const GemmConfig* config)
+{
+    char options[192];
+    cl_int err;
+
+    kernels->config = *config;
+    if (gemm_type_build_options(gemm->type, gemm->device_id, options, sizeof(options) - 64) != 0) {
+        return GEMM_TYPE_UNSUPPORTED;
+    }
+    sprintf(options + strlen(options), " -D TS=%d", config->tile);
+    if (config->block > 0) {
+        sprintf(options + strlen(options), " -D RB=%d -D VW=%d", config->block, config->vector_width);
+    }
+    kernels->program = build_program(gemm->context, gemm->device_id, "kernels/matrix_mult.cl", options, &err);
+    if (kernels->program == NULL) {
+        return err;
+    }
+    kernels->kernel = clCreateKernel(kernels->program, "matrix_mult_kernel", &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    kernels->batched_kernel = clCreateKernel(kernels->program, "matrix_mult_batched_kernel", &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    kernels->add_kernel = clCreateKernel(kernels->program, "matrix_add_kernel", &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    if (config->block > 0) {
+        kernels->reg_kernel = clCreateKernel(kernels->program, "matrix_mult_reg_kernel", &err);
+    }
+    return err;
+}
+
+/**
+ * Configurations that only differ in the local size share one program.
+ */
+static int same_program(const GemmConfig* a, const GemmConfig* b)
+{
+    return a->block == b->block && a->vector_width == b->vector_width && a->tile == b->tile;
+}
+
+/**
+ * Round the first two dimensions of a global size up to multiples of the local size.
+ */
+static void round_up_global(size_t global_work_size[2], const size_t* local_work_size)
+{
+    if (local_work_size != NULL) {
+        global_work_size[0] = (global_work_size[0] + local_work_size[0] - 1) / local_work_size[0] * local_work_size[0];
+        global_work_size[1] = (global_work_size[1] + local_work_size[1] - 1) / local_work_size[1] * local_work_size[1];
+    }
+}
+
+/**
+ * Build the transpose kernels, with 16 x 16 tiles where the device allows work-groups of 256.
+ */
+static int build_transpose_kernels(GemmContext* gemm)
+{
+    static const char* names[GEMM_TRANSPOSE_KERNELS] = {
+        "transpose_uchar_kernel", "transpose_ushort_kernel", "transpose_uint_kernel", "transpose_ulong_kernel"
+    };
+    size_t max_work_group_size;
+    char options[32];
+    cl_int err;
+    int i;
+
+    err = clGetDeviceInfo(gemm->device_id, CL_DEVICE_MAX_WORK_GROUP_SIZE,
+        sizeof(max_work_group_size), &max_work_group_size, NULL);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    gemm->transpose_tile = max_work_group_size >= 256 ? 16 : 8;
+    sprintf(options, "-D TILE=%d", gemm->transpose_tile);
+    gemm->transpose_program = build_program(gemm->context, gemm->device_id, "kernels/transpose.cl", options, &err);
+    if (gemm->transpose_program == NULL) {
+        return err;
+    }
+    for (i = 0; i < GEMM_TRANSPOSE_KERNELS; ++i) {
+        gemm->transpose_kernels[i] = clCreateKernel(gemm->transpose_program, names[i], &err);
+        if (err != CL_SUCCESS) {
+            return err;
+        }
+    }
+    return CL_SUCCESS;
+}
+
+int gemm_init(GemmContext* gemm, cl_context context, cl_device_id device_id,
+    cl_command_queue command_queue, GemmType type, const GemmConfig* config)
+{
+    GemmConfig configs[GEMM_SIZE_CLASSES];
+    char options[192];
+    int i, j;
+    int err;
+
+    memset(gemm, 0, sizeof(*gemm));
+    gemm->context = context;
+    gemm->device_id = device_id;
+    gemm->command_queue = command_queue;
+    gemm->type = type;
+
+    for (i = 0; i < GEMM_SIZE_CLASSES; ++i) {
+        if (config != NULL) {
+            configs[i] = *config;
+        } else if (gemm_config_load(device_id, type, i, &configs[i]) != 0) {
+            configs[i] = gemm_default_config;
+        }
+    }
+
+    for (i = 0; i < GEMM_SIZE_CLASSES; ++i) {
+        for (j = 0; j < i && !same_program(&configs[i], &configs[j]); ++j) {
+        }
+        if (j < i) {
+            gemm->kernels[i] = gemm->kernels[j];
+            gemm->kernels[i].config = configs[i];
+            continue;
+        }
+        err = build_kernels(gemm, &gemm->kernels[i], &configs[i]);
+        if (err != CL_SUCCESS) {
+            return err;
+        }
+    }
+    err = build_transpose_kernels(gemm);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    if (gemm_type_build_options(type, device_id, options, sizeof(options)) != 0) {
+        return GEMM_TYPE_UNSUPPORTED;
+    }
+    return random_fill_init(&gemm->random, context, device_id, options);
+}
+
+void gemm_release(GemmContext* gemm)
+{
+    int i, j;
+
+    for (i = 0; i < GEMM_SIZE_CLASSES; ++i) {
+        GemmKernels* kernels = &gemm->kernels[i];
+
+        // Shared programs are released with the first class using them
+        for (j = 0; j < i && gemm->kernels[j].program != kernels->program; ++j) {
+        }
+        if (j < i) {
+            continue;
+        }
+        if (kernels->add_kernel != NULL) {
+            clReleaseKernel(kernels->add_kernel);
+        }
+        if (kernels->batched_kernel != NULL) {
+            clReleaseKernel(kernels->batched_kernel);
+        }
+        if (kernels->reg_kernel != NULL) {
+            clReleaseKernel(kernels->reg_kernel);
+        }
+        if (kernels->kernel != NULL) {
+            clReleaseKernel(kernels->kernel);
+        }
+        if (kernels->program != NULL) {
+            clReleaseProgram(kernels->program);
+        }
+    }
+    for (i = 0; i < GEMM_TRANSPOSE_KERNELS; ++i) {
+        if (gemm->transpose_kernels[i] != NULL) {
+            clReleaseKernel(gemm->transpose_kernels[i]);
+        }
+    }
+    if (gemm->transpose_program != NULL) {
+        clReleaseProgram(gemm->transpose_program);
+    }
+    if (gemm->transpose_event != NULL) {
+        clReleaseEvent(gemm->transpose_event);
+    }
+    if (gemm->scratch != NULL) {
+        clReleaseMemObject(gemm->scratch);
+    }
+    random_fill_release(&gemm->random);
+    memset(gemm, 0, sizeof(*gemm));
+}
+
+size_t gemm_matrix_elem_size(const GemmContext* gemm, const GemmMatrix* matrix)
+{
+    const GemmTypeInfo* info = gemm_type_info(gemm->type);
+
+    return matrix->is_output ? info->out_size : info->elem_size;
+}
+
+cl_int gemm_matrix_create(const GemmContext* gemm, GemmMatrix* matrix, int rows, int cols,
+    GemmLayout layout, int is_output)
+{
+    return gemm_matrix_create_batched(gemm, matrix, rows, cols, layout, is_output, 1);
+}
+
+cl_int gemm_matrix_create_batched(const GemmContext* gemm, GemmMatrix* matrix, int rows, int cols,
+    GemmLayout layout, int is_output, int batch_count)
+{
+    cl_int err;
+
+    matrix->rows = rows;
+    matrix->cols = cols;
+    matrix->layout = layout;
+    matrix->ld = layout == GEMM_ROW_MAJOR ? cols : rows;
+    matrix->offset = 0;
+    matrix->is_output = is_output;
+    matrix->owner = 1;
+    matrix->buffer = clCreateBuffer(gemm->context, CL_MEM_READ_WRITE,
+        (size_t)rows * cols * batch_count * gemm_matrix_elem_size(gemm, matrix), NULL, &err);
+    return err;
+}
+
+GemmMatrix gemm_matrix_view(const GemmMatrix* matrix, int row, int col, int rows, int cols)
+{
+    GemmMatrix view = *matrix;
+
+    view.rows = rows;
+    view.cols = cols;
+    view.owner = 0;
+    if (matrix->layout == GEMM_ROW_MAJOR) {
+        view.offset += row * matrix->ld + col;
+    } else {
+        view.offset += col * matrix->ld + row;
+    }
+    return view;
+}
+
+/**
+ * Describe the matrix as a rectangle of lines (rows for row-major, columns for column-major).
+ */
+static void matrix_rect(const GemmContext* gemm, const GemmMatrix* matrix,
+    size_t buffer_origin[3], size_t host_origin[3], size_t region[3], size_t* buffer_pitch, size_t* host_pitch)
+{
+    size_t elem_size = gemm_matrix_elem_size(gemm, matrix);
+    size_t line = matrix->layout == GEMM_ROW_MAJOR ? matrix->cols : matrix->rows;
+    size_t lines = matrix->layout == GEMM_ROW_MAJOR ? matrix->rows : matrix->cols;
+
+    buffer_origin[0] = (size_t)matrix->offset * elem_size;
+    buffer_origin[1] = 0;
+    buffer_origin[2] = 0;
+    host_origin[0] = 0;
+    host_origin[1] = 0;
+    host_origin[2] = 0;
+    region[0] = line * elem_size;
+    region[1] = lines;
+    region[2] = 1;
+    *buffer_pitch = (size_t)matrix->ld * elem_size;
+    *host_pitch = line * elem_size;
+}
+
+cl_int gemm_matrix_write(const GemmContext* gemm, GemmMatrix* matrix, const void* host, cl_bool blocking)
+{
+    size_t buffer_origin[3], host_origin[3], region[3], buffer_pitch, host_pitch;
+
+    matrix_rect(gemm, matrix, buffer_origin, host_origin, region, &buffer_pitch, &host_pitch);
+    if (buffer_pitch == host_pitch) {
+        return clEnqueueWriteBuffer(gemm->command_queue, matrix->buffer, blocking,
+            buffer_origin[0], region[0] * region[1], host, 0, NULL, NULL);
+    }
+    return clEnqueueWriteBufferRect(gemm->command_queue, matrix->buffer, blocking,
+        buffer_origin, host_origin, region, buffer_pitch, 0, host_pitch, 0, host, 0, NULL, NULL);
+}
+
+cl_int gemm_matrix_read(const GemmContext* gemm, const GemmMatrix* matrix, void* host, cl_bool blocking)
+{
+    size_t buffer_origin[3], host_origin[3], region[3], buffer_pitch, host_pitch;
+
+    matrix_rect(gemm, matrix, buffer_origin, host_origin, region, &buffer_pitch, &host_pitch);
+    if (buffer_pitch == host_pitch) {
+        return clEnqueueReadBuffer(gemm->command_queue, matrix->buffer, blocking,
+            buffer_origin[0], region[0] * region[1], host, 0, NULL, NULL);
+    }
+    return clEnqueueReadBufferRect(gemm->command_queue, matrix->buffer, blocking,
+        buffer_origin, host_origin, region, buffer_pitch, 0, host_pitch, 0, host, 0, NULL, NULL);
+}
+
+cl_int gemm_matrix_fill_random(GemmContext* gemm, GemmMatrix* matrix, int batch_count,
+    cl_ulong seed, int min, int max)
+{
+    int line = matrix->layout == GEMM_ROW_MAJOR ? matrix->cols : matrix->rows;
+    int lines = matrix->layout == GEMM_ROW_MAJOR ? matrix->rows : matrix->cols;
+
+    return random_fill(&gemm->random, gemm->command_queue, matrix->buffer, matrix->offset,
+        lines * batch_count, line, matrix->ld, seed, min, max, NULL);
+}
+
+void gemm_matrix_release(GemmMatrix* matrix)
+{
+    if (matrix->owner && matrix->buffer != NULL) {
+        clReleaseMemObject(matrix->buffer);
+    }
+    matrix->buffer = NULL;
+}
+
+cl_int gemm_run(GemmContext* gemm, GemmTranspose trans_a, GemmTranspose trans_b,
+    double alpha, const GemmMatrix* A, const GemmMatrix* B,
+    double beta, GemmMatrix* C, cl_event* event)
+{
+    int M = C->rows;
+    int N = C->cols;
+    int K = trans_a == GEMM_TRANS ? A->rows : A->cols;
+    int a_rs, a_cs, b_rs, b_cs, c_rs, c_cs;
+    const GemmKernels* kernels = &gemm->kernels[gemm_size_class(M, N, K)];
+    const GemmConfig* config = &kernels->config;
+    const size_t* local_work_size = NULL;
+    size_t local[2] = { config->local_size[0], config->local_size[1] };
+    cl_kernel kernel;
+    cl_uint arg = 0;
+
+    if ((trans_a == GEMM_TRANS ? A->cols : A->rows) != M
+        || (trans_b == GEMM_TRANS ? B->cols : B->rows) != K
+        || (trans_b == GEMM_TRANS ? B->rows : B->cols) != N) {
+        return CL_INVALID_VALUE;
+    }
+    matrix_strides(A, trans_a, &a_rs, &a_cs);
+    matrix_strides(B, trans_b, &b_rs, &b_cs);
+    matrix_strides(C, GEMM_NO_TRANS, &c_rs, &c_cs);
+    if (gemm->transpose_event != NULL) {
+        clReleaseEvent(gemm->transpose_event);
+        gemm->transpose_event = NULL;
+    }
+
+    if (local[0] > 0 && local[1] > 0) {
+        local_work_size = local;
+    }
+
+    // The register-blocked kernel needs unit column strides and whole blocks
+    if (kernels->reg_kernel != NULL && a_cs == 1 && b_cs == 1 && c_cs == 1
+        && M % config->block == 0 && N % config->block == 0 && K % 4 == 0) {
+        size_t global_work_size[2] = { M / config->block, N / config->block };
+
+        round_up_global(global_work_size, local_work_size);
+        kernel = kernels->reg_kernel;
+        clSetKernelArg(kernel, arg++, sizeof(int), &M);
+        clSetKernelArg(kernel, arg++, sizeof(int), &N);
+        clSetKernelArg(kernel, arg++, sizeof(int), &K);
+        set_scalar_arg(gemm, kernel, arg++, alpha);
+        clSetKernelArg(kernel, arg++, sizeof(cl_mem), &A->buffer);
+        clSetKernelArg(kernel, arg++, sizeof(int), &A->offset);
+        clSetKernelArg(kernel, arg++, sizeof(int), &a_rs);
+        clSetKernelArg(kernel, arg++, sizeof(cl_mem), &B->buffer);
+        clSetKernelArg(kernel, arg++, sizeof(int), &B->offset);
+        clSetKernelArg(kernel, arg++, sizeof(int), &b_rs);
+        set_scalar_arg(gemm, kernel, arg++, beta);
+        clSetKernelArg(kernel, arg++, sizeof(cl_mem), &C->buffer);
+        clSetKernelArg(kernel, arg++, sizeof(int), &C->offset);
+        clSetKernelArg(kernel, arg++, sizeof(int), &c_rs);
+        return clEnqueueNDRangeKernel(gemm->command_queue, kernel, 2, NULL,
+            global_work_size, local_work_size, 0, NULL, event);
+    }
+
+    // op(B) is copied to the scratch buffer as a row-major B^T, which the kernel reads along its rows
+    GemmMatrix transposed;
+    if (gemm->pre_transpose_b && b_rs != 1) {
+        size_t size = (size_t)K * N * gemm_matrix_elem_size(gemm, B);
+        cl_int err;
+
+        if (size > gemm->scratch_size) {
+            if (gemm->scratch != NULL) {
+                clReleaseMemObject(gemm->scratch);
+            }
+            gemm->scratch = clCreateBuffer(gemm->context, CL_MEM_READ_WRITE, size, NULL, &err);
+            gemm->scratch_size = gemm->scratch != NULL ? size : 0;
+            if (err != CL_SUCCESS) {
+                return err;
+            }
+        }
+        transposed.buffer = gemm->scratch;
+        transposed.rows = N;
+        transposed.cols = K;
+        transposed.layout = GEMM_ROW_MAJOR;
+        transposed.ld = K;
+        transposed.offset = 0;
+        transposed.is_output = B->is_output;
+        transposed.owner = 0;
+        // Both a row-major B and a transposed column-major B store op(B) as row-major K x N lines
+        GemmMatrix source = *B;
+        source.layout = GEMM_ROW_MAJOR;
+        source.rows = K;
+        source.cols = N;
+        // The caller's event only covers the GEMM kernel, the transpose gets its own
+        err = gemm_transpose(gemm, &source, &transposed, event != NULL ? &gemm->transpose_event : NULL);
+        if (err != CL_SUCCESS) {
+            return err;
+        }
+        B = &transposed;
+        b_rs = 1;
+        b_cs = K;
+    }
+
+    size_t global_work_size[2] = { M, N };
+
+    round_up_global(global_work_size, local_work_size);
+    kernel = kernels->kernel;
+    clSetKernelArg(kernel, arg++, sizeof(int), &M);
+    clSetKernelArg(kernel, arg++, sizeof(int), &N);
+    clSetKernelArg(kernel, arg++, sizeof(int), &K);
+    set_scalar_arg(gemm, kernel, arg++, alpha);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &A->buffer);
+    clSetKernelArg(kernel, arg++, sizeof(int), &A->offset);
+    clSetKernelArg(kernel, arg++, sizeof(int), &a_rs);
+    clSetKernelArg(kernel, arg++, sizeof(int), &a_cs);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &B->buffer);
+    clSetKernelArg(kernel, arg++, sizeof(int), &B->offset);
+    clSetKernelArg(kernel, arg++, sizeof(int), &b_rs);
+    clSetKernelArg(kernel, arg++, sizeof(int), &b_cs);
+    set_scalar_arg(gemm, kernel, arg++, beta);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &C->buffer);
+    clSetKernelArg(kernel, arg++, sizeof(int), &C->offset);
+    clSetKernelArg(kernel, arg++, sizeof(int), &c_rs);
+    clSetKernelArg(kernel, arg++, sizeof(int), &c_cs);
+    return clEnqueueNDRangeKernel(gemm->command_queue, kernel, 2, NULL,
+        global_work_size, local_work_size, 0, NULL, event);
+}
+
+cl_int gemm_run_batched(GemmContext* gemm, GemmTranspose trans_a, GemmTranspose trans_b,
+    double alpha, const GemmMatrix* A, int stride_a, const GemmMatrix* B, int stride_b,
+    double beta, GemmMatrix* C, int stride_c, int batch_count, cl_event* event)
+{
+    int M = C->rows;
+    int N = C->cols;
+    int K = trans_a == GEMM_TRANS ? A->rows : A->cols;
+    int a_rs, a_cs, b_rs, b_cs, c_rs, c_cs;
+    const GemmKernels* kernels = &gemm->kernels[gemm_size_class(M, N, K)];
+    size_t tile = kernels->config.tile;
+    cl_kernel kernel = kernels->batched_kernel;
+    cl_uint arg = 0;
+
+    if ((trans_a == GEMM_TRANS ? A->cols : A->rows) != M
+        || (trans_b == GEMM_TRANS ? B->cols : B->rows) != K
+        || (trans_b == GEMM_TRANS ? B->rows : B->cols) != N
+        || batch_count < 1) {
+        return CL_INVALID_VALUE;
+    }
+    // The batched kernel reads B in place, there is no scratch buffer per batch
+    if (gemm->pre_transpose_b) {
+        return CL_INVALID_VALUE;
+    }
+    matrix_strides(A, trans_a, &a_rs, &a_cs);
+    matrix_strides(B, trans_b, &b_rs, &b_cs);
+    matrix_strides(C, GEMM_NO_TRANS, &c_rs, &c_cs);
+
+    clSetKernelArg(kernel, arg++, sizeof(int), &M);
+    clSetKernelArg(kernel, arg++, sizeof(int), &N);
+    clSetKernelArg(kernel, arg++, sizeof(int), &K);
+    set_scalar_arg(gemm, kernel, arg++, alpha);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &A->buffer);
+    clSetKernelArg(kernel, arg++, sizeof(int), &A->offset);
+    clSetKernelArg(kernel, arg++, sizeof(int), &a_rs);
+    clSetKernelArg(kernel, arg++, sizeof(int), &a_cs);
+    clSetKernelArg(kernel, arg++, sizeof(int), &stride_a);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &B->buffer);
+    clSetKernelArg(kernel, arg++, sizeof(int), &B->offset);
+    clSetKernelArg(kernel, arg++, sizeof(int), &b_rs);
+    clSetKernelArg(kernel, arg++, sizeof(int), &b_cs);
+    clSetKernelArg(kernel, arg++, sizeof(int), &stride_b);
+    set_scalar_arg(gemm, kernel, arg++, beta);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &C->buffer);
+    clSetKernelArg(kernel, arg++, sizeof(int), &C->offset);
+    clSetKernelArg(kernel, arg++, sizeof(int), &c_rs);
+    clSetKernelArg(kernel, arg++, sizeof(int), &c_cs);
+    clSetKernelArg(kernel, arg++, sizeof(int), &stride_c);
+
+    // One TS x TS work-group per tile of C, the batch index is the third dimension
+    size_t local_work_size[3] = { tile, tile, 1 };
+    size_t global_work_size[3] = { M, N, batch_count };
+
+    round_up_global(global_work_size, local_work_size);
+    return clEnqueueNDRangeKernel(gemm->command_queue, kernel, 3, NULL,
+        global_work_size, local_work_size, 0, NULL, event);
+}
+
+cl_int gemm_transpose(GemmContext* gemm, const GemmMatrix* X, GemmMatrix* Y, cl_event* event)
+{
+    size_t elem_size = gemm_matrix_elem_size(gemm, X);
+    size_t tile = gemm->transpose_tile;
+    int index = elem_size == 1 ? 0 : elem_size == 2 ? 1 : elem_size == 4 ? 2 : 3;
+    cl_kernel kernel = gemm->transpose_kernels[index];
+    cl_uint arg = 0;
+
+    if (Y->rows != X->cols || Y->cols != X->rows || Y->layout != X->layout
+        || gemm_matrix_elem_size(gemm, Y) != elem_size) {
+        return CL_INVALID_VALUE;
+    }
+
+    // A column-major matrix is the row-major storage of its transpose, so the storage is transposed either way
+    int rows = X->layout == GEMM_ROW_MAJOR ? X->rows : X->cols;
+    int cols = X->layout == GEMM_ROW_MAJOR ? X->cols : X->rows;
+    clSetKernelArg(kernel, arg++, sizeof(int), &rows);
+    clSetKernelArg(kernel, arg++, sizeof(int), &cols);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &X->buffer);
+    clSetKernelArg(kernel, arg++, sizeof(int), &X->offset);
+    clSetKernelArg(kernel, arg++, sizeof(int), &X->ld);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &Y->buffer);
+    clSetKernelArg(kernel, arg++, sizeof(int), &Y->offset);
+    clSetKernelArg(kernel, arg++, sizeof(int), &Y->ld);
+
+    size_t local_work_size[2] = { tile, tile };
+    size_t global_work_size[2] = { cols, rows };
+
+    round_up_global(global_work_size, local_work_size);
+    return clEnqueueNDRangeKernel(gemm->command_queue, kernel, 2, NULL,
+        global_work_size, local_work_size, 0, NULL, event);
+}
+
+cl_int gemm_add(GemmContext* gemm, double alpha, const GemmMatrix* X, double beta, const GemmMatrix* Y,
+    GemmMatrix* Z, cl_event* event)
+{
+    int M = Z->rows;
+    int N = Z->cols;
+    int x_rs, x_cs, y_rs, y_cs, z_rs, z_cs;
+    cl_kernel kernel = gemm->kernels[0].add_kernel;
+    cl_uint arg = 0;
+
+    if (X->rows != M || X->cols != N || Y->rows != M || Y->cols != N) {
+        return CL_INVALID_VALUE;
+    }
+    matrix_strides(X, GEMM_NO_TRANS, &x_rs, &x_cs);
+    matrix_strides(Y, GEMM_NO_TRANS, &y_rs, &y_cs);
+    matrix_strides(Z, GEMM_NO_TRANS, &z_rs, &z_cs);
+
+    clSetKernelArg(kernel, arg++, sizeof(int), &M);
+    clSetKernelArg(kernel, arg++, sizeof(int), &N);
+    set_scalar_arg(gemm, kernel, arg++, alpha);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &X->buffer);
+    clSetKernelArg(kernel, arg++, sizeof(int), &X->offset);
+    clSetKernelArg(kernel, arg++, sizeof(int), &x_rs);
+    clSetKernelArg(kernel, arg++, sizeof(int), &x_cs);
+    set_scalar_arg(gemm, kernel, arg++, beta);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &Y->buffer);
+    clSetKernelArg(kernel, arg++, sizeof(int), &Y->offset);
+    clSetKernelArg(kernel, arg++, sizeof(int), &y_rs);
+    clSetKernelArg(kernel, arg++, sizeof(int), &y_cs);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &Z->buffer);
+    clSetKernelArg(kernel, arg++, sizeof(int), &Z->offset);
+    clSetKernelArg(kernel, arg++, sizeof(int), &z_rs);
+    clSetKernelArg(kernel, arg++, sizeof(int), &z_cs);
+
+    size_t global_work_size[2] = { M, N };
+    return clEnqueueNDRangeKernel(gemm->command_queue, kernel, 2, NULL,
+        global_work_size, NULL, 0, NULL, event);
+}
@@ -0,0 +1,150 @@
+#include "gemm_ooc.h"
+
+#include <math.h>
+#include <stdio.h>
+
+/**
+ * Enqueue a transfer between a rows x cols block at (row, col) of a row-major
+ * host matrix with ld columns and the start of a device matrix.
+ */
+static cl_int enqueue_block(cl_command_queue queue, const GemmContext* gemm, const GemmMatrix* matrix,
+    const void* host, int ld, int row, int col, int is_write,
+    cl_uint n_wait, const cl_event* wait_list, cl_event* event)
+{
+    size_t elem_size = gemm_matrix_elem_size(gemm, matrix);
+    size_t buffer_origin[3] = { (size_t)matrix->offset * elem_size, 0, 0 };
+    size_t host_origin[3] = { (size_t)col * elem_size, (size_t)row, 0 };
+    size_t region[3] = { (size_t)matrix->cols * elem_size, (size_t)matrix->rows, 1 };
+    size_t buffer_pitch = (size_t)matrix->ld * elem_size;
+    size_t host_pitch = (size_t)ld * elem_size;
+
+    if (is_write) {
+        return clEnqueueWriteBufferRect(queue, matrix->buffer, CL_FALSE, buffer_origin, host_origin,
+            region, buffer_pitch, 0, host_pitch, 0, host, n_wait, wait_list, event);
+    }
+    return clEnqueueReadBufferRect(queue, matrix->buffer, CL_FALSE, buffer_origin, host_origin,
+        region, buffer_pitch, 0, host_pitch, 0, (void*)host, n_wait, wait_list, event);
+}
+
+static int min_int(int a, int b)
+{
+    return a < b ? a : b;
+}
+
+cl_int gemm_out_of_core(GemmContext* gemm, int M, int N, int K,
+    double alpha, const void* A, const void* B, double beta, void* C, size_t budget)
+{
+    const GemmTypeInfo* info = gemm_type_info(gemm->type);
+    GemmMatrix a_slots[2] = { { 0 } }, b_slots[2] = { { 0 } }, c_slots[2] = { { 0 } };
+    cl_event compute_done[2] = { NULL, NULL };
+    cl_command_queue transfer_queue;
+    int slot = 0;
+    int block_index = 0;
+    int i0, j0, k0, s;
+    cl_int err = CL_SUCCESS;
+
+    if (M < 1 || N < 1 || K < 1) {
+        return CL_INVALID_VALUE;
+    }
+
+    // Two slots each of an A panel, a B panel and a C block of b x b elements
+    int b = (int)sqrt((double)budget / (4.0 * info->elem_size + 2.0 * info->out_size));
+    if (b >= 8) {
+        b -= b % 8;
+    }
+    if (b < 1) {
+        return CL_INVALID_VALUE;
+    }
+    int mb = min_int(b, M);
+    int nb = min_int(b, N);
+    int kb = min_int(b, K);
+
+    transfer_queue = clCreateCommandQueue(gemm->context, gemm->device_id, 0, &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    for (s = 0; s < 2 && err == CL_SUCCESS; ++s) {
+        err = gemm_matrix_create(gemm, &a_slots[s], mb, kb, GEMM_ROW_MAJOR, 0);
+        if (err == CL_SUCCESS) {
+            err = gemm_matrix_create(gemm, &b_slots[s], kb, nb, GEMM_ROW_MAJOR, 0);
+        }
+        if (err == CL_SUCCESS) {
+            err = gemm_matrix_create(gemm, &c_slots[s], mb, nb, GEMM_ROW_MAJOR, 1);
+        }
+    }
+
+    for (i0 = 0; i0 < M && err == CL_SUCCESS; i0 += mb) {
+        for (j0 = 0; j0 < N && err == CL_SUCCESS; j0 += nb, ++block_index) {
+            GemmMatrix c_block = gemm_matrix_view(&c_slots[block_index % 2], 0, 0, min_int(mb, M - i0), min_int(nb, N - j0));
+            cl_event c_ready = NULL;
+            cl_event last_compute = NULL;
+
+            // Blocks of C alternate between the slots, the readback of the previous one overlaps this block
+            if (beta != 0.0) {
+                err = enqueue_block(transfer_queue, gemm, &c_block, C, N, i0, j0, 1, 0, NULL, &c_ready);
+            }
+
+            for (k0 = 0; k0 < K && err == CL_SUCCESS; k0 += kb) {
+                int kc = min_int(kb, K - k0);
+                GemmMatrix a_panel = gemm_matrix_view(&a_slots[slot], 0, 0, c_block.rows, kc);
+                GemmMatrix b_panel = gemm_matrix_view(&b_slots[slot], 0, 0, kc, c_block.cols);
+                cl_event uploaded;
+                cl_event wait_list[2];
+                cl_uint n_wait = 0;
+
+                // The slot may only be overwritten once the kernel reading it has finished
+                err = enqueue_block(transfer_queue, gemm, &a_panel, A, K, i0, k0, 1,
+                    compute_done[slot] != NULL, &compute_done[slot], NULL);
+                if (err == CL_SUCCESS) {
+                    err = enqueue_block(transfer_queue, gemm, &b_panel, B, N, k0, j0, 1, 0, NULL, &uploaded);
+                }
+                if (err != CL_SUCCESS) {
+                    break;
+                }
+                clFlush(transfer_queue);
+
+                wait_list[n_wait++] = uploaded;
+                if (c_ready != NULL) {
+                    wait_list[n_wait++] = c_ready;
+                }
+                clEnqueueBarrierWithWaitList(gemm->command_queue, n_wait, wait_list, NULL);
+                clReleaseEvent(uploaded);
+
+                if (compute_done[slot] != NULL) {
+                    clReleaseEvent(compute_done[slot]);
+                }
+                err = gemm_run(gemm, GEMM_NO_TRANS, GEMM_NO_TRANS, alpha, &a_panel, &b_panel,
+                    k0 == 0 ? beta : 1.0, &c_block, &compute_done[slot]);
+                if (err != CL_SUCCESS) {
+                    compute_done[slot] = NULL;
+                    break;
+                }
+                clFlush(gemm->command_queue);
+                last_compute = compute_done[slot];
+                slot ^= 1;
+            }
+            if (c_ready != NULL) {
+                clReleaseEvent(c_ready);
+            }
+
+            // C block -> host once its last panel is done
+            if (err == CL_SUCCESS) {
+                err = enqueue_block(transfer_queue, gemm, &c_block, C, N, i0, j0, 0, 1, &last_compute, NULL);
+                clFlush(transfer_queue);
+            }
+        }
+    }
+
+    clFinish(gemm->command_queue);
+    clFinish(transfer_queue);
+    for (s = 0; s < 2; ++s) {
+        if (compute_done[s] != NULL) {
+            clReleaseEvent(compute_done[s]);
+        }
+        gemm_matrix_release(&a_slots[s]);
+        gemm_matrix_release(&b_slots[s]);
+        gemm_matrix_release(&c_slots[s]);
+    }
+    clReleaseCommandQueue(transfer_queue);
+    return err;
+}
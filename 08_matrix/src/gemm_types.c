@@ -0,0 +1,202 @@
+#include "gemm_types.h"
+#include "philox.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const GemmTypeInfo type_infos[] = {
+    { "int", sizeof(cl_int), sizeof(cl_int), "-D ELEM_T=int -D ACC_T=int", NULL },
+    { "float", sizeof(cl_float), sizeof(cl_float), "-D ELEM_T=float -D ACC_T=float", NULL },
+    { "double", sizeof(cl_double), sizeof(cl_double), "-D ELEM_T=double -D ACC_T=double -D USE_FP64", "cl_khr_fp64" },
+    { "half", sizeof(cl_half), sizeof(cl_half), "-D ELEM_T=half -D ACC_T=float -D ELEM_HALF", NULL },
+    { "int8", sizeof(cl_char), sizeof(cl_int), "-D ELEM_T=char -D ACC_T=int -D OUT_T=int", NULL }
+};
+
+const GemmTypeInfo* gemm_type_info(GemmType type)
+{
+    return &type_infos[type];
+}
+
+int gemm_type_parse(const char* name, GemmType* type)
+{
+    int i;
+
+    for (i = 0; i < (int)(sizeof(type_infos) / sizeof(type_infos[0])); ++i) {
+        if (strcmp(name, type_infos[i].name) == 0) {
+            *type = (GemmType)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int device_has_extension(cl_device_id device_id, const char* extension)
+{
+    size_t size;
+    char* extensions;
+    const char* found;
+    size_t length = strlen(extension);
+    int result = 0;
+
+    if (clGetDeviceInfo(device_id, CL_DEVICE_EXTENSIONS, 0, NULL, &size) != CL_SUCCESS) {
+        return 0;
+    }
+    extensions = (char*)malloc(size + 1);
+    clGetDeviceInfo(device_id, CL_DEVICE_EXTENSIONS, size, extensions, NULL);
+    extensions[size] = 0;
+
+    // Match whole, space separated names only
+    for (found = strstr(extensions, extension); found != NULL; found = strstr(found + 1, extension)) {
+        if ((found == extensions || found[-1] == ' ') && (found[length] == ' ' || found[length] == 0)) {
+            result = 1;
+            break;
+        }
+    }
+    free(extensions);
+    return result;
+}
+
+int gemm_type_build_options(GemmType type, cl_device_id device_id, char* options, size_t size)
+{
+    const GemmTypeInfo* info = gemm_type_info(type);
+
+    if (info->extension != NULL && !device_has_extension(device_id, info->extension)) {
+        return -1;
+    }
+    if (type == GEMM_INT8 && device_has_extension(device_id, "cl_khr_integer_dot_product")) {
+        snprintf(options, size, "%s -D USE_INT_DOT", info->options);
+    } else {
+        snprintf(options, size, "%s", info->options);
+    }
+    return 0;
+}
+
+void gemm_type_fill_random(GemmType type, void* buffer, size_t n, int min, int max)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        gemm_type_set(type, buffer, i, min + rand() % (max - min + 1), 0);
+    }
+}
+
+void gemm_type_fill_seeded(GemmType type, void* buffer, size_t n, cl_ulong seed, int min, int max)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        gemm_type_set(type, buffer, i, philox_int(seed, i, min, max), 0);
+    }
+}
+
+double gemm_type_get(GemmType type, const void* buffer, size_t i, int is_output)
+{
+    switch (type) {
+    case GEMM_INT:
+        return ((const cl_int*)buffer)[i];
+    case GEMM_FLOAT:
+        return ((const cl_float*)buffer)[i];
+    case GEMM_DOUBLE:
+        return ((const cl_double*)buffer)[i];
+    case GEMM_HALF:
+        return half_to_float(((const cl_half*)buffer)[i]);
+    case GEMM_INT8:
+        return is_output ? ((const cl_int*)buffer)[i] : ((const cl_char*)buffer)[i];
+    }
+    return 0.0;
+}
+
+void gemm_type_set(GemmType type, void* buffer, size_t i, double value, int is_output)
+{
+    switch (type) {
+    case GEMM_INT:
+        ((cl_int*)buffer)[i] = (cl_int)value;
+        break;
+    case GEMM_FLOAT:
+        ((cl_float*)buffer)[i] = (cl_float)value;
+        break;
+    case GEMM_DOUBLE:
+        ((cl_double*)buffer)[i] = value;
+        break;
+    case GEMM_HALF:
+        ((cl_half*)buffer)[i] = float_to_half((float)value);
+        break;
+    case GEMM_INT8:
+        if (is_output) {
+            ((cl_int*)buffer)[i] = (cl_int)value;
+        } else {
+            ((cl_char*)buffer)[i] = (cl_char)value;
+        }
+        break;
+    }
+}
+
+cl_half float_to_half(float value)
+{
+    unsigned int bits;
+    unsigned int sign;
+    int exponent;
+    unsigned int mantissa;
+
+    memcpy(&bits, &value, sizeof(bits));
+    sign = (bits >> 16) & 0x8000;
+    exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff) {
+        // Infinity or NaN
+        return (cl_half)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+    if (exponent >= 0x1f) {
+        return (cl_half)(sign | 0x7c00);
+    }
+    if (exponent <= 0) {
+        // Subnormal or zero
+        if (exponent < -10) {
+            return (cl_half)sign;
+        }
+        mantissa |= 0x800000;
+        unsigned int shift = (unsigned int)(14 - exponent);
+        unsigned int half_mantissa = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1) {
+            ++half_mantissa;
+        }
+        return (cl_half)(sign | half_mantissa);
+    }
+    // Round to nearest, the carry may propagate into the exponent
+    unsigned int half = sign | ((unsigned int)exponent << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000) {
+        ++half;
+    }
+    return (cl_half)half;
+}
+
+float half_to_float(cl_half value)
+{
+    unsigned int sign = ((unsigned int)value & 0x8000) << 16;
+    unsigned int exponent = ((unsigned int)value >> 10) & 0x1f;
+    unsigned int mantissa = (unsigned int)value & 0x3ff;
+    unsigned int bits;
+    float result;
+
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign;
+        } else {
+            // Normalize the subnormal value
+            exponent = 127 - 15 + 1;
+            while ((mantissa & 0x400) == 0) {
+                mantissa <<= 1;
+                --exponent;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+        }
+    } else if (exponent == 0x1f) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
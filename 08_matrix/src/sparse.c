@@ -0,0 +1,445 @@
+#include "sparse.h"
+#include "kernel_loader.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Rows of the scalar variant: short on average and without long outliers
+#define SCALAR_MAX_MEAN 4.0
+#define SCALAR_MAX_LENGTH 64
+
+// Rows longer than this on average get a whole work-group
+#define VECTOR_MAX_MEAN 64.0
+#define MAX_LANES 32
+
+#define MAX_GROUP_SIZE 256
+
+// Work-group size of the SpMM kernel
+#define SPMM_LOCAL_COLS 16
+#define SPMM_LOCAL_ROWS 8
+
+/**
+ * Entry of a matrix in coordinate format.
+ */
+typedef struct {
+    int row;
+    int col;
+    double value;
+} Triplet;
+
+static int compare_triplets(const void* a, const void* b)
+{
+    const Triplet* x = a;
+    const Triplet* y = b;
+
+    if (x->row != y->row) {
+        return x->row < y->row ? -1 : 1;
+    }
+    return (x->col > y->col) - (x->col < y->col);
+}
+
+static int compare_ints(const void* a, const void* b)
+{
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+
+    return (x > y) - (x < y);
+}
+
+int csr_load_matrix_market(const char* path, GemmType type, CsrMatrix* matrix)
+{
+    char line[1024];
+    char object[32], format[32], field[32], symmetry[32];
+    int rows, cols, entries;
+    int pattern, mirror;
+    double sign;
+    Triplet* triplets;
+    int count = 0;
+    int i;
+    FILE* file;
+
+    memset(matrix, 0, sizeof(*matrix));
+    file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    if (fgets(line, sizeof(line), file) == NULL) {
+        fclose(file);
+        return -1;
+    }
+    // The banner is case-insensitive
+    for (i = 0; line[i] != 0; ++i) {
+        line[i] = (char)tolower((unsigned char)line[i]);
+    }
+    if (sscanf(line, "%%%%matrixmarket %31s %31s %31s %31s", object, format, field, symmetry) != 4
+        || strcmp(object, "matrix") != 0 || strcmp(format, "coordinate") != 0
+        || (strcmp(field, "real") != 0 && strcmp(field, "integer") != 0 && strcmp(field, "pattern") != 0)
+        || (strcmp(symmetry, "general") != 0 && strcmp(symmetry, "symmetric") != 0
+            && strcmp(symmetry, "skew-symmetric") != 0)) {
+        fclose(file);
+        return -1;
+    }
+    pattern = strcmp(field, "pattern") == 0;
+    mirror = strcmp(symmetry, "general") != 0;
+    sign = strcmp(symmetry, "skew-symmetric") == 0 ? -1.0 : 1.0;
+
+    // Comments end at the size line
+    do {
+        if (fgets(line, sizeof(line), file) == NULL) {
+            fclose(file);
+            return -1;
+        }
+    } while (line[0] == '%');
+    if (sscanf(line, "%d %d %d", &rows, &cols, &entries) != 3 || rows < 1 || cols < 1 || entries < 0) {
+        fclose(file);
+        return -1;
+    }
+
+    // Symmetric files store one triangle, the other one is mirrored
+    triplets = malloc((size_t)entries * (mirror ? 2 : 1) * sizeof(Triplet) + 1);
+    for (i = 0; i < entries; ++i) {
+        Triplet t;
+        t.value = 1.0;
+        if (fgets(line, sizeof(line), file) == NULL
+            || (pattern ? sscanf(line, "%d %d", &t.row, &t.col) != 2
+                        : sscanf(line, "%d %d %lf", &t.row, &t.col, &t.value) != 3)
+            || t.row < 1 || t.row > rows || t.col < 1 || t.col > cols) {
+            free(triplets);
+            fclose(file);
+            return -1;
+        }
+        --t.row;
+        --t.col;
+        triplets[count++] = t;
+        if (mirror && t.row != t.col) {
+            Triplet m = { t.col, t.row, sign * t.value };
+            triplets[count++] = m;
+        }
+    }
+    fclose(file);
+
+    qsort(triplets, count, sizeof(Triplet), compare_triplets);
+    matrix->rows = rows;
+    matrix->cols = cols;
+    matrix->nnz = count;
+    matrix->row_ptr = calloc((size_t)rows + 1, sizeof(int));
+    matrix->col_idx = malloc((size_t)count * sizeof(int) + 1);
+    matrix->values = malloc((size_t)count * gemm_type_info(type)->elem_size + 1);
+    for (i = 0; i < count; ++i) {
+        ++matrix->row_ptr[triplets[i].row + 1];
+        matrix->col_idx[i] = triplets[i].col;
+        gemm_type_set(type, matrix->values, i, triplets[i].value, 0);
+    }
+    for (i = 0; i < rows; ++i) {
+        matrix->row_ptr[i + 1] += matrix->row_ptr[i];
+    }
+    free(triplets);
+    return 0;
+}
+
+void csr_random(GemmType type, int rows, int cols, double density, int min, int max, CsrMatrix* matrix)
+{
+    double mean = density * cols;
+    int nnz = 0;
+    int i, k;
+
+    matrix->rows = rows;
+    matrix->cols = cols;
+    matrix->row_ptr = malloc(((size_t)rows + 1) * sizeof(int));
+
+    // Exponentially distributed row lengths give a few long rows among many short ones
+    matrix->row_ptr[0] = 0;
+    for (i = 0; i < rows; ++i) {
+        double u = (rand() + 1.0) / ((double)RAND_MAX + 2.0);
+        int length = (int)(-mean * log(u) + 0.5);
+        length = length < cols ? length : cols;
+        matrix->row_ptr[i + 1] = matrix->row_ptr[i] + length;
+    }
+    matrix->col_idx = malloc((size_t)matrix->row_ptr[rows] * sizeof(int) + 1);
+    matrix->values = malloc((size_t)matrix->row_ptr[rows] * gemm_type_info(type)->elem_size + 1);
+
+    // Random columns of a row are sorted and duplicates dropped, so rows are compacted in place
+    for (i = 0; i < rows; ++i) {
+        int begin = matrix->row_ptr[i];
+        int end = matrix->row_ptr[i + 1];
+        int* columns = matrix->col_idx + begin;
+        int length = 0;
+
+        for (k = 0; k < end - begin; ++k) {
+            columns[k] = rand() % cols;
+        }
+        qsort(columns, end - begin, sizeof(int), compare_ints);
+        matrix->row_ptr[i] = nnz;
+        for (k = 0; k < end - begin; ++k) {
+            if (length == 0 || columns[k] != matrix->col_idx[nnz + length - 1]) {
+                matrix->col_idx[nnz + length++] = columns[k];
+            }
+        }
+        nnz += length;
+    }
+    matrix->row_ptr[rows] = nnz;
+    matrix->nnz = nnz;
+    gemm_type_fill_random(type, matrix->values, nnz, min, max);
+}
+
+void csr_release(CsrMatrix* matrix)
+{
+    free(matrix->row_ptr);
+    free(matrix->col_idx);
+    free(matrix->values);
+    memset(matrix, 0, sizeof(*matrix));
+}
+
+CsrRowStats csr_row_stats(const CsrMatrix* matrix)
+{
+    CsrRowStats stats;
+    int i;
+
+    stats.mean_row_length = (double)matrix->nnz / matrix->rows;
+    stats.max_row_length = 0;
+    for (i = 0; i < matrix->rows; ++i) {
+        int length = matrix->row_ptr[i + 1] - matrix->row_ptr[i];
+        stats.max_row_length = length > stats.max_row_length ? length : stats.max_row_length;
+    }
+
+    // Lanes: the power of two at or above the mean, at least 4 when long outliers rule out the scalar variant
+    stats.lanes = 2;
+    while (stats.lanes < MAX_LANES && stats.lanes < stats.mean_row_length) {
+        stats.lanes *= 2;
+    }
+    if (stats.mean_row_length <= SCALAR_MAX_MEAN && stats.max_row_length <= SCALAR_MAX_LENGTH) {
+        stats.variant = SPMV_SCALAR;
+    } else if (stats.mean_row_length <= VECTOR_MAX_MEAN) {
+        stats.variant = SPMV_VECTOR;
+        stats.lanes = stats.lanes < 4 ? 4 : stats.lanes;
+    } else {
+        stats.variant = SPMV_GROUP;
+    }
+    return stats;
+}
+
+const char* spmv_variant_name(SpmvVariant variant)
+{
+    switch (variant) {
+    case SPMV_SCALAR:
+        return "scalar";
+    case SPMV_VECTOR:
+        return "vector";
+    default:
+        return "group";
+    }
+}
+
+void csr_spmv_cpu(GemmType type, const CsrMatrix* A, const void* x, void* y)
+{
+    int i, k;
+
+    for (i = 0; i < A->rows; ++i) {
+        double sum = 0.0;
+        for (k = A->row_ptr[i]; k < A->row_ptr[i + 1]; ++k) {
+            sum += gemm_type_get(type, A->values, k, 0) * gemm_type_get(type, x, A->col_idx[k], 0);
+        }
+        gemm_type_set(type, y, i, sum, 1);
+    }
+}
+
+void csr_spmm_cpu(GemmType type, const CsrMatrix* A, int N, const void* B, void* C)
+{
+    double* row = malloc((size_t)N * sizeof(double));
+    int i, j, k;
+
+    for (i = 0; i < A->rows; ++i) {
+        for (j = 0; j < N; ++j) {
+            row[j] = 0.0;
+        }
+        for (k = A->row_ptr[i]; k < A->row_ptr[i + 1]; ++k) {
+            double a = gemm_type_get(type, A->values, k, 0);
+            size_t b_row = (size_t)A->col_idx[k] * N;
+            for (j = 0; j < N; ++j) {
+                row[j] += a * gemm_type_get(type, B, b_row + j, 0);
+            }
+        }
+        for (j = 0; j < N; ++j) {
+            gemm_type_set(type, C, (size_t)i * N + j, row[j], 1);
+        }
+    }
+    free(row);
+}
+
+cl_int sparse_init(SparseContext* sparse, cl_context context, cl_device_id device_id,
+    cl_command_queue command_queue, GemmType type)
+{
+    char options[192];
+    size_t max_size;
+    cl_int err;
+
+    memset(sparse, 0, sizeof(*sparse));
+    sparse->context = context;
+    sparse->device_id = device_id;
+    sparse->command_queue = command_queue;
+    sparse->type = type;
+    if (gemm_type_build_options(type, device_id, options, sizeof(options)) != 0) {
+        return GEMM_TYPE_UNSUPPORTED;
+    }
+    sparse->program = build_program(context, device_id, "kernels/sparse.cl", options, &err);
+    if (sparse->program == NULL) {
+        return err;
+    }
+    sparse->scalar_kernel = clCreateKernel(sparse->program, "csr_spmv_scalar_kernel", &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    sparse->vector_kernel = clCreateKernel(sparse->program, "csr_spmv_vector_kernel", &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    sparse->group_kernel = clCreateKernel(sparse->program, "csr_spmv_group_kernel", &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    sparse->spmm_kernel = clCreateKernel(sparse->program, "csr_spmm_kernel", &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    // The reductions need a power-of-two work-group size
+    err = clGetKernelWorkGroupInfo(sparse->group_kernel, device_id, CL_KERNEL_WORK_GROUP_SIZE,
+        sizeof(max_size), &max_size, NULL);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    sparse->group_size = MAX_GROUP_SIZE;
+    while (sparse->group_size > 1 && (size_t)sparse->group_size > max_size) {
+        sparse->group_size /= 2;
+    }
+    return CL_SUCCESS;
+}
+
+void sparse_release(SparseContext* sparse)
+{
+    if (sparse->spmm_kernel != NULL) {
+        clReleaseKernel(sparse->spmm_kernel);
+    }
+    if (sparse->group_kernel != NULL) {
+        clReleaseKernel(sparse->group_kernel);
+    }
+    if (sparse->vector_kernel != NULL) {
+        clReleaseKernel(sparse->vector_kernel);
+    }
+    if (sparse->scalar_kernel != NULL) {
+        clReleaseKernel(sparse->scalar_kernel);
+    }
+    if (sparse->program != NULL) {
+        clReleaseProgram(sparse->program);
+    }
+}
+
+cl_int csr_device_create(SparseContext* sparse, const CsrMatrix* host, CsrDeviceMatrix* matrix)
+{
+    size_t elem_size = gemm_type_info(sparse->type)->elem_size;
+    cl_int err;
+
+    memset(matrix, 0, sizeof(*matrix));
+    matrix->rows = host->rows;
+    matrix->cols = host->cols;
+    matrix->nnz = host->nnz;
+    matrix->stats = csr_row_stats(host);
+    if (matrix->stats.lanes > sparse->group_size) {
+        matrix->stats.lanes = sparse->group_size;
+    }
+
+    // Empty matrices still get valid buffers
+    matrix->row_ptr = clCreateBuffer(sparse->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+        ((size_t)host->rows + 1) * sizeof(int), host->row_ptr, &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    matrix->col_idx = clCreateBuffer(sparse->context, CL_MEM_READ_ONLY | (host->nnz > 0 ? CL_MEM_COPY_HOST_PTR : 0),
+        host->nnz > 0 ? (size_t)host->nnz * sizeof(int) : sizeof(int), host->nnz > 0 ? host->col_idx : NULL, &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    matrix->values = clCreateBuffer(sparse->context, CL_MEM_READ_ONLY | (host->nnz > 0 ? CL_MEM_COPY_HOST_PTR : 0),
+        host->nnz > 0 ? (size_t)host->nnz * elem_size : elem_size, host->nnz > 0 ? host->values : NULL, &err);
+    return err;
+}
+
+void csr_device_release(CsrDeviceMatrix* matrix)
+{
+    if (matrix->values != NULL) {
+        clReleaseMemObject(matrix->values);
+    }
+    if (matrix->col_idx != NULL) {
+        clReleaseMemObject(matrix->col_idx);
+    }
+    if (matrix->row_ptr != NULL) {
+        clReleaseMemObject(matrix->row_ptr);
+    }
+    memset(matrix, 0, sizeof(*matrix));
+}
+
+cl_int sparse_spmv(SparseContext* sparse, const CsrDeviceMatrix* A, SpmvVariant variant,
+    cl_mem x, cl_mem y, cl_event* event)
+{
+    size_t acc_size = sparse->type == GEMM_DOUBLE ? sizeof(cl_double)
+        : sparse->type == GEMM_INT || sparse->type == GEMM_INT8 ? sizeof(cl_int) : sizeof(cl_float);
+    size_t local_work_size = (size_t)sparse->group_size;
+    size_t global_work_size;
+    cl_kernel kernel;
+    int arg = 0;
+
+    switch (variant) {
+    case SPMV_SCALAR:
+        kernel = sparse->scalar_kernel;
+        global_work_size = (size_t)A->rows;
+        break;
+    case SPMV_VECTOR:
+        kernel = sparse->vector_kernel;
+        global_work_size = ((size_t)A->rows * A->stats.lanes + local_work_size - 1) / local_work_size * local_work_size;
+        break;
+    default:
+        kernel = sparse->group_kernel;
+        global_work_size = (size_t)A->rows * local_work_size;
+        break;
+    }
+    clSetKernelArg(kernel, arg++, sizeof(int), &A->rows);
+    if (variant == SPMV_VECTOR) {
+        clSetKernelArg(kernel, arg++, sizeof(int), &A->stats.lanes);
+    }
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &A->row_ptr);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &A->col_idx);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &A->values);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &x);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &y);
+    if (variant != SPMV_SCALAR) {
+        clSetKernelArg(kernel, arg++, local_work_size * acc_size, NULL);
+    }
+    return clEnqueueNDRangeKernel(sparse->command_queue, kernel, 1, NULL, &global_work_size,
+        variant == SPMV_SCALAR ? NULL : &local_work_size, 0, NULL, event);
+}
+
+cl_int sparse_spmm(SparseContext* sparse, const CsrDeviceMatrix* A, int N, cl_mem B, int ldb,
+    cl_mem C, int ldc, cl_event* event)
+{
+    size_t local_work_size[2] = { SPMM_LOCAL_COLS, SPMM_LOCAL_ROWS };
+    size_t global_work_size[2];
+    cl_kernel kernel = sparse->spmm_kernel;
+    int arg = 0;
+
+    global_work_size[0] = ((size_t)N + SPMM_LOCAL_COLS - 1) / SPMM_LOCAL_COLS * SPMM_LOCAL_COLS;
+    global_work_size[1] = ((size_t)A->rows + SPMM_LOCAL_ROWS - 1) / SPMM_LOCAL_ROWS * SPMM_LOCAL_ROWS;
+    clSetKernelArg(kernel, arg++, sizeof(int), &A->rows);
+    clSetKernelArg(kernel, arg++, sizeof(int), &N);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &A->row_ptr);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &A->col_idx);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &A->values);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &B);
+    clSetKernelArg(kernel, arg++, sizeof(int), &ldb);
+    clSetKernelArg(kernel, arg++, sizeof(cl_mem), &C);
+    clSetKernelArg(kernel, arg++, sizeof(int), &ldc);
+    return clEnqueueNDRangeKernel(sparse->command_queue, kernel, 2, NULL, global_work_size,
+        local_work_size, 0, NULL, event);
+}
@@ -0,0 +1,111 @@
+#include "strassen.h"
+
+/**
+ * Temporary row-major matrix backed by a pool buffer.
+ */
+static cl_int acquire_matrix(GemmContext* gemm, BufferPool* pool, GemmMatrix* matrix, int rows, int cols)
+{
+    cl_int err;
+
+    matrix->rows = rows;
+    matrix->cols = cols;
+    matrix->layout = GEMM_ROW_MAJOR;
+    matrix->ld = cols;
+    matrix->offset = 0;
+    matrix->is_output = 1;
+    matrix->owner = 0;
+    matrix->buffer = buffer_pool_acquire(pool,
+        (size_t)rows * cols * gemm_type_info(gemm->type)->out_size, &err);
+    return err;
+}
+
+static cl_int strassen_level(GemmContext* gemm, BufferPool* pool, const GemmMatrix* A, const GemmMatrix* B,
+    GemmMatrix* C, int cutoff)
+{
+    int M = C->rows;
+    int N = C->cols;
+    int K = A->cols;
+    GemmMatrix S[4] = { { 0 } }, T[4] = { { 0 } }, P[2] = { { 0 } };
+    cl_int err = CL_SUCCESS;
+    int i;
+
+    if (M <= cutoff || N <= cutoff || K <= cutoff || M % 2 != 0 || N % 2 != 0 || K % 2 != 0) {
+        return gemm_run(gemm, GEMM_NO_TRANS, GEMM_NO_TRANS, 1.0, A, B, 0.0, C, NULL);
+    }
+
+    int m = M / 2;
+    int n = N / 2;
+    int k = K / 2;
+    GemmMatrix A11 = gemm_matrix_view(A, 0, 0, m, k), A12 = gemm_matrix_view(A, 0, k, m, k);
+    GemmMatrix A21 = gemm_matrix_view(A, m, 0, m, k), A22 = gemm_matrix_view(A, m, k, m, k);
+    GemmMatrix B11 = gemm_matrix_view(B, 0, 0, k, n), B12 = gemm_matrix_view(B, 0, n, k, n);
+    GemmMatrix B21 = gemm_matrix_view(B, k, 0, k, n), B22 = gemm_matrix_view(B, k, n, k, n);
+    GemmMatrix C11 = gemm_matrix_view(C, 0, 0, m, n), C12 = gemm_matrix_view(C, 0, n, m, n);
+    GemmMatrix C21 = gemm_matrix_view(C, m, 0, m, n), C22 = gemm_matrix_view(C, m, n, m, n);
+
+    for (i = 0; i < 4 && err == CL_SUCCESS; ++i) {
+        err = acquire_matrix(gemm, pool, &S[i], m, k);
+        if (err == CL_SUCCESS) {
+            err = acquire_matrix(gemm, pool, &T[i], k, n);
+        }
+    }
+    for (i = 0; i < 2 && err == CL_SUCCESS; ++i) {
+        err = acquire_matrix(gemm, pool, &P[i], m, n);
+    }
+
+    // S1 = A21 + A22, S2 = S1 - A11, S3 = A11 - A21, S4 = A12 - S2
+    if (err == CL_SUCCESS) err = gemm_add(gemm, 1.0, &A21, 1.0, &A22, &S[0], NULL);
+    if (err == CL_SUCCESS) err = gemm_add(gemm, 1.0, &S[0], -1.0, &A11, &S[1], NULL);
+    if (err == CL_SUCCESS) err = gemm_add(gemm, 1.0, &A11, -1.0, &A21, &S[2], NULL);
+    if (err == CL_SUCCESS) err = gemm_add(gemm, 1.0, &A12, -1.0, &S[1], &S[3], NULL);
+    // T1 = B12 - B11, T2 = B22 - T1, T3 = B22 - B12, T4 = T2 - B21
+    if (err == CL_SUCCESS) err = gemm_add(gemm, 1.0, &B12, -1.0, &B11, &T[0], NULL);
+    if (err == CL_SUCCESS) err = gemm_add(gemm, 1.0, &B22, -1.0, &T[0], &T[1], NULL);
+    if (err == CL_SUCCESS) err = gemm_add(gemm, 1.0, &B22, -1.0, &B12, &T[2], NULL);
+    if (err == CL_SUCCESS) err = gemm_add(gemm, 1.0, &T[1], -1.0, &B21, &T[3], NULL);
+
+    // P1 = M1 = A11 B11; C11 = M2 = A12 B21; C11 = U1 = M1 + M2
+    if (err == CL_SUCCESS) err = strassen_level(gemm, pool, &A11, &B11, &P[0], cutoff);
+    if (err == CL_SUCCESS) err = strassen_level(gemm, pool, &A12, &B21, &C11, cutoff);
+    if (err == CL_SUCCESS) err = gemm_add(gemm, 1.0, &P[0], 1.0, &C11, &C11, NULL);
+    // P2 = M6 = S2 T2; P1 = U2 = M1 + M6
+    if (err == CL_SUCCESS) err = strassen_level(gemm, pool, &S[1], &T[1], &P[1], cutoff);
+    if (err == CL_SUCCESS) err = gemm_add(gemm, 1.0, &P[0], 1.0, &P[1], &P[0], NULL);
+    // P2 = M7 = S3 T3; P2 = U3 = U2 + M7
+    if (err == CL_SUCCESS) err = strassen_level(gemm, pool, &S[2], &T[2], &P[1], cutoff);
+    if (err == CL_SUCCESS) err = gemm_add(gemm, 1.0, &P[0], 1.0, &P[1], &P[1], NULL);
+    // C22 = M5 = S1 T1; P1 = U4 = U2 + M5; C22 = U7 = U3 + M5
+    if (err == CL_SUCCESS) err = strassen_level(gemm, pool, &S[0], &T[0], &C22, cutoff);
+    if (err == CL_SUCCESS) err = gemm_add(gemm, 1.0, &P[0], 1.0, &C22, &P[0], NULL);
+    if (err == CL_SUCCESS) err = gemm_add(gemm, 1.0, &P[1], 1.0, &C22, &C22, NULL);
+    // C12 = M3 = S4 B22; C12 = U5 = U4 + M3
+    if (err == CL_SUCCESS) err = strassen_level(gemm, pool, &S[3], &B22, &C12, cutoff);
+    if (err == CL_SUCCESS) err = gemm_add(gemm, 1.0, &P[0], 1.0, &C12, &C12, NULL);
+    // C21 = M4 = A22 T4; C21 = U6 = U3 - M4
+    if (err == CL_SUCCESS) err = strassen_level(gemm, pool, &A22, &T[3], &C21, cutoff);
+    if (err == CL_SUCCESS) err = gemm_add(gemm, 1.0, &P[1], -1.0, &C21, &C21, NULL);
+
+    // Later work on the in-order queue may reuse the temporaries right away
+    for (i = 0; i < 4; ++i) {
+        buffer_pool_give_back(pool, S[i].buffer);
+        buffer_pool_give_back(pool, T[i].buffer);
+    }
+    for (i = 0; i < 2; ++i) {
+        buffer_pool_give_back(pool, P[i].buffer);
+    }
+    return err;
+}
+
+cl_int gemm_strassen(GemmContext* gemm, BufferPool* pool, const GemmMatrix* A, const GemmMatrix* B,
+    GemmMatrix* C, int cutoff)
+{
+    const GemmTypeInfo* info = gemm_type_info(gemm->type);
+
+    if (info->elem_size != info->out_size || A->rows != C->rows || B->cols != C->cols || A->cols != B->rows) {
+        return CL_INVALID_VALUE;
+    }
+    if (cutoff < 1) {
+        cutoff = 1;
+    }
+    return strassen_level(gemm, pool, A, B, C, cutoff);
+}
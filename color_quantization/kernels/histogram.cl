@@ -0,0 +1,93 @@
+// Reduced-precision RGB histogram. Built with:
+//
+// HIST_BITS: bits kept per channel, the histogram has 2^(3*HIST_BITS) bins
+// LOCAL_BINS: bins of the __local sub-histogram, a power of two dividing the bin count
+// ITEM_PIXELS: pixels read by each work-item
+// MOMENTS: also sum R, G, B and R^2 + G^2 + B^2 per bin
+//
+// Work-group x reads its chunk of local size * ITEM_PIXELS pixels once into
+// private memory, then walks the bins in tiles of LOCAL_BINS: it counts the
+// pixels falling in the tile with local atomics and adds the non-zero bins
+// to the global histogram. A chunk must be small enough for the local
+// moments not to overflow (at most 22000 pixels).
+#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable
+
+#ifndef HIST_BITS
+#define HIST_BITS 5
+#endif
+#ifndef LOCAL_BINS
+#define LOCAL_BINS 4096
+#endif
+#ifndef ITEM_PIXELS
+#define ITEM_PIXELS 32
+#endif
+
+#define SIDE (1 << HIST_BITS)
+#define SHIFT (8 - HIST_BITS)
+#define BINS (SIDE * SIDE * SIDE)
+
+__kernel void histogram_kernel(
+    __global const uchar4* img,
+    int n,
+    __global ulong* count
+#ifdef MOMENTS
+    , __global ulong* sum_r,
+    __global ulong* sum_g,
+    __global ulong* sum_b,
+    __global ulong* sum_m2
+#endif
+) {
+    __local uint l_count[LOCAL_BINS];
+#ifdef MOMENTS
+    __local uint l_r[LOCAL_BINS], l_g[LOCAL_BINS], l_b[LOCAL_BINS], l_m2[LOCAL_BINS];
+#endif
+    uchar4 pixels[ITEM_PIXELS];
+    int lid = get_local_id(0), lsize = get_local_size(0);
+    int start = get_group_id(0) * lsize * ITEM_PIXELS + lid;
+    // Pixels of this work-item inside the image, read with coalesced loads
+    int items = start < n ? min((n - start + lsize - 1) / lsize, ITEM_PIXELS) : 0;
+
+    // Unrolled with constant indices so the pixels stay in registers
+    #pragma unroll
+    for (int j = 0; j < ITEM_PIXELS; ++j) {
+        pixels[j] = j < items ? img[start + j * lsize] : (uchar4)(0);
+    }
+
+    for (int first_bin = 0; first_bin < BINS; first_bin += LOCAL_BINS) {
+        for (int i = lid; i < LOCAL_BINS; i += lsize) {
+            l_count[i] = 0;
+#ifdef MOMENTS
+            l_r[i] = l_g[i] = l_b[i] = l_m2[i] = 0;
+#endif
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        #pragma unroll
+        for (int j = 0; j < ITEM_PIXELS; ++j) {
+            uint4 p = convert_uint4(pixels[j]);
+            int bin = (((p.x >> SHIFT) * SIDE + (p.y >> SHIFT)) * SIDE + (p.z >> SHIFT)) - first_bin;
+            if (j >= items || bin < 0 || bin >= LOCAL_BINS) continue;
+            atomic_inc(&l_count[bin]);
+#ifdef MOMENTS
+            atomic_add(&l_r[bin], p.x);
+            atomic_add(&l_g[bin], p.y);
+            atomic_add(&l_b[bin], p.z);
+            atomic_add(&l_m2[bin], p.x*p.x + p.y*p.y + p.z*p.z);
+#endif
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (int i = lid; i < LOCAL_BINS; i += lsize) {
+            if (!l_count[i]) continue;
+            atom_add(&count[first_bin + i], (ulong)l_count[i]);
+#ifdef MOMENTS
+            atom_add(&sum_r[first_bin + i], (ulong)l_r[i]);
+            atom_add(&sum_g[first_bin + i], (ulong)l_g[i]);
+            atom_add(&sum_b[first_bin + i], (ulong)l_b[i]);
+            atom_add(&sum_m2[first_bin + i], (ulong)l_m2[i]);
+#endif
+        }
+        // The next tile clears the tables once every work-item has flushed them
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+}
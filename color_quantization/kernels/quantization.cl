@@ -1,19 +1,27 @@
-__kernel void assign_labels(
-    __global const uchar4* img,
-    __global const float* c,
-    int k,
-    __global int* lbl,
-    int n
-) {
-    int i = get_global_id(0);
-    if (i >= n) return;
+// Built with -D K=<k> the palette size is a compile-time constant: the
+// nearest-color search is fully unrolled, the k argument is ignored and the
+// palette (at most 256 colors, 3 KiB) is read from constant memory, cached
+// and broadcast to every work-item. The generic kernels take palettes of any
+// size, which may exceed the constant buffer, so they keep them global.
+#ifdef K
+#define PALETTE_SIZE(k) K
+#define UNROLL _Pragma("unroll")
+#define PALETTE __constant
+#else
+#define PALETTE_SIZE(k) (k)
+#define UNROLL
+#define PALETTE __global
+#endif
 
-    float3 p = convert_float3(img[i].xyz);
+// Index of the palette color nearest to p
+int nearest_color(float3 p, PALETTE const float* c, int k)
+{
     int best = 0;
     float3 cp0 = (float3)(c[0], c[1], c[2]);
     float bd = dot(p - cp0, p - cp0);
 
-    for (int j = 1; j < k; ++j) {
+    UNROLL
+    for (int j = 1; j < PALETTE_SIZE(k); ++j) {
         float3 cp = (float3)(c[3*j+0], c[3*j+1], c[3*j+2]);
         float d = dot(p - cp, p - cp);
         if (d < bd) {
@@ -21,13 +29,25 @@ __kernel void assign_labels(
             best = j;
         }
     }
+    return best;
+}
 
-    lbl[i] = best;
+__kernel void assign_labels(
+    __global const uchar4* img,
+    PALETTE const float* c,
+    int k,
+    __global int* lbl,
+    int n
+) {
+    int i = get_global_id(0);
+    if (i >= n) return;
+
+    lbl[i] = nearest_color(convert_float3(img[i].xyz), c, k);
 }
 
 __kernel void map_palette(
     __global const uchar4* img,
-    __global const float* pal,
+    PALETTE const float* pal,
     int pn,
     __global uchar4* out,
     int n
@@ -35,19 +55,7 @@ __kernel void map_palette(
     int i = get_global_id(0);
     if (i >= n) return;
 
-    float3 p = convert_float3(img[i].xyz);
-    int best = 0;
-    float3 cp0 = (float3)(pal[0], pal[1], pal[2]);
-    float bd = dot(p - cp0, p - cp0);
-
-    for (int j = 1; j < pn; ++j) {
-        float3 cp = (float3)(pal[3*j+0], pal[3*j+1], pal[3*j+2]);
-        float d = dot(p - cp, p - cp);
-        if (d < bd) {
-            bd = d;
-            best = j;
-        }
-    }
+    int best = nearest_color(convert_float3(img[i].xyz), pal, pn);
 
     uchar4 res;
     res.x = (uchar)pal[3*best+0];
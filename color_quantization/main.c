@@ -4,6 +4,7 @@
 #include "include/stb_image.h"
 #include "include/stb_image_write.h"
 #include "kernel_loader.h"
+#include "quantizers.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,33 +14,186 @@
 
 #define MAX_ITERATIONS 100
 
+// Palette sizes with a program built for the size (-D K=<k>), larger ones use the generic kernels
+#define MIN_SPECIALIZED_K 2
+#define MAX_SPECIALIZED_K 256
+
+// Palette sizes timed by the bench mode, and runs per size
+static const int bench_sizes[] = { 2, 4, 8, 16, 32, 64, 128, 256 };
+#define BENCH_RUNS 10
+
+// Pixels each histogram work-item reads once and keeps in registers, and the
+// work-group size: a group chunk of 8192 pixels keeps the local moments in 32 bits
+#define HIST_ITEM_PIXELS 32
+#define HIST_GROUP 256
+
+// Local memory left to the implementation when sizing the local sub-histogram
+#define HIST_LOCAL_RESERVE 1024
+
 // Error check
 #define CL_CHECK(x) do{ cl_int err = x; if(err!=CL_SUCCESS){fprintf(stderr,"OpenCL error %d at %s:%d\n",err,__FILE__,__LINE__); exit(EXIT_FAILURE);} }while(0)
 
 static cl_context cl_ctx;
+static cl_device_id cl_dev;
 static cl_command_queue cl_q;
 static cl_program cl_prog;
 static cl_kernel k_assign, k_map;
-static const char *kernel_src;
+
+// Specialized programs and kernels, built on first use for each palette size
+static cl_program k_progs[MAX_SPECIALIZED_K + 1];
+static cl_kernel k_assigns[MAX_SPECIALIZED_K + 1], k_maps[MAX_SPECIALIZED_K + 1];
+
+// Histogram programs without and with moments, built on first use, and their work-group sizes
+static cl_program hist_progs[2];
+static cl_kernel hist_kernels[2];
+static size_t hist_group[2];
 
 static void init_opencl(void){
-    int error_code;
-    kernel_src = load_kernel_source("kernels/quantization.cl", &error_code);
+    cl_int build_err;
     cl_platform_id pf;
-    cl_device_id dev;
     CL_CHECK(clGetPlatformIDs(1,&pf,NULL));
-    CL_CHECK(clGetDeviceIDs(pf,CL_DEVICE_TYPE_GPU,1,&dev,NULL));
-    cl_ctx = clCreateContext(NULL,1,&dev,NULL,NULL,NULL);
-    cl_q = clCreateCommandQueue(cl_ctx,dev,0,NULL);
-    cl_prog = clCreateProgramWithSource(cl_ctx,1,&kernel_src,NULL,NULL);
-    CL_CHECK(clBuildProgram(cl_prog,1,&dev,"",NULL,NULL));
+    CL_CHECK(clGetDeviceIDs(pf,CL_DEVICE_TYPE_GPU,1,&cl_dev,NULL));
+    cl_ctx = clCreateContext(NULL,1,&cl_dev,NULL,NULL,NULL);
+    cl_q = clCreateCommandQueue(cl_ctx,cl_dev,CL_QUEUE_PROFILING_ENABLE,NULL);
+    cl_prog = build_program(cl_ctx,cl_dev,"kernels/quantization.cl","",&build_err);
+    CL_CHECK(build_err);
     k_assign = clCreateKernel(cl_prog,"assign_labels",NULL);
     k_map = clCreateKernel(cl_prog,"map_palette",NULL);
 }
 
-typedef struct{
-    float r, g, b;
-} Color;
+// Kernel for a palette of k colors: the specialized one for small palettes, else the generic one
+static cl_kernel palette_kernel(int k, int map){
+    if(k < MIN_SPECIALIZED_K || k > MAX_SPECIALIZED_K) return map ? k_map : k_assign;
+    if(!k_progs[k]){
+        cl_int build_err;
+        char options[32];
+        snprintf(options,sizeof(options),"-D K=%d",k);
+        k_progs[k] = build_program(cl_ctx,cl_dev,"kernels/quantization.cl",options,&build_err);
+        CL_CHECK(build_err);
+        k_assigns[k] = clCreateKernel(k_progs[k],"assign_labels",NULL);
+        k_maps[k] = clCreateKernel(k_progs[k],"map_palette",NULL);
+    }
+    return map ? k_maps[k] : k_assigns[k];
+}
+
+// Histogram kernel, with the largest local sub-histogram that fits the device local memory
+static cl_kernel histogram_kernel(int moments){
+    if(!hist_kernels[moments]){
+        cl_int build_err;
+        cl_ulong local_mem, kernel_local;
+        size_t kernel_group;
+        char options[128];
+        CL_CHECK(clGetDeviceInfo(cl_dev,CL_DEVICE_LOCAL_MEM_SIZE,sizeof(local_mem),&local_mem,NULL));
+        cl_ulong bin_bytes = (moments ? 5 : 1) * sizeof(cl_uint);
+        cl_ulong usable = local_mem > 2*HIST_LOCAL_RESERVE ? local_mem - HIST_LOCAL_RESERVE : local_mem/2;
+        int local_bins = HIST_BINS;
+        while(local_bins > 1 && local_bins*bin_bytes > usable) local_bins /= 2;
+        // Halve the sub-histogram until the built kernel, with its own local variables, fits
+        for(;;){
+            snprintf(options,sizeof(options),"-D HIST_BITS=%d -D LOCAL_BINS=%d -D ITEM_PIXELS=%d%s",
+                HIST_BITS,local_bins,HIST_ITEM_PIXELS,moments ? " -D MOMENTS" : "");
+            hist_progs[moments] = build_program(cl_ctx,cl_dev,"kernels/histogram.cl",options,&build_err);
+            CL_CHECK(build_err);
+            hist_kernels[moments] = clCreateKernel(hist_progs[moments],"histogram_kernel",&build_err);
+            CL_CHECK(build_err);
+            CL_CHECK(clGetKernelWorkGroupInfo(hist_kernels[moments],cl_dev,CL_KERNEL_LOCAL_MEM_SIZE,
+                sizeof(kernel_local),&kernel_local,NULL));
+            if(kernel_local <= local_mem || local_bins == 1) break;
+            clReleaseKernel(hist_kernels[moments]);
+            clReleaseProgram(hist_progs[moments]);
+            local_bins /= 2;
+        }
+        CL_CHECK(clGetKernelWorkGroupInfo(hist_kernels[moments],cl_dev,CL_KERNEL_WORK_GROUP_SIZE,
+            sizeof(kernel_group),&kernel_group,NULL));
+        hist_group[moments] = kernel_group < HIST_GROUP ? kernel_group : HIST_GROUP;
+    }
+    return hist_kernels[moments];
+}
+
+static int has_int64_atomics(void){
+    size_t size;
+    if(clGetDeviceInfo(cl_dev,CL_DEVICE_EXTENSIONS,0,NULL,&size)!=CL_SUCCESS) return 0;
+    char *ext = malloc(size+1);
+    int found = clGetDeviceInfo(cl_dev,CL_DEVICE_EXTENSIONS,size,ext,NULL)==CL_SUCCESS;
+    ext[size] = 0;
+    found = found && strstr(ext,"cl_khr_int64_base_atomics")!=NULL;
+    free(ext);
+    return found;
+}
+
+// Fill an initialized histogram on the device, the moments only if asked.
+// Returns the kernel time, or -1 if the device has no 64-bit atomics and the host filled it.
+static double device_histogram(const unsigned char *img, int npix, int moments, ColorHistogram *hist){
+    memset(hist->count,0,HIST_BINS*sizeof *hist->count);
+    memset(hist->r,0,HIST_BINS*sizeof *hist->r);
+    memset(hist->g,0,HIST_BINS*sizeof *hist->g);
+    memset(hist->b,0,HIST_BINS*sizeof *hist->b);
+    memset(hist->m2,0,HIST_BINS*sizeof *hist->m2);
+    if(!has_int64_atomics()){
+        histogram_add(hist,img,npix);
+        return -1;
+    }
+
+    cl_kernel kernel = histogram_kernel(moments);
+    int nbuf = moments ? 5 : 1;
+    cl_ulong zero = 0;
+    cl_mem d_img = clCreateBuffer(cl_ctx,CL_MEM_READ_ONLY|CL_MEM_COPY_HOST_PTR,(size_t)npix*4,(void*)img,NULL);
+    cl_mem d_hist[5];
+    clSetKernelArg(kernel,0,sizeof(cl_mem),&d_img);
+    clSetKernelArg(kernel,1,sizeof(int),&npix);
+    for(int i = 0; i < nbuf; i++){
+        cl_int buf_err;
+        d_hist[i] = clCreateBuffer(cl_ctx,CL_MEM_READ_WRITE,HIST_BINS*sizeof(cl_ulong),NULL,&buf_err);
+        CL_CHECK(buf_err);
+        CL_CHECK(clEnqueueFillBuffer(cl_q,d_hist[i],&zero,sizeof(zero),0,HIST_BINS*sizeof(cl_ulong),0,NULL,NULL));
+        clSetKernelArg(kernel,2+i,sizeof(cl_mem),&d_hist[i]);
+    }
+
+    cl_event ev;
+    cl_ulong t0, t1;
+    // One group per chunk, each pixel read once whatever the number of bin tiles
+    size_t lsz = hist_group[moments], chunk = lsz*HIST_ITEM_PIXELS;
+    size_t gsz = ((size_t)npix + chunk - 1)/chunk*lsz;
+    CL_CHECK(clEnqueueNDRangeKernel(cl_q,kernel,1,NULL,&gsz,&lsz,0,NULL,&ev));
+    CL_CHECK(clWaitForEvents(1,&ev));
+    clGetEventProfilingInfo(ev,CL_PROFILING_COMMAND_START,sizeof(t0),&t0,NULL);
+    clGetEventProfilingInfo(ev,CL_PROFILING_COMMAND_END,sizeof(t1),&t1,NULL);
+    clReleaseEvent(ev);
+
+    // The host counts and sums are 64-bit like the device ones, R^2 + G^2 + B^2 is kept as double
+    long long *dst[4] = { hist->count, hist->r, hist->g, hist->b };
+    for(int i = 0; i < nbuf && i < 4; i++){
+        CL_CHECK(clEnqueueReadBuffer(cl_q,d_hist[i],CL_TRUE,0,HIST_BINS*sizeof(cl_ulong),dst[i],0,NULL,NULL));
+    }
+    if(moments){
+        cl_ulong *m2 = malloc(HIST_BINS*sizeof *m2);
+        CL_CHECK(clEnqueueReadBuffer(cl_q,d_hist[4],CL_TRUE,0,HIST_BINS*sizeof(cl_ulong),m2,0,NULL,NULL));
+        for(int i = 0; i < HIST_BINS; i++) hist->m2[i] = (double)m2[i];
+        free(m2);
+    }
+    for(int i = 0; i < nbuf; i++) clReleaseMemObject(d_hist[i]);
+    clReleaseMemObject(d_img);
+    return (t1-t0)*1e-9;
+}
+
+static void release_opencl(void){
+    for(int m = 0; m < 2; m++){
+        if(!hist_progs[m]) continue;
+        clReleaseKernel(hist_kernels[m]);
+        clReleaseProgram(hist_progs[m]);
+    }
+    for(int k = MIN_SPECIALIZED_K; k <= MAX_SPECIALIZED_K; k++){
+        if(!k_progs[k]) continue;
+        clReleaseKernel(k_assigns[k]);
+        clReleaseKernel(k_maps[k]);
+        clReleaseProgram(k_progs[k]);
+    }
+    clReleaseKernel(k_assign);
+    clReleaseKernel(k_map);
+    clReleaseProgram(cl_prog);
+    clReleaseCommandQueue(cl_q);
+    clReleaseContext(cl_ctx);
+}
 
 static inline float dist2(float r1, float g1, float b1, float r2, float g2, float b2) {
     float dr = r1 - r2;
@@ -102,12 +256,36 @@ Color *load_palette(const char *paletteFile, int *paletteSizeOut) {
     return palette;
 }
 
-Color *kmeans_palette(unsigned char *img, int w, int h, int k, int max_iter) {
+// Whether a method name is one of the usage choices
+static int known_method(const char *method){
+    static const char *methods[]={"kmeans","octree","mediancut","wu","kmeans-mediancut","kmeans-wu"};
+    for(size_t i=0;i<sizeof(methods)/sizeof(methods[0]);i++)
+        if(strcmp(method,methods[i])==0) return 1;
+    return 0;
+}
+
+// Median-cut or Wu palette from the color histogram of the image, NULL for other methods
+static Color *histogram_palette(const unsigned char *img, int npix, int k, const char *method, int *pn){
+    int wu=strcmp(method,"wu")==0;
+    if(!wu && strcmp(method,"mediancut")!=0) return NULL;
+    ColorHistogram hist;
+    histogram_init(&hist);
+    device_histogram(img,npix,1,&hist);
+    Color *palette = wu ? wu_palette(&hist,k,pn) : median_cut_palette(&hist,k,pn);
+    histogram_release(&hist);
+    return palette;
+}
+
+Color *kmeans_palette(unsigned char *img, int w, int h, int k, int max_iter, const Color *seeds) {
     int npix = w*h;
     Color *centroids = malloc(k * sizeof *centroids);
     int *labels = malloc(npix * sizeof *labels);
     srand((unsigned)time(NULL));
     for(int i = 0; i < k; i++) {
+        if(seeds){
+            centroids[i]=seeds[i];
+            continue;
+        }
         int index=rand()%npix;
         centroids[i].r=img[4*index+0];
         centroids[i].g=img[4*index+1];
@@ -120,6 +298,7 @@ Color *kmeans_palette(unsigned char *img, int w, int h, int k, int max_iter) {
     cl_mem d_lbl = clCreateBuffer(cl_ctx,CL_MEM_READ_WRITE, npix*sizeof(int),NULL,NULL);
 
     size_t gsz = npix;
+    cl_kernel assign = palette_kernel(k, 0);
     for(int it = 0; it < max_iter; it++){
         int changed=0;
         float *cent_flat=malloc(k*3*sizeof(float));
@@ -130,12 +309,12 @@ Color *kmeans_palette(unsigned char *img, int w, int h, int k, int max_iter) {
         }
 
         CL_CHECK(clEnqueueWriteBuffer(cl_q,d_cent,CL_TRUE,0,k*3*sizeof(float),cent_flat,0,NULL,NULL));
-        clSetKernelArg(k_assign,0,sizeof(cl_mem),&d_img);
-        clSetKernelArg(k_assign,1,sizeof(cl_mem),&d_cent);
-        clSetKernelArg(k_assign,2,sizeof(int),&k);
-        clSetKernelArg(k_assign,3,sizeof(cl_mem),&d_lbl);
-        clSetKernelArg(k_assign,4,sizeof(int),&npix);
-        CL_CHECK(clEnqueueNDRangeKernel(cl_q,k_assign,1,NULL,&gsz,NULL,0,NULL,NULL));
+        clSetKernelArg(assign,0,sizeof(cl_mem),&d_img);
+        clSetKernelArg(assign,1,sizeof(cl_mem),&d_cent);
+        clSetKernelArg(assign,2,sizeof(int),&k);
+        clSetKernelArg(assign,3,sizeof(cl_mem),&d_lbl);
+        clSetKernelArg(assign,4,sizeof(int),&npix);
+        CL_CHECK(clEnqueueNDRangeKernel(cl_q,assign,1,NULL,&gsz,NULL,0,NULL,NULL));
         CL_CHECK(clFinish(cl_q));
         CL_CHECK(clEnqueueReadBuffer(cl_q,d_lbl,CL_TRUE,0,npix*sizeof(int),labels,0,NULL,NULL));
         free(cent_flat);
@@ -179,12 +358,117 @@ Color *kmeans_palette(unsigned char *img, int w, int h, int k, int max_iter) {
     return centroids;
 }
 
+// Kernel time of one map_palette launch
+static double map_time(cl_kernel kernel, cl_mem d_img, cl_mem d_pal, int pn, cl_mem d_out, int npix){
+    cl_event ev;
+    cl_ulong t0, t1;
+    size_t gsz = npix;
+    clSetKernelArg(kernel,0,sizeof(cl_mem),&d_img);
+    clSetKernelArg(kernel,1,sizeof(cl_mem),&d_pal);
+    clSetKernelArg(kernel,2,sizeof(int),&pn);
+    clSetKernelArg(kernel,3,sizeof(cl_mem),&d_out);
+    clSetKernelArg(kernel,4,sizeof(int),&npix);
+    CL_CHECK(clEnqueueNDRangeKernel(cl_q,kernel,1,NULL,&gsz,NULL,0,NULL,&ev));
+    CL_CHECK(clWaitForEvents(1,&ev));
+    clGetEventProfilingInfo(ev,CL_PROFILING_COMMAND_START,sizeof(t0),&t0,NULL);
+    clGetEventProfilingInfo(ev,CL_PROFILING_COMMAND_END,sizeof(t1),&t1,NULL);
+    clReleaseEvent(ev);
+    return (t1-t0)*1e-9;
+}
+
+// Best map_palette time of the generic and the specialized kernels for every bench size
+static void bench_palettes(unsigned char *img, int npix){
+    cl_mem d_img = clCreateBuffer(cl_ctx,CL_MEM_READ_ONLY|CL_MEM_COPY_HOST_PTR,npix*4,img,NULL);
+    cl_mem d_out = clCreateBuffer(cl_ctx,CL_MEM_WRITE_ONLY,npix*4,NULL,NULL);
+    unsigned char *out_generic=malloc(npix*4), *out_special=malloc(npix*4);
+    printf("%5s %12s %12s %8s\n","k","generic s","specialized s","speedup");
+    for(size_t b = 0; b < sizeof(bench_sizes)/sizeof(bench_sizes[0]); b++){
+        int k = bench_sizes[b];
+        float *pal_flat = malloc(k*3*sizeof(float));
+        for(int j = 0; j < 3*k; j++) pal_flat[j] = (float)(rand()%256);
+        cl_mem d_pal = clCreateBuffer(cl_ctx,CL_MEM_READ_ONLY|CL_MEM_COPY_HOST_PTR,k*3*sizeof(float),pal_flat,NULL);
+        cl_kernel special = palette_kernel(k, 1);
+        double generic_s = 1e30, special_s = 1e30;
+        for(int r = 0; r < BENCH_RUNS; r++){
+            generic_s = fmin(generic_s, map_time(k_map,d_img,d_pal,k,d_out,npix));
+            if(r == 0) CL_CHECK(clEnqueueReadBuffer(cl_q,d_out,CL_TRUE,0,npix*4,out_generic,0,NULL,NULL));
+            special_s = fmin(special_s, map_time(special,d_img,d_pal,k,d_out,npix));
+            if(r == 0) CL_CHECK(clEnqueueReadBuffer(cl_q,d_out,CL_TRUE,0,npix*4,out_special,0,NULL,NULL));
+        }
+        printf("%5d %12.6f %12.6f %8.2f%s\n",k,generic_s,special_s,generic_s/special_s,
+            memcmp(out_generic,out_special,npix*4) ? "  MISMATCH" : "");
+        clReleaseMemObject(d_pal);
+        free(pal_flat);
+    }
+    free(out_generic);
+    free(out_special);
+    clReleaseMemObject(d_img);
+    clReleaseMemObject(d_out);
+}
+
+// Best device histogram time with and without moments, against the host histogram
+static void bench_histogram(unsigned char *img, int npix){
+    ColorHistogram host, dev;
+    histogram_init(&host);
+    histogram_init(&dev);
+    clock_t start = clock();
+    histogram_add(&host,img,npix);
+    double host_s = (double)(clock()-start)/CLOCKS_PER_SEC;
+    printf("%-16s %12s %8s\n","histogram","s","speedup");
+    printf("%-16s %12.6f\n","host",host_s);
+    for(int moments = 0; moments < 2; moments++){
+        double best = 1e30;
+        for(int r = 0; r < BENCH_RUNS; r++){
+            double t = device_histogram(img,npix,moments,&dev);
+            if(t < 0){
+                printf("device has no cl_khr_int64_base_atomics\n");
+                histogram_release(&host);
+                histogram_release(&dev);
+                return;
+            }
+            best = fmin(best,t);
+        }
+        int mismatch = memcmp(host.count,dev.count,HIST_BINS*sizeof *host.count) != 0;
+        if(moments){
+            mismatch |= memcmp(host.r,dev.r,HIST_BINS*sizeof *host.r) != 0;
+            mismatch |= memcmp(host.g,dev.g,HIST_BINS*sizeof *host.g) != 0;
+            mismatch |= memcmp(host.b,dev.b,HIST_BINS*sizeof *host.b) != 0;
+            mismatch |= memcmp(host.m2,dev.m2,HIST_BINS*sizeof *host.m2) != 0;
+        }
+        printf("%-16s %12.6f %8.2f%s\n",moments ? "device moments" : "device counts",best,host_s/best,
+            mismatch ? "  MISMATCH" : "");
+    }
+    histogram_release(&host);
+    histogram_release(&dev);
+}
+
 int main(int argc,char **argv){
-    if(argc<4){
-        fprintf(stderr,"Usage: %s <palette.txt|number> <input> <output>\n",argv[0]);
+    if(argc==3 && strcmp(argv[1],"bench")==0){
+        int w, h, comp;
+        unsigned char *img = stbi_load(argv[2],&w,&h,&comp,4);
+        if(!img){
+            fprintf(stderr,"Image load fail\n");
+            return 1;
+        }
+        init_opencl();
+        bench_palettes(img,w*h);
+        bench_histogram(img,w*h);
+        release_opencl();
+        free(img);
+        return 0;
+    }
+    const char *method = argc > 4 ? argv[4] : "kmeans";
+    if(argc<4 || !known_method(method)){
+        if(argc>=4) fprintf(stderr,"Unknown method %s\n",method);
+        fprintf(stderr,"Usage: %s <palette.txt|number> <input> <output> [kmeans|octree|mediancut|wu|kmeans-mediancut|kmeans-wu]\n",argv[0]);
+        fprintf(stderr,"       %s bench <input>\n",argv[0]);
         return 1;
     }
     const char *p=argv[1], *in=argv[2], *outf=argv[3];
+    if(is_number(p) && atoi(p)<1){
+        fprintf(stderr,"Palette size must be at least 1\n");
+        return 1;
+    }
     int w, h, comp;
     unsigned char *img = stbi_load(in,&w,&h,&comp,4);
     if(!img){
@@ -196,9 +480,22 @@ int main(int argc,char **argv){
     Color *palette;
     int pn;
     clock_t start = clock();
-    if(is_number(p)){
+    if(is_number(p) && strcmp(method,"octree")==0){
+        palette=octree_palette(img,npix,atoi(p),&pn);
+        print_palette(palette,pn);
+    }
+    else if(is_number(p) && (palette=histogram_palette(img,npix,atoi(p),method,&pn))){
+        print_palette(palette,pn);
+    }
+    else if(is_number(p) && strncmp(method,"kmeans-",7)==0){
+        // Start from a histogram palette so few iterations are needed
+        Color *seeds=histogram_palette(img,npix,atoi(p),method+7,&pn);
+        palette=kmeans_palette(img,w,h,pn,MAX_ITERATIONS,seeds);
+        free(seeds);
+    }
+    else if(is_number(p)){
         int k=atoi(p);
-        palette=kmeans_palette(img,w,h,k,MAX_ITERATIONS);
+        palette=kmeans_palette(img,w,h,k,MAX_ITERATIONS,NULL);
         pn=k;
     }
     else palette=load_palette(p,&pn);
@@ -213,13 +510,14 @@ int main(int argc,char **argv){
     cl_mem d_pal = clCreateBuffer(cl_ctx,CL_MEM_READ_ONLY|CL_MEM_COPY_HOST_PTR,pn*3*sizeof(float),pal_flat,NULL);
     cl_mem d_out = clCreateBuffer(cl_ctx,CL_MEM_WRITE_ONLY,npix*4,NULL,NULL);
 
-    clSetKernelArg(k_map,0,sizeof(cl_mem),&d_img);
-    clSetKernelArg(k_map,1,sizeof(cl_mem),&d_pal);
-    clSetKernelArg(k_map,2,sizeof(int),&pn);
-    clSetKernelArg(k_map,3,sizeof(cl_mem),&d_out);
-    clSetKernelArg(k_map,4,sizeof(int),&npix);
+    cl_kernel map = palette_kernel(pn, 1);
+    clSetKernelArg(map,0,sizeof(cl_mem),&d_img);
+    clSetKernelArg(map,1,sizeof(cl_mem),&d_pal);
+    clSetKernelArg(map,2,sizeof(int),&pn);
+    clSetKernelArg(map,3,sizeof(cl_mem),&d_out);
+    clSetKernelArg(map,4,sizeof(int),&npix);
     size_t gsz=npix;
-    CL_CHECK(clEnqueueNDRangeKernel(cl_q,k_map,1,NULL,&gsz,NULL,0,NULL,NULL));
+    CL_CHECK(clEnqueueNDRangeKernel(cl_q,map,1,NULL,&gsz,NULL,0,NULL,NULL));
     CL_CHECK(clFinish(cl_q));
 
     unsigned char *out=malloc(npix*4);
@@ -234,11 +532,7 @@ int main(int argc,char **argv){
     clReleaseMemObject(d_img);
     clReleaseMemObject(d_pal);
     clReleaseMemObject(d_out);
-    clReleaseKernel(k_assign);
-    clReleaseKernel(k_map);
-    clReleaseProgram(cl_prog);
-    clReleaseCommandQueue(cl_q);
-    clReleaseContext(cl_ctx);
+    release_opencl();
 
     // Runtime
     printf("Runtime: %.6f seconds\n", (double)(clock()-start)/CLOCKS_PER_SEC);
@@ -0,0 +1,92 @@
+#ifndef QUANTIZERS_H
+#define QUANTIZERS_H
+
+typedef struct{
+    float r, g, b;
+} Color;
+
+/**
+ * Octree palette (Gervautz-Purgathofer) of at most k colors, built in one
+ * pass over the pixels. Every pixel descends an 8-level octree indexed by
+ * the bits of R, G and B; whenever the tree holds more than k + OCTREE_SLACK
+ * (8) leaves, the deepest reducible node merges its children into one leaf, so
+ * while streaming the tree stays within k + OCTREE_SLACK leaves and
+ * 8 (k + OCTREE_SLACK) inner nodes whatever the pixel count. At the end the
+ * least populated nodes and leaves are merged down to exactly k leaves (fewer
+ * only when the image has fewer distinct colors). A palette color is the
+ * mean of the pixels of a leaf.
+ *
+ * img: RGBA pixels
+ * npix: Number of pixels
+ * k: Maximum number of colors
+ * palette_size_out: Set to the number of colors, at most k
+ *
+ * Returns the palette, allocated with malloc
+ */
+Color *octree_palette(const unsigned char *img, int npix, int k, int *palette_size_out);
+
+// Bits kept per channel by the color histogram: 32 bins per channel, 32768 in all
+#define HIST_BITS 5
+#define HIST_SIDE (1 << HIST_BITS)
+#define HIST_BINS (HIST_SIDE * HIST_SIDE * HIST_SIDE)
+
+// Bin of a color, R major
+#define HIST_INDEX(r, g, b) \
+    ((((r) >> (8 - HIST_BITS)) * HIST_SIDE + ((g) >> (8 - HIST_BITS))) * HIST_SIDE + ((b) >> (8 - HIST_BITS)))
+
+/**
+ * Reduced-precision RGB histogram with the moments of every bin: pixel
+ * count, sums of R, G and B, and sum of R^2 + G^2 + B^2 over the full
+ * precision values of its pixels.
+ */
+typedef struct{
+    long long *count;
+    long long *r, *g, *b;
+    double *m2;
+} ColorHistogram;
+
+/**
+ * Allocate an empty histogram.
+ */
+void histogram_init(ColorHistogram *hist);
+
+/**
+ * Add the RGB values of npix RGBA pixels to the histogram.
+ */
+void histogram_add(ColorHistogram *hist, const unsigned char *img, int npix);
+
+/**
+ * Free the histogram.
+ */
+void histogram_release(ColorHistogram *hist);
+
+/**
+ * Median-cut palette (Heckbert) of at most k colors: the box of histogram
+ * bins holding the most pixels is split at the pixel median of its longest
+ * side until there are k boxes, each box giving the mean of its pixels.
+ *
+ * palette_size_out: Set to the number of colors, fewer than k if the
+ * histogram has fewer non-empty bins
+ *
+ * Returns the palette, allocated with malloc
+ */
+Color *median_cut_palette(const ColorHistogram *hist, int k, int *palette_size_out);
+
+/**
+ * Variance-minimization palette (Xiaolin Wu) of at most k colors: the box
+ * with the largest color variance is split where the sum of the variances
+ * of both halves is smallest, computed in constant time per cut from
+ * cumulative moments of the histogram.
+ *
+ * palette_size_out: Set to the number of colors
+ *
+ * Returns the palette, allocated with malloc
+ */
+Color *wu_palette(const ColorHistogram *hist, int k, int *palette_size_out);
+
+/**
+ * Print the colors of a palette.
+ */
+void print_palette(const Color *palette, int n);
+
+#endif
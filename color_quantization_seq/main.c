@@ -2,6 +2,7 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "include/stb_image.h"
 #include "include/stb_image_write.h"
+#include "include/quantizers.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,10 +11,6 @@
 
 #define MAX_ITERATIONS 100
 
-typedef struct{
-    float r, g, b;
-} Color;
-
 static inline float dist2(float r1, float g1, float b1, float r2, float g2, float b2) {
     float dr = r1 - r2;
     float dg = g1 - g2;
@@ -76,13 +73,39 @@ Color *load_palette(const char *paletteFile, int *paletteSizeOut) {
 }
 
 
-Color *kmeans_palette(unsigned char *img, int w, int h, int k, int max_iter) {
+// Whether a method name is one of the usage choices
+static int known_method(const char *method) {
+    static const char *methods[] = { "kmeans", "octree", "mediancut", "wu", "kmeans-mediancut", "kmeans-wu" };
+    for (size_t i = 0; i < sizeof(methods)/sizeof(methods[0]); i++) {
+        if (strcmp(method, methods[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+// Median-cut or Wu palette from the color histogram of the image, NULL for other methods
+static Color *histogram_palette(const unsigned char *img, int npix, int k, const char *method, int *pn) {
+    int wu = strcmp(method, "wu") == 0;
+    if (!wu && strcmp(method, "mediancut") != 0) return NULL;
+    ColorHistogram hist;
+    histogram_init(&hist);
+    histogram_add(&hist, img, npix);
+    // Palette time no longer depends on the number of pixels
+    Color *palette = wu ? wu_palette(&hist, k, pn) : median_cut_palette(&hist, k, pn);
+    histogram_release(&hist);
+    return palette;
+}
+
+Color *kmeans_palette(unsigned char *img, int w, int h, int k, int max_iter, const Color *seeds) {
     int npix = w*h;
     Color *centroids = malloc(k * sizeof *centroids);
     int *labels = malloc(npix * sizeof *labels);
-    // Select k random centroids
+    // Start from the seeds if given, else select k random centroids
     srand((unsigned)time(NULL));
     for (int i = 0; i < k; i++) {
+        if (seeds) {
+            centroids[i] = seeds[i];
+            continue;
+        }
         int index = rand() % npix;
         centroids[i].r = img[4*index+0];
         centroids[i].g = img[4*index+1];
@@ -141,8 +164,10 @@ Color *kmeans_palette(unsigned char *img, int w, int h, int k, int max_iter) {
 }
 
 int main(int argc, char **argv) {
-    if (argc < 4) {
-        fprintf(stderr, "Usage: %s <palette.txt OR number> <input_image> <output_image>\n", argv[0]);
+    const char *method = argc > 4 ? argv[4] : "kmeans";
+    if (argc < 4 || !known_method(method)) {
+        if (argc >= 4) fprintf(stderr, "Unknown method %s\n", method);
+        fprintf(stderr, "Usage: %s <palette.txt OR number> <input_image> <output_image> [kmeans|octree|mediancut|wu|kmeans-mediancut|kmeans-wu]\n", argv[0]);
         return EXIT_FAILURE;
     }
     const char *p = argv[1];
@@ -159,8 +184,21 @@ int main(int argc, char **argv) {
     if (is_number(p)) {
         int k = atoi(p);
         if (k < 1) exit(1);
-        palette = kmeans_palette(img, w, h, k, MAX_ITERATIONS);
-        pn = k;
+        if (strcmp(method, "octree") == 0) {
+            // One pass over the pixels instead of up to MAX_ITERATIONS
+            palette = octree_palette(img, npix, k, &pn);
+            print_palette(palette, pn);
+        } else if ((palette = histogram_palette(img, npix, k, method, &pn))) {
+            print_palette(palette, pn);
+        } else if (strncmp(method, "kmeans-", 7) == 0) {
+            // Seed k-means with a histogram palette so it converges in few iterations
+            Color *seeds = histogram_palette(img, npix, k, method + 7, &pn);
+            palette = kmeans_palette(img, w, h, pn, MAX_ITERATIONS, seeds);
+            free(seeds);
+        } else {
+            palette = kmeans_palette(img, w, h, k, MAX_ITERATIONS, NULL);
+            pn = k;
+        }
     } else {
         palette = load_palette(p, &pn);
     }
@@ -0,0 +1,532 @@
+#include "quantizers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Levels of the octree below the root, one per bit of a channel
+#define OCTREE_DEPTH 8
+
+typedef struct OctreeNode{
+    long r, g, b;
+    long count;
+    int leaf;
+    struct OctreeNode *children[8];
+    struct OctreeNode *next_reducible;
+} OctreeNode;
+
+typedef struct{
+    OctreeNode *root;
+    // Inner nodes of each level, the deepest non-empty list is reduced first
+    OctreeNode *reducible[OCTREE_DEPTH];
+    int leaves;
+} Octree;
+
+static OctreeNode *octree_node(Octree *tree, int level){
+    OctreeNode *node = calloc(1, sizeof *node);
+    if (!node) {
+        fprintf(stderr, "Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    if (level == OCTREE_DEPTH) {
+        node->leaf = 1;
+        tree->leaves++;
+    } else {
+        node->next_reducible = tree->reducible[level];
+        tree->reducible[level] = node;
+    }
+    return node;
+}
+
+static void octree_insert(Octree *tree, unsigned char r, unsigned char g, unsigned char b){
+    OctreeNode **slot = &tree->root;
+    for (int level = 0; ; level++) {
+        if (!*slot) *slot = octree_node(tree, level);
+        OctreeNode *node = *slot;
+        if (node->leaf) {
+            node->r += r;
+            node->g += g;
+            node->b += b;
+            node->count++;
+            return;
+        }
+        int shift = 7 - level;
+        int index = ((r >> shift) & 1) << 2 | ((g >> shift) & 1) << 1 | ((b >> shift) & 1);
+        slot = &node->children[index];
+    }
+}
+
+// Leaves allowed above k while pixels are inserted: merging a node removes at
+// most 7 leaves, so the streaming reduction never drops below k
+#define OCTREE_SLACK 8
+
+// Merge the children of a reducible node into it
+static void octree_merge(Octree *tree, OctreeNode *node){
+    int merged = 0;
+    for (int i = 0; i < 8; i++) {
+        OctreeNode *child = node->children[i];
+        if (!child) continue;
+        node->r += child->r;
+        node->g += child->g;
+        node->b += child->b;
+        node->count += child->count;
+        free(child);
+        node->children[i] = NULL;
+        merged++;
+    }
+    node->leaf = 1;
+    tree->leaves += 1 - merged;
+}
+
+// Deepest level with reducible nodes, -1 if none. Their children are leaves, as deeper levels are reduced first
+static int octree_deepest(const Octree *tree){
+    int level = OCTREE_DEPTH - 1;
+    while (level >= 0 && !tree->reducible[level]) level--;
+    return level;
+}
+
+// Merge the children of the most recent node of the deepest reducible level
+static void octree_reduce(Octree *tree){
+    int level = octree_deepest(tree);
+    if (level < 0) return;
+    OctreeNode *node = tree->reducible[level];
+    tree->reducible[level] = node->next_reducible;
+    octree_merge(tree, node);
+}
+
+static int octree_children(const OctreeNode *node){
+    int n = 0;
+    for (int i = 0; i < 8; i++) n += node->children[i] != NULL;
+    return n;
+}
+
+// Pixels below a node of the deepest reducible level, whose own count is only summed on merge
+static long octree_pixels(const OctreeNode *node){
+    long n = 0;
+    for (int i = 0; i < 8; i++) {
+        if (node->children[i]) n += node->children[i]->count;
+    }
+    return n;
+}
+
+// Remove one reducible node or one leaf without going below k leaves.
+// Returns 0 if the tree has no reducible node left.
+static int octree_reduce_to(Octree *tree, int k){
+    int level = octree_deepest(tree);
+    if (level < 0) return 0;
+
+    // The least populated node of the level whose merge keeps at least k leaves
+    OctreeNode **best = NULL, *pair = NULL;
+    long best_pixels = 0;
+    for (OctreeNode **link = &tree->reducible[level]; *link; link = &(*link)->next_reducible) {
+        OctreeNode *node = *link;
+        if (tree->leaves - (octree_children(node) - 1) < k) {
+            if (!pair && octree_children(node) >= 2) pair = node;
+            continue;
+        }
+        long pixels = octree_pixels(node);
+        if (!best || pixels < best_pixels) {
+            best = link;
+            best_pixels = pixels;
+        }
+    }
+    if (best) {
+        OctreeNode *node = *best;
+        *best = node->next_reducible;
+        octree_merge(tree, node);
+        return 1;
+    }
+
+    // Every merge would overshoot: merge the two least populated leaves of a node instead
+    int a = -1, b = -1;
+    for (int i = 0; i < 8; i++) {
+        OctreeNode *child = pair->children[i];
+        if (!child) continue;
+        if (a < 0 || child->count < pair->children[a]->count) {
+            b = a;
+            a = i;
+        } else if (b < 0 || child->count < pair->children[b]->count) {
+            b = i;
+        }
+    }
+    OctreeNode *keep = pair->children[a], *gone = pair->children[b];
+    keep->r += gone->r;
+    keep->g += gone->g;
+    keep->b += gone->b;
+    keep->count += gone->count;
+    free(gone);
+    pair->children[b] = NULL;
+    tree->leaves--;
+    return 1;
+}
+
+static void octree_collect(OctreeNode *node, Color *palette, int *n){
+    if (!node) return;
+    if (node->leaf) {
+        palette[*n].r = node->r / (float)node->count;
+        palette[*n].g = node->g / (float)node->count;
+        palette[*n].b = node->b / (float)node->count;
+        (*n)++;
+    } else {
+        for (int i = 0; i < 8; i++) octree_collect(node->children[i], palette, n);
+    }
+    free(node);
+}
+
+Color *octree_palette(const unsigned char *img, int npix, int k, int *palette_size_out){
+    Octree tree = { 0 };
+    for (int i = 0; i < npix; i++) {
+        octree_insert(&tree, img[4*i+0], img[4*i+1], img[4*i+2]);
+        while (tree.leaves > k + OCTREE_SLACK) octree_reduce(&tree);
+    }
+    while (tree.leaves > k && octree_reduce_to(&tree, k));
+
+    Color *palette = malloc((tree.leaves > 0 ? tree.leaves : 1) * sizeof *palette);
+    int n = 0;
+    octree_collect(tree.root, palette, &n);
+    *palette_size_out = n;
+    return palette;
+}
+
+void print_palette(const Color *palette, int n){
+    for (int i = 0; i < n; i++) {
+        printf("Color %d: R: %.00f | G: %.00f | B:%.00f\n", i+1, palette[i].r, palette[i].g, palette[i].b);
+    }
+}
+
+void histogram_init(ColorHistogram *hist){
+    hist->count = calloc(HIST_BINS, sizeof *hist->count);
+    hist->r = calloc(HIST_BINS, sizeof *hist->r);
+    hist->g = calloc(HIST_BINS, sizeof *hist->g);
+    hist->b = calloc(HIST_BINS, sizeof *hist->b);
+    hist->m2 = calloc(HIST_BINS, sizeof *hist->m2);
+    if (!hist->count || !hist->r || !hist->g || !hist->b || !hist->m2) {
+        fprintf(stderr, "Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void histogram_add(ColorHistogram *hist, const unsigned char *img, int npix){
+    for (int i = 0; i < npix; i++) {
+        int r = img[4*i+0], g = img[4*i+1], b = img[4*i+2];
+        int bin = HIST_INDEX(r, g, b);
+        hist->count[bin]++;
+        hist->r[bin] += r;
+        hist->g[bin] += g;
+        hist->b[bin] += b;
+        hist->m2[bin] += r*r + g*g + b*b;
+    }
+}
+
+void histogram_release(ColorHistogram *hist){
+    free(hist->count);
+    free(hist->r);
+    free(hist->g);
+    free(hist->b);
+    free(hist->m2);
+}
+
+// Box of histogram bins, bounds inclusive, with its pixel count and channel sums
+typedef struct{
+    int lo[3], hi[3];
+    long long count;
+    long long sum[3];
+} CutBox;
+
+static long long bin_at(const long long *moment, const int c[3]){
+    return moment[(c[0] * HIST_SIDE + c[1]) * HIST_SIDE + c[2]];
+}
+
+// Shrink a box to its non-empty bins and total its pixels
+static void box_shrink(const ColorHistogram *hist, CutBox *box){
+    int lo[3] = { HIST_SIDE, HIST_SIDE, HIST_SIDE }, hi[3] = { -1, -1, -1 };
+    int c[3];
+    box->count = box->sum[0] = box->sum[1] = box->sum[2] = 0;
+    for (c[0] = box->lo[0]; c[0] <= box->hi[0]; c[0]++)
+    for (c[1] = box->lo[1]; c[1] <= box->hi[1]; c[1]++)
+    for (c[2] = box->lo[2]; c[2] <= box->hi[2]; c[2]++) {
+        long long n = bin_at(hist->count, c);
+        if (!n) continue;
+        box->count += n;
+        box->sum[0] += bin_at(hist->r, c);
+        box->sum[1] += bin_at(hist->g, c);
+        box->sum[2] += bin_at(hist->b, c);
+        for (int d = 0; d < 3; d++) {
+            if (c[d] < lo[d]) lo[d] = c[d];
+            if (c[d] > hi[d]) hi[d] = c[d];
+        }
+    }
+    if (box->count) {
+        for (int d = 0; d < 3; d++) {
+            box->lo[d] = lo[d];
+            box->hi[d] = hi[d];
+        }
+    }
+}
+
+// Pixels of the slice at position p of dimension d of a box
+static long long slice_count(const ColorHistogram *hist, const CutBox *box, int d, int p){
+    int c[3];
+    long long n = 0;
+    int lo[3] = { box->lo[0], box->lo[1], box->lo[2] }, hi[3] = { box->hi[0], box->hi[1], box->hi[2] };
+    lo[d] = hi[d] = p;
+    for (c[0] = lo[0]; c[0] <= hi[0]; c[0]++)
+    for (c[1] = lo[1]; c[1] <= hi[1]; c[1]++)
+    for (c[2] = lo[2]; c[2] <= hi[2]; c[2]++) {
+        n += bin_at(hist->count, c);
+    }
+    return n;
+}
+
+Color *median_cut_palette(const ColorHistogram *hist, int k, int *palette_size_out){
+    CutBox *boxes = malloc((k > 0 ? k : 1) * sizeof *boxes);
+    int n = 1;
+    for (int d = 0; d < 3; d++) {
+        boxes[0].lo[d] = 0;
+        boxes[0].hi[d] = HIST_SIDE - 1;
+    }
+    box_shrink(hist, &boxes[0]);
+
+    while (n < k) {
+        // The most populated box that still spans more than one bin
+        int best = -1;
+        for (int i = 0; i < n; i++) {
+            int splittable = boxes[i].lo[0] < boxes[i].hi[0] || boxes[i].lo[1] < boxes[i].hi[1]
+                || boxes[i].lo[2] < boxes[i].hi[2];
+            if (splittable && (best < 0 || boxes[i].count > boxes[best].count)) best = i;
+        }
+        if (best < 0) break;
+
+        // Longest side, cut after the slice where half of the pixels are reached
+        CutBox *box = &boxes[best];
+        int d = 0;
+        for (int e = 1; e < 3; e++) {
+            if (box->hi[e] - box->lo[e] > box->hi[d] - box->lo[d]) d = e;
+        }
+        long long below = 0;
+        int cut = box->lo[d];
+        for (; cut < box->hi[d] - 1; cut++) {
+            below += slice_count(hist, box, d, cut);
+            if (2 * below >= box->count) break;
+        }
+
+        boxes[n] = *box;
+        box->hi[d] = cut;
+        boxes[n].lo[d] = cut + 1;
+        box_shrink(hist, box);
+        box_shrink(hist, &boxes[n]);
+        n++;
+    }
+
+    Color *palette = malloc(n * sizeof *palette);
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+        if (!boxes[i].count) continue;
+        palette[m].r = boxes[i].sum[0] / (float)boxes[i].count;
+        palette[m].g = boxes[i].sum[1] / (float)boxes[i].count;
+        palette[m].b = boxes[i].sum[2] / (float)boxes[i].count;
+        m++;
+    }
+    free(boxes);
+    *palette_size_out = m;
+    return palette;
+}
+
+// Wu's cumulative moments have a zero plane in front of every dimension
+#define WU_SIDE (HIST_SIDE + 1)
+#define WU_INDEX(r, g, b) (((r) * WU_SIDE + (g)) * WU_SIDE + (b))
+
+typedef struct{
+    double *wt, *mr, *mg, *mb, *m2;
+} WuMoments;
+
+// Box of cumulative moment indices, lower bounds exclusive
+typedef struct{
+    int r0, r1, g0, g1, b0, b1;
+    int vol;
+} WuBox;
+
+// Sum of a moment over a box
+static double wu_volume(const WuBox *c, const double *m){
+    return m[WU_INDEX(c->r1, c->g1, c->b1)] - m[WU_INDEX(c->r1, c->g1, c->b0)]
+        - m[WU_INDEX(c->r1, c->g0, c->b1)] + m[WU_INDEX(c->r1, c->g0, c->b0)]
+        - m[WU_INDEX(c->r0, c->g1, c->b1)] + m[WU_INDEX(c->r0, c->g1, c->b0)]
+        + m[WU_INDEX(c->r0, c->g0, c->b1)] - m[WU_INDEX(c->r0, c->g0, c->b0)];
+}
+
+// Part of the volume of a box that does not depend on the cut position along dir
+static double wu_bottom(const WuBox *c, int dir, const double *m){
+    switch (dir) {
+    case 0:
+        return -m[WU_INDEX(c->r0, c->g1, c->b1)] + m[WU_INDEX(c->r0, c->g1, c->b0)]
+            + m[WU_INDEX(c->r0, c->g0, c->b1)] - m[WU_INDEX(c->r0, c->g0, c->b0)];
+    case 1:
+        return -m[WU_INDEX(c->r1, c->g0, c->b1)] + m[WU_INDEX(c->r1, c->g0, c->b0)]
+            + m[WU_INDEX(c->r0, c->g0, c->b1)] - m[WU_INDEX(c->r0, c->g0, c->b0)];
+    default:
+        return -m[WU_INDEX(c->r1, c->g1, c->b0)] + m[WU_INDEX(c->r1, c->g0, c->b0)]
+            + m[WU_INDEX(c->r0, c->g1, c->b0)] - m[WU_INDEX(c->r0, c->g0, c->b0)];
+    }
+}
+
+// Rest of the volume of a box cut at pos along dir
+static double wu_top(const WuBox *c, int dir, int pos, const double *m){
+    switch (dir) {
+    case 0:
+        return m[WU_INDEX(pos, c->g1, c->b1)] - m[WU_INDEX(pos, c->g1, c->b0)]
+            - m[WU_INDEX(pos, c->g0, c->b1)] + m[WU_INDEX(pos, c->g0, c->b0)];
+    case 1:
+        return m[WU_INDEX(c->r1, pos, c->b1)] - m[WU_INDEX(c->r1, pos, c->b0)]
+            - m[WU_INDEX(c->r0, pos, c->b1)] + m[WU_INDEX(c->r0, pos, c->b0)];
+    default:
+        return m[WU_INDEX(c->r1, c->g1, pos)] - m[WU_INDEX(c->r1, c->g0, pos)]
+            - m[WU_INDEX(c->r0, c->g1, pos)] + m[WU_INDEX(c->r0, c->g0, pos)];
+    }
+}
+
+// Sum of squared distances of the pixels of a box to their mean
+static double wu_variance(const WuBox *c, const WuMoments *m){
+    double dr = wu_volume(c, m->mr), dg = wu_volume(c, m->mg), db = wu_volume(c, m->mb);
+    double w = wu_volume(c, m->wt);
+    return w > 0 ? wu_volume(c, m->m2) - (dr*dr + dg*dg + db*db) / w : 0;
+}
+
+// Best cut of a box along dir: maximizes the between-halves term, -1 if no cut leaves both halves non-empty
+static double wu_maximize(const WuBox *c, int dir, int first, int last, int *cut, const WuMoments *m,
+    double whole_r, double whole_g, double whole_b, double whole_w){
+    double base_r = wu_bottom(c, dir, m->mr), base_g = wu_bottom(c, dir, m->mg);
+    double base_b = wu_bottom(c, dir, m->mb), base_w = wu_bottom(c, dir, m->wt);
+    double best = 0;
+    *cut = -1;
+    for (int i = first; i < last; i++) {
+        double half_r = base_r + wu_top(c, dir, i, m->mr);
+        double half_g = base_g + wu_top(c, dir, i, m->mg);
+        double half_b = base_b + wu_top(c, dir, i, m->mb);
+        double half_w = base_w + wu_top(c, dir, i, m->wt);
+        if (half_w == 0) continue;
+        double temp = (half_r*half_r + half_g*half_g + half_b*half_b) / half_w;
+        half_r = whole_r - half_r;
+        half_g = whole_g - half_g;
+        half_b = whole_b - half_b;
+        half_w = whole_w - half_w;
+        if (half_w == 0) continue;
+        temp += (half_r*half_r + half_g*half_g + half_b*half_b) / half_w;
+        if (temp > best) {
+            best = temp;
+            *cut = i;
+        }
+    }
+    return *cut >= 0 ? best : -1;
+}
+
+// Split set1 into set1 and set2 along the best cut, 0 if it cannot be split
+static int wu_cut(WuBox *set1, WuBox *set2, const WuMoments *m){
+    double whole_r = wu_volume(set1, m->mr), whole_g = wu_volume(set1, m->mg);
+    double whole_b = wu_volume(set1, m->mb), whole_w = wu_volume(set1, m->wt);
+    int cut_r, cut_g, cut_b;
+    double max_r = wu_maximize(set1, 0, set1->r0 + 1, set1->r1, &cut_r, m, whole_r, whole_g, whole_b, whole_w);
+    double max_g = wu_maximize(set1, 1, set1->g0 + 1, set1->g1, &cut_g, m, whole_r, whole_g, whole_b, whole_w);
+    double max_b = wu_maximize(set1, 2, set1->b0 + 1, set1->b1, &cut_b, m, whole_r, whole_g, whole_b, whole_w);
+
+    *set2 = *set1;
+    if (max_r >= max_g && max_r >= max_b) {
+        if (cut_r < 0) return 0;
+        set2->r0 = set1->r1 = cut_r;
+    } else if (max_g >= max_b) {
+        set2->g0 = set1->g1 = cut_g;
+    } else {
+        set2->b0 = set1->b1 = cut_b;
+    }
+    set1->vol = (set1->r1 - set1->r0) * (set1->g1 - set1->g0) * (set1->b1 - set1->b0);
+    set2->vol = (set2->r1 - set2->r0) * (set2->g1 - set2->g0) * (set2->b1 - set2->b0);
+    return 1;
+}
+
+// Cumulative moments: every entry sums the bins at or below it in all three dimensions
+static void wu_moments(const ColorHistogram *hist, WuMoments *m){
+    int size = WU_SIDE * WU_SIDE * WU_SIDE;
+    double **tables[5] = { &m->wt, &m->mr, &m->mg, &m->mb, &m->m2 };
+    for (int t = 0; t < 5; t++) {
+        *tables[t] = calloc(size, sizeof(double));
+        if (!*tables[t]) {
+            fprintf(stderr, "Out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int r = 1; r <= HIST_SIDE; r++)
+    for (int g = 1; g <= HIST_SIDE; g++)
+    for (int b = 1; b <= HIST_SIDE; b++) {
+        int bin = ((r - 1) * HIST_SIDE + (g - 1)) * HIST_SIDE + (b - 1);
+        int i = WU_INDEX(r, g, b);
+        m->wt[i] = (double)hist->count[bin];
+        m->mr[i] = (double)hist->r[bin];
+        m->mg[i] = (double)hist->g[bin];
+        m->mb[i] = (double)hist->b[bin];
+        m->m2[i] = hist->m2[bin];
+    }
+    for (int t = 0; t < 5; t++) {
+        double *a = *tables[t];
+        for (int r = 1; r <= HIST_SIDE; r++)
+        for (int g = 1; g <= HIST_SIDE; g++)
+        for (int b = 1; b <= HIST_SIDE; b++) {
+            a[WU_INDEX(r, g, b)] += a[WU_INDEX(r, g, b - 1)];
+        }
+        for (int r = 1; r <= HIST_SIDE; r++)
+        for (int g = 1; g <= HIST_SIDE; g++)
+        for (int b = 1; b <= HIST_SIDE; b++) {
+            a[WU_INDEX(r, g, b)] += a[WU_INDEX(r, g - 1, b)];
+        }
+        for (int r = 1; r <= HIST_SIDE; r++)
+        for (int g = 1; g <= HIST_SIDE; g++)
+        for (int b = 1; b <= HIST_SIDE; b++) {
+            a[WU_INDEX(r, g, b)] += a[WU_INDEX(r - 1, g, b)];
+        }
+    }
+}
+
+Color *wu_palette(const ColorHistogram *hist, int k, int *palette_size_out){
+    WuMoments m;
+    WuBox *cubes = malloc((k > 0 ? k : 1) * sizeof *cubes);
+    double *vv = malloc((k > 0 ? k : 1) * sizeof *vv);
+    int n = 1, next = 0;
+
+    wu_moments(hist, &m);
+    cubes[0].r0 = cubes[0].g0 = cubes[0].b0 = 0;
+    cubes[0].r1 = cubes[0].g1 = cubes[0].b1 = HIST_SIDE;
+    vv[0] = 0;
+
+    // Split the box of largest variance until there are k or none can be split
+    while (n < k) {
+        if (wu_cut(&cubes[next], &cubes[n], &m)) {
+            vv[next] = cubes[next].vol > 1 ? wu_variance(&cubes[next], &m) : 0;
+            vv[n] = cubes[n].vol > 1 ? wu_variance(&cubes[n], &m) : 0;
+            n++;
+        } else {
+            vv[next] = 0;
+        }
+        next = 0;
+        for (int i = 1; i < n; i++) {
+            if (vv[i] > vv[next]) next = i;
+        }
+        if (vv[next] <= 0) break;
+    }
+
+    Color *palette = malloc(n * sizeof *palette);
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        double w = wu_volume(&cubes[i], m.wt);
+        if (w <= 0) continue;
+        palette[count].r = (float)(wu_volume(&cubes[i], m.mr) / w);
+        palette[count].g = (float)(wu_volume(&cubes[i], m.mg) / w);
+        palette[count].b = (float)(wu_volume(&cubes[i], m.mb) / w);
+        count++;
+    }
+    free(m.wt);
+    free(m.mr);
+    free(m.mg);
+    free(m.mb);
+    free(m.m2);
+    free(cubes);
+    free(vv);
+    *palette_size_out = count;
+    return palette;
+}
@@ -0,0 +1,85 @@
+#include "quantizers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Pixels of the test image, random colors spread over the whole RGB cube
+#define TEST_PIXELS 200000
+
+// Check that the octree palette of the image has exactly k colors
+static int check_octree(const unsigned char *img, int npix, int k){
+    int pn;
+    Color *palette = octree_palette(img, npix, k, &pn);
+    int ok = pn == k;
+    printf("octree k=%d: %d colors %s\n", k, pn, ok ? "OK" : "FAIL");
+    free(palette);
+    return ok;
+}
+
+// Distinct colors of the few-color image, each in its own histogram bin
+static const unsigned char few_colors[][3] = {
+    { 0, 0, 0 }, { 255, 255, 255 }, { 200, 30, 40 }, { 12, 180, 90 }, { 70, 70, 250 }
+};
+#define FEW_COLORS ((int)(sizeof(few_colors)/sizeof(few_colors[0])))
+
+typedef Color *(*HistogramQuantizer)(const ColorHistogram *hist, int k, int *palette_size_out);
+
+// Check that a histogram quantizer returns at most k colors and, when the
+// image has at most k distinct colors, exactly those colors
+static int check_histogram(const char *name, HistogramQuantizer quantize,
+    const unsigned char *img, int npix, int k, int exact){
+    ColorHistogram hist;
+    int pn;
+    histogram_init(&hist);
+    histogram_add(&hist, img, npix);
+    Color *palette = quantize(&hist, k, &pn);
+    histogram_release(&hist);
+
+    int ok = pn >= 1 && pn <= k;
+    if (exact) {
+        ok = ok && pn == FEW_COLORS;
+        for (int c = 0; c < FEW_COLORS && ok; c++) {
+            int found = 0;
+            for (int i = 0; i < pn; i++) {
+                found |= palette[i].r == few_colors[c][0] && palette[i].g == few_colors[c][1]
+                    && palette[i].b == few_colors[c][2];
+            }
+            ok = found;
+        }
+    }
+    printf("%s k=%d: %d colors%s %s\n", name, k, pn, exact ? " (exact)" : "", ok ? "OK" : "FAIL");
+    free(palette);
+    return ok;
+}
+
+int main(void) {
+    static const int sizes[] = { 2, 4, 64, 256 };
+    unsigned char *img = malloc(TEST_PIXELS * 4);
+    srand(1);
+    for (int i = 0; i < TEST_PIXELS; i++) {
+        img[4*i+0] = rand() % 256;
+        img[4*i+1] = rand() % 256;
+        img[4*i+2] = rand() % 256;
+        img[4*i+3] = 255;
+    }
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++) {
+        failures += !check_octree(img, TEST_PIXELS, sizes[i]);
+        failures += !check_histogram("median-cut", median_cut_palette, img, TEST_PIXELS, sizes[i], 0);
+        failures += !check_histogram("wu", wu_palette, img, TEST_PIXELS, sizes[i], 0);
+    }
+
+    // Few distinct colors, repeated unevenly
+    for (int i = 0; i < TEST_PIXELS; i++) {
+        const unsigned char *color = few_colors[(i % 7) % FEW_COLORS];
+        img[4*i+0] = color[0];
+        img[4*i+1] = color[1];
+        img[4*i+2] = color[2];
+    }
+    for (int k = FEW_COLORS; k <= 2 * FEW_COLORS; k += FEW_COLORS) {
+        failures += !check_histogram("median-cut", median_cut_palette, img, TEST_PIXELS, k, 1);
+        failures += !check_histogram("wu", wu_palette, img, TEST_PIXELS, k, 1);
+    }
+    free(img);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}